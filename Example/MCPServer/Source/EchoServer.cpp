@@ -1,5 +1,7 @@
 #include "EchoServer.h"
 #include "EchoTask.h"
+#include "Transport/ShmTransport.h"
+#include "Transport/SocketTransport.h"
 #include "Transport/Transport.h"
 
 namespace Implementation {
@@ -41,9 +43,24 @@ int CEchoServer::Initialize() {
   case TransportType::kStdio:
     SetTransport(std::make_shared<MCP::CStdioTransport>());
     break;
-  case TransportType::kHttp:
-    SetTransport(std::make_shared<MCP::CHttpTransport>(m_httpHost, m_httpPort));
+  case TransportType::kHttp: {
+    MCP::HttpTransportOptions options;
+    options.tls = m_httpTls;
+    SetTransport(
+      std::make_shared<MCP::CHttpTransport>(m_httpHost, m_httpPort, options));
     break;
+  }
+#if defined(__linux__)
+  case TransportType::kUnix:
+    SetTransport(std::make_shared<MCP::CUnixSocketTransport>(m_unixSocketPath));
+    break;
+  case TransportType::kShm:
+    SetTransport(std::make_shared<MCP::CShmTransport>(m_unixSocketPath));
+    break;
+  case TransportType::kTcp:
+    SetTransport(std::make_shared<MCP::CTcpTransport>(m_httpHost, m_httpPort));
+    break;
+#endif
   default:
     return MCP::ERRNO_INTERNAL_ERROR;
   }
@@ -4,7 +4,7 @@
 
 namespace Implementation {
 
-enum class TransportType { kStdio, kHttp };
+enum class TransportType { kStdio, kHttp, kUnix, kShm, kTcp };
 
 // A server class for business operations is declared.
 // It is used to customize unique logic, but it must be a singleton.
@@ -18,12 +18,26 @@ public:
     m_transportType = type;
   }
 
-  // Set HTTP transport parameters (host and port)
+  // Set HTTP transport parameters (host and port), also used by the TCP
+  // transport
   void SetHttpTransportParams(const std::string& host, int port) {
     m_httpHost = host;
     m_httpPort = port;
   }
 
+  // Serve HTTPS with the certificate and key (PEM files)
+  void SetHttpTlsParams(
+    const std::string& certFile, const std::string& keyFile) {
+    m_httpTls.strCertFile = certFile;
+    m_httpTls.strKeyFile = keyFile;
+  }
+
+  // Set the Unix domain socket path, used by the Unix socket and the shared
+  // memory transports
+  void SetUnixSocketPath(const std::string& path) {
+    m_unixSocketPath = path;
+  }
+
   // This is the initialization method, which is used to configure the Server.
   // The Server can be started only after the configuration is successful.
   int Initialize() override;
@@ -36,6 +50,8 @@ private:
   TransportType m_transportType = TransportType::kStdio;
   std::string m_httpHost = "0.0.0.0";
   int m_httpPort = 8080;
+  MCP::HttpTlsOptions m_httpTls;
+  std::string m_unixSocketPath;
 };
 
 }  // namespace Implementation
@@ -1,22 +1,36 @@
 ﻿#include <signal.h>
+#if !defined(_WIN32)
+#include <pthread.h>
+#endif
 
 #include <cstring>
 #include <iostream>
+#include <thread>
 
 #include "EchoServer.h"
 
 int LaunchEchoServer(Implementation::TransportType transportType,
-  const std::string& host, int port) {
+  const std::string& host, int port, const std::string& unixPath,
+  const std::string& certFile, const std::string& keyFile, int workers,
+  const std::string& handoffPath) {
   // 1. Configure the Server with specified transport type.
   auto& server = Implementation::CEchoServer::GetInstance();
   auto& echoServer = static_cast<Implementation::CEchoServer&>(server);
   echoServer.SetTransportType(transportType);
-  if (transportType == Implementation::TransportType::kHttp) {
+  if (transportType == Implementation::TransportType::kHttp ||
+      transportType == Implementation::TransportType::kTcp) {
     echoServer.SetHttpTransportParams(host, port);
+    if (!certFile.empty())
+      echoServer.SetHttpTlsParams(certFile, keyFile);
+  } else if (transportType == Implementation::TransportType::kUnix ||
+             transportType == Implementation::TransportType::kShm) {
+    echoServer.SetUnixSocketPath(unixPath);
   }
   int iErrCode = server.Initialize();
   if (MCP::ERRNO_OK == iErrCode) {
-    // 2. Start the Server.
+    // 2. Start the Server, forking the worker processes if any.
+    server.SetWorkerProcesses(workers);
+    server.SetHandoffPath(handoffPath);
     iErrCode = server.Start();
     if (MCP::ERRNO_OK == iErrCode) {
       // 3. Stop the Server.
@@ -27,10 +41,39 @@ int LaunchEchoServer(Implementation::TransportType transportType,
   return iErrCode;
 }
 
+#if defined(_WIN32)
+// Windows runs the SIGINT handler on a thread of its own.
 void signal_handler(int signal) {
   auto& server = Implementation::CEchoServer::GetInstance();
   server.Stop();
 }
+#else
+// Stop() takes locks and joins threads, which a signal handler must not do.
+// SIGINT and SIGTERM stay blocked in every thread and are taken here.
+void get_stop_signals(sigset_t* signals) {
+  sigemptyset(signals);
+  sigaddset(signals, SIGINT);
+  sigaddset(signals, SIGTERM);
+}
+
+void signal_thread() {
+  sigset_t signals;
+  get_stop_signals(&signals);
+  while (true) {
+    int signal = 0;
+    if (sigwait(&signals, &signal) == 0) {
+      auto& server = Implementation::CEchoServer::GetInstance();
+      server.Stop();
+    }
+  }
+}
+
+// Also runs in each worker process forked by Start(), which has no copy of
+// the parent's threads.
+void start_signal_thread() {
+  std::thread(signal_thread).detach();
+}
+#endif
 
 void print_usage(const char* program_name) {
   std::cout
@@ -38,25 +81,53 @@ void print_usage(const char* program_name) {
     << "Options:\n"
     << "  --stdio              Use standard input/output transport (default)\n"
     << "  --http               Use HTTP transport (default: 0.0.0.0:8080)\n"
-    << "  --host <address>     HTTP server host address (default: 0.0.0.0)\n"
-    << "  --port <number>      HTTP server port (default: 8080)\n"
+    << "  --tcp                Use raw TCP transport (Linux)\n"
+    << "  --host <address>     HTTP/TCP host address (default: 0.0.0.0)\n"
+    << "  --port <number>      HTTP/TCP server port (default: 8080)\n"
+    << "  --cert <file>        Serve HTTPS with this PEM certificate\n"
+    << "  --key <file>         PEM private key of the certificate\n"
+    << "  --workers <number>   Serve HTTP from this many processes sharing\n"
+    << "                       the port (Linux, default: 1)\n"
+    << "  --unix <path>        Use Unix domain socket transport (Linux)\n"
+    << "  --shm <path>         Use shared memory transport, handed over on\n"
+    << "                       a Unix domain socket at <path> (Linux)\n"
+    << "  --handoff <path>     Take over the listeners of the server waiting\n"
+    << "                       on <path>, then wait there for the next one\n"
+    << "                       (Linux)\n"
     << "  --help               Show this help message\n"
     << "\nExamples:\n"
     << "  " << program_name << " --stdio\n"
     << "  " << program_name << " --http\n"
     << "  " << program_name << " --http --host 127.0.0.1 --port 3000\n"
+    << "  " << program_name << " --http --cert server.pem --key server.key\n"
+    << "  " << program_name << " --http --workers 4\n"
+    << "  " << program_name << " --http --handoff /tmp/mcp-handoff.sock\n"
     << std::endl;
 }
 
 int main(int argc, char* argv[]) {
+#if defined(_WIN32)
   signal(SIGINT, signal_handler);
   signal(SIGTERM, signal_handler);
+#else
+  // Blocked before any thread starts, so that every thread inherits it.
+  sigset_t signals;
+  get_stop_signals(&signals);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+  start_signal_thread();
+  pthread_atfork(nullptr, nullptr, start_signal_thread);
+#endif
 
   // Default to stdio transport
   Implementation::TransportType transportType =
     Implementation::TransportType::kStdio;
   std::string host = "0.0.0.0";
   int port = 8080;
+  std::string unixPath;
+  std::string certFile;
+  std::string keyFile;
+  int workers = 1;
+  std::string handoffPath;
 
   // Parse command line arguments
   for (int i = 1; i < argc; ++i) {
@@ -67,6 +138,69 @@ int main(int argc, char* argv[]) {
       transportType = Implementation::TransportType::kStdio;
     } else if (strcmp(argv[i], "--http") == 0) {
       transportType = Implementation::TransportType::kHttp;
+    } else if (strcmp(argv[i], "--tcp") == 0) {
+      transportType = Implementation::TransportType::kTcp;
+    } else if (strcmp(argv[i], "--unix") == 0) {
+      if (i + 1 < argc) {
+        transportType = Implementation::TransportType::kUnix;
+        unixPath = argv[++i];
+      } else {
+        std::cerr << "Error: --unix requires an argument" << std::endl;
+        print_usage(argv[0]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--shm") == 0) {
+      if (i + 1 < argc) {
+        transportType = Implementation::TransportType::kShm;
+        unixPath = argv[++i];
+      } else {
+        std::cerr << "Error: --shm requires an argument" << std::endl;
+        print_usage(argv[0]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--handoff") == 0) {
+      if (i + 1 < argc) {
+        handoffPath = argv[++i];
+      } else {
+        std::cerr << "Error: --handoff requires an argument" << std::endl;
+        print_usage(argv[0]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--cert") == 0) {
+      if (i + 1 < argc) {
+        certFile = argv[++i];
+      } else {
+        std::cerr << "Error: --cert requires an argument" << std::endl;
+        print_usage(argv[0]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--key") == 0) {
+      if (i + 1 < argc) {
+        keyFile = argv[++i];
+      } else {
+        std::cerr << "Error: --key requires an argument" << std::endl;
+        print_usage(argv[0]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--workers") == 0) {
+      if (i + 1 < argc) {
+        try {
+          workers = std::stoi(argv[++i]);
+          if (workers <= 0 || workers > 256) {
+            std::cerr << "Error: Workers must be between 1 and 256"
+                      << std::endl;
+            return 1;
+          }
+        } catch (const std::exception& e) {
+          std::cerr << "Error: Invalid number of workers" << std::endl;
+          print_usage(argv[0]);
+          return 1;
+        }
+      } else {
+        std::cerr << "Error: --workers requires an argument" << std::endl;
+        print_usage(argv[0]);
+        return 1;
+      }
     } else if (strcmp(argv[i], "--host") == 0) {
       if (i + 1 < argc) {
         host = argv[++i];
@@ -104,10 +238,40 @@ int main(int argc, char* argv[]) {
   if (transportType == Implementation::TransportType::kStdio) {
     std::cout << "Using Stdio Transport" << std::endl;
   } else if (transportType == Implementation::TransportType::kHttp) {
-    std::cout << "Using HTTP Transport (listening on " << host << ":" << port
+    std::cout << "Using " << (certFile.empty() ? "HTTP" : "HTTPS")
+              << " Transport (listening on " << host << ":" << port << ", "
+              << workers << (workers == 1 ? " process" : " processes") << ")"
+              << std::endl;
+  } else if (transportType == Implementation::TransportType::kTcp) {
+    std::cout << "Using TCP Transport (listening on " << host << ":" << port
+              << ")" << std::endl;
+  } else if (transportType == Implementation::TransportType::kUnix) {
+    std::cout << "Using Unix Socket Transport (listening on " << unixPath
+              << ")" << std::endl;
+  } else if (transportType == Implementation::TransportType::kShm) {
+    std::cout << "Using Shared Memory Transport (listening on " << unixPath
               << ")" << std::endl;
   }
 
-  return LaunchEchoServer(transportType, host, port);
+  if (workers > 1 && transportType != Implementation::TransportType::kHttp) {
+    std::cerr << "Error: --workers is only supported with --http" << std::endl;
+    return 1;
+  }
+
+  if (!handoffPath.empty() &&
+      (workers > 1 || transportType == Implementation::TransportType::kStdio ||
+        transportType == Implementation::TransportType::kShm)) {
+    std::cerr << "Error: --handoff is only supported with one process and"
+              << " --http, --tcp or --unix" << std::endl;
+    return 1;
+  }
+
+  if (certFile.empty() != keyFile.empty()) {
+    std::cerr << "Error: --cert and --key must be used together" << std::endl;
+    return 1;
+  }
+
+  return LaunchEchoServer(transportType, host, port, unixPath, certFile,
+    keyFile, workers, handoffPath);
 }
 
@@ -1,14 +1,33 @@
 #pragma once
 
+#if defined(__linux__)
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
 #include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
 #include <memory>
 #include <mutex>
+#include <string>
+#include <string_view>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include "../Public/Logger.h"
 #include "../Public/PublicDef.h"
+#include "../Public/SessionId.h"
 #include "../Session/Session.h"
+#include "../Session/SessionTable.h"
+#include "../Task/ToolRegistry.h"
+#include "../Transport/ListenerHandoff.h"
 #include "../Transport/Transport.h"
 
 namespace MCP {
@@ -42,15 +61,104 @@ public:
     m_capabilities.prompts = prompts;
   }
 
+  // Progress notifications of a call are coalesced to at most one per
+  // interval. Zero sends every update.
+  void SetProgressNotifyInterval(std::chrono::milliseconds interval) {
+    m_progressInterval = interval;
+  }
+
+  // Sessions unused for the timeout are dropped, unless tool calls are in
+  // flight or the client keeps a stream open. The least recently used are
+  // dropped beyond the count, unless in use as well. Zero disables either
+  // limit. Set before Start().
+  void SetSessionIdleTimeout(std::chrono::seconds idleTimeout) {
+    m_sessionIdleTimeout = idleTimeout;
+  }
+
+  void SetMaxSessions(size_t nMaxSessions) {
+    m_nMaxSessions = nMaxSessions;
+  }
+
+  // Stop() refuses new requests, lets the tool calls in progress finish for
+  // up to the timeout, then cancels the rest. It returns as soon as nothing
+  // runs anymore. Zero cancels them right away.
+  void SetDrainTimeout(std::chrono::milliseconds drainTimeout) {
+    m_drainTimeout = drainTimeout;
+  }
+
+  SessionStats GetSessionStats() const {
+    return m_sessionTable.GetStats();
+  }
+
+  // Serves from this many processes, forked by Start() once Initialize() has
+  // built the tools catalog, so its pages are shared copy-on-write. Each
+  // worker listens on the same port and owns the sessions it creates; the
+  // transport hands requests of another worker's session to that worker.
+  // Start() returns in a worker when it stops, and in the master once every
+  // worker exited. Tools changed after Start() only change in the calling
+  // process. Linux only, and the transport has to support it
+  // (CHttpTransport).
+  void SetWorkerProcesses(size_t nWorkers) {
+    m_nWorkerProcesses = nWorkers;
+  }
+
+  // Zero-downtime restart. Start() first takes over the listening sockets of
+  // the process serving with the same path, a Unix domain socket, then waits
+  // there for its own successor. Once one serves, this process stops
+  // accepting and drains as in Stop(), and Start() returns. Linux only, not
+  // with worker processes, and the transport has to support it
+  // (CHttpTransport, CUnixSocketTransport, CTcpTransport).
+  void SetHandoffPath(const std::string& strPath) {
+    m_strHandoffPath = strPath;
+  }
+
   void RegisterServerTools(
     const std::vector<MCP::Tool>& tools, bool bPagination) {
     m_bToolsPagination = bPagination;
-    m_tools = tools;
+    m_spToolRegistry->SetTools(tools);
   }
 
   void RegisterToolsTasks(const std::string& strToolName,
     std::shared_ptr<MCP::ProcessCallToolRequest> spTask) {
-    m_hashCallToolsTasks[strToolName] = spTask;
+    m_spToolRegistry->SetTask(strToolName, spTask);
+  }
+
+  // Tools registered with a pool reuse finished instances instead of calling
+  // Clone() for every call.
+  void RegisterToolsTaskPool(const std::string& strToolName,
+    std::shared_ptr<MCP::CToolTaskPool> spPool) {
+    m_spToolRegistry->SetTaskPool(strToolName, spPool);
+  }
+
+  // Adds or replaces a tool while the server is running. Sessions pick up the
+  // new catalog on their next request.
+  int AddServerTool(const MCP::Tool& tool,
+    std::shared_ptr<MCP::ProcessCallToolRequest> spTask) {
+    int iErrCode = m_spToolRegistry->AddTool(tool, spTask);
+    if (ERRNO_OK != iErrCode)
+      return iErrCode;
+
+    NotifyToolsListChanged();
+    return ERRNO_OK;
+  }
+
+  int AddServerTool(
+    const MCP::Tool& tool, std::shared_ptr<MCP::CToolTaskPool> spPool) {
+    int iErrCode = m_spToolRegistry->AddTool(tool, spPool);
+    if (ERRNO_OK != iErrCode)
+      return iErrCode;
+
+    NotifyToolsListChanged();
+    return ERRNO_OK;
+  }
+
+  int RemoveServerTool(std::string_view strToolName) {
+    int iErrCode = m_spToolRegistry->RemoveTool(strToolName);
+    if (ERRNO_OK != iErrCode)
+      return iErrCode;
+
+    NotifyToolsListChanged();
+    return ERRNO_OK;
   }
 
   virtual int Initialize() = 0;
@@ -59,95 +167,335 @@ public:
     if (!m_spTransport)
       m_spTransport = std::make_shared<CStdioTransport>();
 
-    int iErrCode = m_spTransport->Start();
-    if (ERRNO_OK != iErrCode) {
-      return iErrCode;
+    if (m_nWorkerProcesses > 1) {
+      if (!m_strHandoffPath.empty()) {
+        LOG_ERROR("Start: Handoff is not supported with worker processes");
+        return ERRNO_INVALID_PARAMS;
+      }
+      return RunWorkerProcesses();
     }
 
-    m_bRunning = true;
-    m_mainThread = std::make_unique<std::thread>([this]() { ServerLoop(); });
-    if (m_mainThread && m_mainThread->joinable())
-      m_mainThread->join();
-
-    return ERRNO_OK;
+    return Serve();
   }
 
   int Stop() {
-    m_bRunning = false;
+    // Also called by the handoff thread once a successor took over.
+    std::lock_guard<std::recursive_mutex> lockStop(m_mtxStop);
+#if defined(__linux__)
+    m_handoff.Close();
+    // The master only passes the request on.
+    for (pid_t pid : m_vecWorkerPids) {
+      if (pid > 0)
+        kill(pid, SIGTERM);
+    }
+#endif
+    {
+      std::lock_guard<std::mutex> lock(m_mtxReaper);
+      m_bRunning = false;
+    }
+    m_cvReaper.notify_all();
+    if (m_upReaperThread && m_upReaperThread->joinable()) {
+      m_upReaperThread->join();
+    }
+    {
+      std::vector<std::shared_ptr<CMCPSession>> vecRemoved;
+      {
+        std::lock_guard<std::mutex> lock(m_mtxReaper);
+        vecRemoved.swap(m_vecRemoved);
+      }
+      ReleaseSessions(vecRemoved);
+    }
 
+    // Calls in progress may finish until the deadline; the rest are
+    // cancelled.
+    auto tpDeadline = std::chrono::steady_clock::now() + m_drainTimeout;
     if (m_spTransport) {
-      m_spTransport->Stop();
+      m_spTransport->StopAccepting();
     }
-
-    auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(5);
-    while (std::chrono::steady_clock::now() < timeout) {
-      {
-        std::lock_guard<std::mutex> lock(m_threadsMutex);
-        if (m_activeThreads.empty()) {
-          break;
-        }
+    bool bIdle = WaitSessionsIdle(tpDeadline);
+    if (m_spTransport && !m_spTransport->WaitIdle(tpDeadline)) {
+      bIdle = false;
+    }
+    if (!bIdle) {
+      LOG_WARNING("Stop: Calls still running after {} ms, cancelling them",
+        m_drainTimeout.count());
+      CancelSessions();
+
+      // Cancelled calls may still answer.
+      auto tpCancelled = std::chrono::steady_clock::now() + CANCEL_STOP_TIMEOUT;
+      WaitSessionsIdle(tpCancelled);
+      if (m_spTransport) {
+        m_spTransport->WaitIdle(tpCancelled);
       }
-      std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
 
+    if (m_spTransport) {
+      m_spTransport->Stop();
+    }
+
+    // The server loop and session threads end once the transport has closed
+    // their channels.
     {
-      std::lock_guard<std::mutex> lock(m_threadsMutex);
-      if (!m_activeThreads.empty()) {
+      std::unique_lock<std::mutex> lock(m_threadsMutex);
+      if (!m_cvThreads.wait_for(lock, SESSION_THREADS_STOP_TIMEOUT, [this]() {
+            return m_activeThreads.empty() && !m_bServerLoopRunning;
+          })) {
         LOG_WARNING("Stop: {} threads still active during shutdown",
           m_activeThreads.size());
       }
       m_activeThreads.clear();
-      m_hashSessions.clear();
+    }
+    {
+      // Shut down outside the lock.
+      std::unordered_map<IChannel*, std::shared_ptr<CMCPSession>> hashClosed;
+      std::lock_guard<std::mutex> lock(m_mtxConnections);
+      hashClosed.swap(m_hashConnections);
+    }
+    m_sessionTable.Clear();
+    {
+      std::lock_guard<std::mutex> lock(m_mtxLiveSessions);
+      m_vecLiveSessions.clear();
     }
 
     return ERRNO_OK;
   }
 
 private:
-  void ServerLoop() {
-    while (m_bRunning.load()) {
-      auto spChannel = m_spTransport->AcceptChannel();
-      if (!spChannel || !m_bRunning.load()) {
+  // Serves on this process until Stop().
+  int Serve() {
+    m_spTransport->SetDispatchHandler(
+      [this](const std::shared_ptr<IChannel>& spChannel) {
+        DispatchChannel(spChannel);
+      });
+    m_spTransport->SetSessionEndHandler(
+      [this](const std::string& strSessionId) {
+        std::vector<std::shared_ptr<CMCPSession>> vecDeleted;
+        auto spSession = m_sessionTable.Delete(strSessionId);
+        if (spSession) {
+          vecDeleted.push_back(std::move(spSession));
+          QueueRemoved(vecDeleted);
+        }
+      });
+    m_sessionTable.SetLimits(m_sessionIdleTimeout, m_nMaxSessions);
+
+    int iErrCode = TakeOverListeners();
+    if (ERRNO_OK != iErrCode)
+      return iErrCode;
+
+    m_bRunning = true;
+    iErrCode = m_spTransport->Start();
+#if defined(__linux__)
+    if (!m_strHandoffPath.empty()) {
+      int iConfirmed = m_handoff.Confirm(ERRNO_OK == iErrCode);
+      // Unconfirmed, the predecessor keeps serving and keeps the path; this
+      // process leaves the listeners to it.
+      if (ERRNO_OK == iErrCode && ERRNO_OK != iConfirmed) {
+        LOG_ERROR("Serve: Handoff on '{}' not confirmed, stopping",
+          m_strHandoffPath);
+        m_spTransport->ReleaseListeners();
+        Stop();
+        return iConfirmed;
+      }
+    }
+#endif
+    if (ERRNO_OK != iErrCode) {
+      m_bRunning = false;
+      return iErrCode;
+    }
+    WaitForSuccessor();
+
+    m_upReaperThread =
+      std::make_unique<std::thread>([this]() { ExpireSessionsLoop(); });
+
+    {
+      std::lock_guard<std::mutex> lock(m_threadsMutex);
+      m_bServerLoopRunning = true;
+    }
+    m_mainThread = std::make_unique<std::thread>([this]() {
+      ServerLoop();
+      std::lock_guard<std::mutex> lock(m_threadsMutex);
+      m_bServerLoopRunning = false;
+      m_cvThreads.notify_all();
+    });
+    if (m_mainThread && m_mainThread->joinable())
+      m_mainThread->join();
+
+    return ERRNO_OK;
+  }
+
+  // Hands the listeners of the process being replaced, if any, to the
+  // transport.
+  int TakeOverListeners() {
+    if (m_strHandoffPath.empty())
+      return ERRNO_OK;
+
+#if defined(__linux__)
+    std::vector<int> vecFds;
+    int iErrCode = m_handoff.Receive(m_strHandoffPath, vecFds);
+    if (ERRNO_OK == iErrCode)
+      iErrCode = m_spTransport->PrepareHandoff(vecFds);
+    if (ERRNO_OK != iErrCode) {
+      LOG_ERROR("TakeOverListeners: Failed to take over on '{}'",
+        m_strHandoffPath);
+      for (int fd : vecFds) {
+        close(fd);
+      }
+      m_handoff.Confirm(false);
+    }
+    return iErrCode;
+#else
+    LOG_ERROR("TakeOverListeners: Handoff is only supported on Linux");
+    return ERRNO_INVALID_PARAMS;
+#endif
+  }
+
+  // Lets a successor take over the listeners; this process then drains.
+  void WaitForSuccessor() {
+#if defined(__linux__)
+    if (m_strHandoffPath.empty())
+      return;
+
+    int iErrCode = m_handoff.Listen(
+      m_strHandoffPath,
+      [this]() { return m_spTransport->GetListeners(); },
+      [this]() {
+        LOG_INFO("WaitForSuccessor: Taken over, draining");
+        m_spTransport->ReleaseListeners();
+        Stop();
+      });
+    if (ERRNO_OK != iErrCode) {
+      LOG_WARNING("WaitForSuccessor: No successor can take over on '{}'",
+        m_strHandoffPath);
+    }
+#endif
+  }
+
+  // The master of pre-fork mode: forks the workers and replaces those that
+  // die until Stop().
+  int RunWorkerProcesses() {
+#if defined(__linux__)
+    int iErrCode = m_spTransport->PrepareWorkers(m_nWorkerProcesses);
+    if (ERRNO_OK != iErrCode)
+      return iErrCode;
+
+    m_bRunning = true;
+    m_vecWorkerPids.assign(m_nWorkerProcesses, 0);
+    pid_t masterPid = getpid();
+    for (size_t i = 0; i < m_nWorkerProcesses && m_bRunning.load(); ++i) {
+      pid_t pid = ForkWorker();
+      if (0 == pid)
+        return ServeAsWorker(i, masterPid);
+      if (pid < 0) {
+        LOG_ERROR("RunWorkerProcesses: fork failed, error code: {}", errno);
+        Stop();
+        iErrCode = ERRNO_INTERNAL_ERROR;
         break;
       }
+      m_vecWorkerPids[i] = pid;
+    }
+    if (ERRNO_OK == iErrCode) {
+      LOG_INFO("RunWorkerProcesses: {} workers started, master pid {}",
+        m_nWorkerProcesses, masterPid);
+    }
 
-      std::shared_ptr<CMCPSession> spSession;
-      auto sessionId = spChannel->GetAttribute(HEADER_SESSION_ID);
-      if (!sessionId.empty()) {
-        std::lock_guard<std::mutex> lock(m_threadsMutex);
-        auto iter = m_hashSessions.find(sessionId);
-        if (iter != m_hashSessions.end()) {
-          spSession = iter->second;
-          spSession->SetChannel(spChannel);
-        }
+    while (true) {
+      int iStatus = 0;
+      pid_t pid = waitpid(-1, &iStatus, 0);
+      if (pid < 0) {
+        if (EINTR == errno)
+          continue;
+        // No workers left.
+        break;
       }
 
+      auto itr = std::find(m_vecWorkerPids.begin(), m_vecWorkerPids.end(), pid);
+      if (itr == m_vecWorkerPids.end())
+        continue;
+      *itr = 0;
+      if (!m_bRunning.load())
+        continue;
+
+      size_t nWorker = static_cast<size_t>(itr - m_vecWorkerPids.begin());
+      LOG_WARNING("RunWorkerProcesses: Worker {} (pid {}) exited with status "
+                  "{}, restarting it",
+        nWorker, pid, iStatus);
+      // Keeps a worker that fails on start from being forked in a loop.
+      std::this_thread::sleep_for(WORKER_RESTART_DELAY);
+      if (!m_bRunning.load())
+        continue;
+      pid = ForkWorker();
+      if (0 == pid)
+        return ServeAsWorker(nWorker, masterPid);
+      if (pid < 0) {
+        LOG_ERROR("RunWorkerProcesses: fork failed, error code: {}", errno);
+        continue;
+      }
+      *itr = pid;
+      // Stop() may have run between the check and the fork.
+      if (!m_bRunning.load())
+        kill(pid, SIGTERM);
+    }
+
+    LOG_INFO("RunWorkerProcesses: All workers exited");
+    return iErrCode;
+#else
+    LOG_ERROR("RunWorkerProcesses: Worker processes are not supported");
+    return ERRNO_INVALID_PARAMS;
+#endif
+  }
+
+#if defined(__linux__)
+  pid_t ForkWorker() {
+    // Buffered output would otherwise be written by every process.
+    fflush(nullptr);
+    Logger::Instance().Flush();
+    return fork();
+  }
+
+  int ServeAsWorker(size_t nWorker, pid_t masterPid) {
+    // Workers do not outlive the master.
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    if (getppid() != masterPid)
+      return ERRNO_INTERNAL_ERROR;
+
+    m_vecWorkerPids.clear();
+    SetSessionIdWorker(nWorker);
+    m_spTransport->SetWorker(nWorker);
+    LOG_INFO("ServeAsWorker: Worker {} serving, pid {}", nWorker, getpid());
+    return Serve();
+  }
+#endif
+
+  void NotifyToolsListChanged() {
+    if (!m_capabilities.tools.bListChanged)
+      return;
+
+    for (auto& spSession : GetLiveSessions()) {
+      spSession->NotifyToolsListChanged();
+    }
+  }
+
+  // Runs every accepted channel on a thread of its own. Transports with a
+  // dispatch handler hand their channels to DispatchChannel() instead.
+  // Channels the transport accepted before it stopped accepting are still
+  // served while Stop() drains.
+  void ServerLoop() {
+    while (true) {
+      auto spChannel = m_spTransport->AcceptChannel();
+      if (!spChannel) {
+        break;
+      }
+
+      auto spSession = AttachSession(spChannel);
       if (!spSession) {
-        spSession = std::make_shared<CMCPSession>(spChannel);
-        if (!spSession) {
-          continue;
-        }
-        spSession->SetServerInfo(m_serverInfo);
-        spSession->SetServerCapabilities(m_capabilities);
-        spSession->SetServerToolsPagination(m_bToolsPagination);
-        spSession->SetServerTools(m_tools);
-        spSession->SetServerCallToolsTasks(m_hashCallToolsTasks);
+        continue;
       }
 
       auto spThread = std::make_shared<std::thread>([this, spSession]() {
-        spSession->Run();
+        RunSession(spSession);
         std::lock_guard<std::mutex> lock(m_threadsMutex);
-        if (spSession->GetSessionState() != CMCPSession::SessionState_Shut) {
-          auto& sessionId = spSession->GetSessionId();
-          if (sessionId.empty())
-            LOG_ERROR("Session::Run: Session ID not set");
-          else {
-            this->m_hashSessions.emplace(sessionId, spSession);
-          }
-        } else
-          this->m_hashSessions.erase(spSession->GetSessionId());
-
         m_activeThreads.erase(std::this_thread::get_id());
+        m_cvThreads.notify_all();
       });
 
       if (spThread) {
@@ -158,6 +506,224 @@ private:
     }
   }
 
+  // Serves a channel handed over by the transport on the calling thread.
+  void DispatchChannel(const std::shared_ptr<IChannel>& spChannel) {
+    if (spChannel->IsPersistent()) {
+      DispatchConnection(spChannel);
+      return;
+    }
+
+    // While Stop() drains, every request the transport read is served, also
+    // one starting a session: after a handoff it came over a connection
+    // accepted before the successor took over.
+    auto spSession = AttachSession(spChannel);
+    if (spSession) {
+      RunSession(spSession);
+    }
+  }
+
+  // Serves the messages a connection has queued with the connection's own
+  // session, which is kept from one dispatch to the next until the input
+  // ends.
+  void DispatchConnection(const std::shared_ptr<IChannel>& spChannel) {
+    std::shared_ptr<CMCPSession> spSession;
+    {
+      std::lock_guard<std::mutex> lock(m_mtxConnections);
+      auto itr = m_hashConnections.find(spChannel.get());
+      if (itr != m_hashConnections.end())
+        spSession = itr->second;
+    }
+    if (!spSession) {
+      // Connections accepted before Stop() are served while it drains, even
+      // if their first message comes later.
+      if (!spChannel->IsActive())
+        return;
+      spSession = AttachSession(spChannel);
+      if (!spSession) {
+        spChannel->Close();
+        return;
+      }
+      std::lock_guard<std::mutex> lock(m_mtxConnections);
+      m_hashConnections[spChannel.get()] = spSession;
+    }
+
+    if (ERRNO_INTERNAL_INPUT_PENDING == spSession->Run())
+      return;
+    {
+      std::lock_guard<std::mutex> lock(m_mtxConnections);
+      m_hashConnections.erase(spChannel.get());
+    }
+    KeepSession(spSession);
+  }
+
+  // Returns the session named by the channel, or a new one.
+  std::shared_ptr<CMCPSession> AttachSession(
+    const std::shared_ptr<IChannel>& spChannel) {
+    auto sessionId = spChannel->GetAttribute(HEADER_SESSION_ID);
+    if (!sessionId.empty()) {
+      auto spSession = m_sessionTable.Find(sessionId);
+      if (spSession) {
+        spSession->SetChannel(spChannel);
+        return spSession;
+      }
+    }
+
+    auto spSession = std::make_shared<CMCPSession>(spChannel);
+    if (!spSession) {
+      return nullptr;
+    }
+    spSession->SetServerInfo(m_serverInfo);
+    spSession->SetServerCapabilities(m_capabilities);
+    spSession->SetServerToolsPagination(m_bToolsPagination);
+    spSession->SetToolRegistry(m_spToolRegistry);
+    spSession->SetProgressNotifyInterval(m_progressInterval);
+
+    std::lock_guard<std::mutex> lock(m_mtxLiveSessions);
+    m_vecLiveSessions.erase(
+      std::remove_if(m_vecLiveSessions.begin(), m_vecLiveSessions.end(),
+        [](const std::weak_ptr<CMCPSession>& wpSession) {
+          return wpSession.expired();
+        }),
+      m_vecLiveSessions.end());
+    m_vecLiveSessions.push_back(spSession);
+    return spSession;
+  }
+
+  // Runs the session until its channel has no more input, then keeps it for
+  // later requests unless it was shut down.
+  void RunSession(const std::shared_ptr<CMCPSession>& spSession) {
+    spSession->Run();
+    KeepSession(spSession);
+  }
+
+  void KeepSession(const std::shared_ptr<CMCPSession>& spSession) {
+    if (spSession->GetSessionState() != CMCPSession::SessionState_Shut) {
+      auto& sessionId = spSession->GetSessionId();
+      if (sessionId.empty())
+        LOG_ERROR("Session::Run: Session ID not set");
+      else {
+        std::vector<std::shared_ptr<CMCPSession>> vecEvicted;
+        m_sessionTable.Insert(spSession, vecEvicted,
+          [this](const std::shared_ptr<CMCPSession>& spOther) {
+            return IsSessionInUse(spOther);
+          });
+        if (!vecEvicted.empty()) {
+          LOG_INFO("RunSession: {} sessions over the limit of {} dropped",
+            vecEvicted.size(), m_nMaxSessions);
+          QueueRemoved(vecEvicted);
+        }
+      }
+    } else
+      m_sessionTable.Erase(spSession->GetSessionId());
+  }
+
+  // Shutting a session down waits for its task thread, so sessions evicted
+  // or ended by the client while serving a request are left to the reaper
+  // thread. Once stopping, the caller does it.
+  void QueueRemoved(std::vector<std::shared_ptr<CMCPSession>>& vecRemoved) {
+    {
+      std::lock_guard<std::mutex> lock(m_mtxReaper);
+      if (m_bRunning.load()) {
+        for (auto& spSession : vecRemoved) {
+          m_vecRemoved.push_back(std::move(spSession));
+        }
+        vecRemoved.clear();
+        m_cvReaper.notify_all();
+        return;
+      }
+    }
+    ReleaseSessions(vecRemoved);
+  }
+
+  // Sessions with tool calls in flight or an open stream are not idle.
+  bool IsSessionInUse(const std::shared_ptr<CMCPSession>& spSession) {
+    return !spSession->WaitTasksIdle(std::chrono::steady_clock::now()) ||
+           m_spTransport->HasSessionStream(spSession->GetSessionId());
+  }
+
+  // Until Stop(), shuts down removed sessions and drops those idle for
+  // longer than the timeout.
+  void ExpireSessionsLoop() {
+    auto interval = std::clamp(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+        m_sessionIdleTimeout / 4),
+      std::chrono::milliseconds(1000), std::chrono::milliseconds(60000));
+    bool bExpire = m_sessionIdleTimeout.count() > 0;
+    auto tpNextExpiry = std::chrono::steady_clock::now() + interval;
+    auto fnInUse = [this](const std::shared_ptr<CMCPSession>& spSession) {
+      return IsSessionInUse(spSession);
+    };
+
+    std::unique_lock<std::mutex> lock(m_mtxReaper);
+    while (m_bRunning.load()) {
+      auto fnWake = [this]() {
+        return !m_bRunning.load() || !m_vecRemoved.empty();
+      };
+      if (bExpire)
+        m_cvReaper.wait_until(lock, tpNextExpiry, fnWake);
+      else
+        m_cvReaper.wait(lock, fnWake);
+      if (!m_bRunning.load())
+        break;
+
+      std::vector<std::shared_ptr<CMCPSession>> vecSessions;
+      vecSessions.swap(m_vecRemoved);
+      lock.unlock();
+      ReleaseSessions(vecSessions);
+
+      auto tpNow = std::chrono::steady_clock::now();
+      if (bExpire && tpNow >= tpNextExpiry) {
+        tpNextExpiry = tpNow + interval;
+        m_sessionTable.ExpireIdle(vecSessions, fnInUse);
+        if (!vecSessions.empty()) {
+          auto stats = m_sessionTable.GetStats();
+          LOG_INFO("ExpireSessionsLoop: {} idle sessions expired, {} left",
+            vecSessions.size(), stats.nSessions);
+          ReleaseSessions(vecSessions);
+        }
+      }
+      lock.lock();
+    }
+  }
+
+  std::vector<std::shared_ptr<CMCPSession>> GetLiveSessions() {
+    std::vector<std::shared_ptr<CMCPSession>> vecSessions;
+    std::lock_guard<std::mutex> lock(m_mtxLiveSessions);
+    for (auto& wpSession : m_vecLiveSessions) {
+      auto spSession = wpSession.lock();
+      if (spSession)
+        vecSessions.push_back(spSession);
+    }
+
+    return vecSessions;
+  }
+
+  // Returns false if tool calls are still running at the deadline.
+  bool WaitSessionsIdle(std::chrono::steady_clock::time_point tpDeadline) {
+    bool bIdle = true;
+    for (auto& spSession : GetLiveSessions()) {
+      if (!spSession->WaitTasksIdle(tpDeadline))
+        bIdle = false;
+    }
+
+    return bIdle;
+  }
+
+  void CancelSessions() {
+    for (auto& spSession : GetLiveSessions()) {
+      spSession->CancelTasks();
+    }
+  }
+
+  // Shuts down sessions removed from the table.
+  void ReleaseSessions(std::vector<std::shared_ptr<CMCPSession>>& vecSessions) {
+    for (auto& spSession : vecSessions) {
+      m_spTransport->EndSession(spSession->GetSessionId());
+      spSession->Terminate();
+    }
+    vecSessions.clear();
+  }
+
 protected:
   CMCPServer() = default;
   ~CMCPServer() = default;
@@ -166,16 +732,49 @@ protected:
   MCP::Implementation m_serverInfo;
   MCP::ServerCapabilities m_capabilities;
   bool m_bToolsPagination{ false };
-  std::vector<MCP::Tool> m_tools;
-  std::unordered_map<std::string, std::shared_ptr<MCP::ProcessCallToolRequest>>
-    m_hashCallToolsTasks;
+  std::chrono::milliseconds m_progressInterval{
+    DEFAULT_PROGRESS_NOTIFY_INTERVAL_MS
+  };
+  std::shared_ptr<MCP::CToolRegistry> m_spToolRegistry{
+    std::make_shared<MCP::CToolRegistry>()
+  };
   std::atomic<bool> m_bRunning{ false };
-  std::unordered_map<std::string, std::shared_ptr<CMCPSession>> m_hashSessions;
-
+  CSessionTable m_sessionTable;
+  std::chrono::seconds m_sessionIdleTimeout{ DEFAULT_SESSION_IDLE_TIMEOUT_S };
+  size_t m_nMaxSessions{ DEFAULT_MAX_SESSIONS };
+  std::unique_ptr<std::thread> m_upReaperThread;
+  std::mutex m_mtxReaper;
+  std::condition_variable m_cvReaper;
+  // Evicted and deleted sessions waiting for the reaper thread.
+  std::vector<std::shared_ptr<CMCPSession>> m_vecRemoved;
+  std::chrono::milliseconds m_drainTimeout{ DEFAULT_DRAIN_TIMEOUT_MS };
+  static constexpr std::chrono::milliseconds CANCEL_STOP_TIMEOUT{ 500 };
+
+  size_t m_nWorkerProcesses{ 1 };
+#if defined(__linux__)
+  static constexpr std::chrono::seconds WORKER_RESTART_DELAY{ 1 };
+  std::vector<pid_t> m_vecWorkerPids;
+#endif
+  std::string m_strHandoffPath;
+#if defined(__linux__)
+  CListenerHandoff m_handoff;
+#endif
+  std::recursive_mutex m_mtxStop;
+
+  static constexpr std::chrono::seconds SESSION_THREADS_STOP_TIMEOUT{ 1 };
   std::unique_ptr<std::thread> m_mainThread;
   mutable std::mutex m_threadsMutex;
+  std::condition_variable m_cvThreads;
+  bool m_bServerLoopRunning{ false };
   std::unordered_map<std::thread::id, std::shared_ptr<std::thread>>
     m_activeThreads;
+  // Sessions of the persistent channels being dispatched.
+  std::mutex m_mtxConnections;
+  std::unordered_map<IChannel*, std::shared_ptr<CMCPSession>>
+    m_hashConnections;
+  // Only touched when a session is created or the tool list changes.
+  std::mutex m_mtxLiveSessions;
+  std::vector<std::weak_ptr<CMCPSession>> m_vecLiveSessions;
 };
 
 }  // namespace MCP
@@ -84,6 +84,15 @@ bool CancelledNotification::IsValid() const {
   return requestId.IsValid();
 }
 
+////////////////////////////////////////////////////////////////////////////////////////
+// ToolListChangedNotification
+bool ToolListChangedNotification::IsValid() const {
+  if (strMethod.compare(METHOD_NOTIFICATION_TOOLS_LIST_CHANGED) != 0)
+    return false;
+
+  return true;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////
 // ProgressNotification
 int ProgressNotification::DoSerialize(Json::Value& jMsg) const {
@@ -36,6 +36,14 @@ public:
   int DoDeserialize(const Json::Value& jMsg) override;
 };
 
+struct ToolListChangedNotification : public MCP::Notification {
+public:
+  ToolListChangedNotification(bool bNeedIdentity)
+    : Notification(MessageType_ToolListChangedNotification, bNeedIdentity) {}
+
+  bool IsValid() const override;
+};
+
 struct ProgressNotification : public MCP::Notification {
 public:
   ProgressNotification(bool bNeedIdentity)
@@ -0,0 +1,431 @@
+#include "Compression.h"
+
+#if defined(TINYMCP_ZLIB)
+#include <zlib.h>
+#endif
+
+#include <cctype>
+#include <cstdint>
+
+#include "Logger.h"
+#include "PublicDef.h"
+
+namespace MCP {
+
+static std::string_view TrimSpace(std::string_view text) {
+  while (!text.empty() && std::isspace(static_cast<unsigned char>(text[0]))) {
+    text.remove_prefix(1);
+  }
+  while (!text.empty() &&
+         std::isspace(static_cast<unsigned char>(text[text.size() - 1]))) {
+    text.remove_suffix(1);
+  }
+  return text;
+}
+
+static bool EqualsNoCase(std::string_view left, std::string_view right) {
+  if (left.size() != right.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < left.size(); ++i) {
+    if (std::tolower(static_cast<unsigned char>(left[i])) !=
+        std::tolower(static_cast<unsigned char>(right[i]))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+ContentEncoding NegotiateEncoding(std::string_view strAcceptEncoding) {
+#if defined(TINYMCP_ZLIB)
+  // -1: not listed, 0: refused with q=0, 1: accepted.
+  int iGzip = -1;
+  int iDeflate = -1;
+  int iAny = -1;
+
+  size_t nPos = 0;
+  while (nPos < strAcceptEncoding.size()) {
+    size_t nEnd = strAcceptEncoding.find(',', nPos);
+    if (nEnd == std::string_view::npos) {
+      nEnd = strAcceptEncoding.size();
+    }
+    auto item = strAcceptEncoding.substr(nPos, nEnd - nPos);
+    nPos = nEnd + 1;
+
+    size_t nSemicolon = item.find(';');
+    auto coding = TrimSpace(item.substr(0, nSemicolon));
+    int iAccepted = 1;
+    if (nSemicolon != std::string_view::npos) {
+      auto params = item.substr(nSemicolon + 1);
+      size_t nQ = params.find("q=");
+      if (nQ != std::string_view::npos) {
+        auto qvalue = TrimSpace(params.substr(nQ + 2));
+        qvalue = qvalue.substr(0, qvalue.find(';'));
+        iAccepted = qvalue.find_first_not_of("0.") == std::string_view::npos
+                      ? 0
+                      : 1;
+      }
+    }
+
+    if (EqualsNoCase(coding, "gzip") || EqualsNoCase(coding, "x-gzip")) {
+      iGzip = iAccepted;
+    } else if (EqualsNoCase(coding, "deflate")) {
+      iDeflate = iAccepted;
+    } else if (coding == "*") {
+      iAny = iAccepted;
+    }
+  }
+
+  if (iGzip == 1 || (iGzip == -1 && iAny == 1)) {
+    return ContentEncoding_Gzip;
+  }
+  if (iDeflate == 1 || (iDeflate == -1 && iAny == 1)) {
+    return ContentEncoding_Deflate;
+  }
+#endif
+  return ContentEncoding_Identity;
+}
+
+const char* GetEncodingName(ContentEncoding eEncoding) {
+  switch (eEncoding) {
+  case ContentEncoding_Gzip:
+    return "gzip";
+  case ContentEncoding_Deflate:
+    return "deflate";
+  default:
+    return "identity";
+  }
+}
+
+#if defined(TINYMCP_ZLIB)
+// Runs deflate over the input until it is consumed and flushed, appending
+// the output to strOut.
+static int RunDeflate(
+  z_stream& stream, std::string_view strData, int iFlush, std::string& strOut) {
+  stream.next_in =
+    reinterpret_cast<Bytef*>(const_cast<char*>(strData.data()));
+  stream.avail_in = static_cast<uInt>(strData.size());
+
+  size_t nBase = strOut.size();
+  size_t nCapacity = deflateBound(&stream, strData.size()) + 16;
+  do {
+    strOut.resize(nBase + nCapacity);
+    stream.next_out = reinterpret_cast<Bytef*>(&strOut[nBase]);
+    stream.avail_out = static_cast<uInt>(nCapacity);
+
+    int iResult = deflate(&stream, iFlush);
+    if (iResult == Z_STREAM_ERROR) {
+      strOut.resize(nBase);
+      return ERRNO_INTERNAL_ERROR;
+    }
+    nBase += nCapacity - stream.avail_out;
+  } while (stream.avail_out == 0);
+
+  strOut.resize(nBase);
+  return ERRNO_OK;
+}
+
+// Raw deflate data of one part of a message. Parts other than the last end
+// with a sync flush, on a byte boundary and without the final block flag.
+static int DeflateRaw(
+  std::string_view strData, int iLevel, bool bLast, std::string& strOut) {
+  z_stream stream{};
+  if (deflateInit2(&stream, iLevel, Z_DEFLATED, -MAX_WBITS, 8,
+        Z_DEFAULT_STRATEGY) != Z_OK) {
+    LOG_ERROR("DeflateRaw: deflateInit2 failed");
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  int iErrCode = RunDeflate(stream, strData, bLast ? Z_FINISH : Z_SYNC_FLUSH,
+    strOut);
+  deflateEnd(&stream);
+  return iErrCode;
+}
+
+static void AppendLittleEndian(std::string& strOut, uint32_t uValue) {
+  for (int i = 0; i < 4; ++i) {
+    strOut.push_back(static_cast<char>((uValue >> (8 * i)) & 0xff));
+  }
+}
+
+static void AppendBigEndian(std::string& strOut, uint32_t uValue) {
+  for (int i = 3; i >= 0; --i) {
+    strOut.push_back(static_cast<char>((uValue >> (8 * i)) & 0xff));
+  }
+}
+#endif
+
+int CompressMessage(std::string_view strMessage, ContentEncoding eEncoding,
+  int iLevel, std::string& strCompressed, const EmbeddedText& embedded) {
+  strCompressed.clear();
+  if (eEncoding == ContentEncoding_Identity) {
+    strCompressed.assign(strMessage.data(), strMessage.size());
+    return ERRNO_OK;
+  }
+
+#if defined(TINYMCP_ZLIB)
+  bool bGzip = eEncoding == ContentEncoding_Gzip;
+  strCompressed.reserve(strMessage.size() / 4 + 64);
+  if (bGzip) {
+    static constexpr char GZIP_HEADER[] = { '\x1f', '\x8b', '\x08', '\x00',
+      '\x00', '\x00', '\x00', '\x00', '\x00', '\xff' };
+    strCompressed.append(GZIP_HEADER, sizeof(GZIP_HEADER));
+  } else {
+    strCompressed.append("\x78\x9c", 2);
+  }
+
+  uLong ulCrc32 = crc32(0, Z_NULL, 0);
+  uLong ulAdler32 = adler32(0, Z_NULL, 0);
+  auto fnChecksum = [&](std::string_view strPart) {
+    auto pData = reinterpret_cast<const Bytef*>(strPart.data());
+    auto nSize = static_cast<uInt>(strPart.size());
+    if (bGzip) {
+      ulCrc32 = crc32(ulCrc32, pData, nSize);
+    } else {
+      ulAdler32 = adler32(ulAdler32, pData, nSize);
+    }
+  };
+
+  std::shared_ptr<const CPrecompressedTexts::Segment> spSegment;
+  size_t nOffset = embedded.nOffset;
+  size_t nSize = embedded.spText ? embedded.spText->size() : 0;
+  if (embedded.spText && nOffset <= strMessage.size() &&
+      nSize <= strMessage.size() - nOffset &&
+      strMessage.compare(nOffset, nSize, *embedded.spText) == 0) {
+    spSegment =
+      CPrecompressedTexts::GetInstance().GetSegment(embedded.spText, iLevel);
+  }
+  if (spSegment) {
+    auto strPrefix = strMessage.substr(0, nOffset);
+    auto strSuffix = strMessage.substr(nOffset + nSize);
+    if (ERRNO_OK != DeflateRaw(strPrefix, iLevel, false, strCompressed)) {
+      return ERRNO_INTERNAL_ERROR;
+    }
+    fnChecksum(strPrefix);
+
+    strCompressed.append(spSegment->strData);
+    if (bGzip) {
+      ulCrc32 = crc32_combine(ulCrc32, spSegment->ulCrc32,
+        static_cast<z_off_t>(spSegment->nSize));
+    } else {
+      ulAdler32 = adler32_combine(ulAdler32, spSegment->ulAdler32,
+        static_cast<z_off_t>(spSegment->nSize));
+    }
+
+    if (ERRNO_OK != DeflateRaw(strSuffix, iLevel, true, strCompressed)) {
+      return ERRNO_INTERNAL_ERROR;
+    }
+    fnChecksum(strSuffix);
+  } else {
+    if (ERRNO_OK != DeflateRaw(strMessage, iLevel, true, strCompressed)) {
+      return ERRNO_INTERNAL_ERROR;
+    }
+    fnChecksum(strMessage);
+  }
+
+  if (bGzip) {
+    AppendLittleEndian(strCompressed, static_cast<uint32_t>(ulCrc32));
+    AppendLittleEndian(
+      strCompressed, static_cast<uint32_t>(strMessage.size()));
+  } else {
+    AppendBigEndian(strCompressed, static_cast<uint32_t>(ulAdler32));
+  }
+  return ERRNO_OK;
+#else
+  return ERRNO_INTERNAL_ERROR;
+#endif
+}
+
+CCompressStream::~CCompressStream() {
+#if defined(TINYMCP_ZLIB)
+  if (m_pStream) {
+    auto pStream = static_cast<z_stream*>(m_pStream);
+    deflateEnd(pStream);
+    delete pStream;
+  }
+#endif
+}
+
+int CCompressStream::Begin(ContentEncoding eEncoding, int iLevel) {
+#if defined(TINYMCP_ZLIB)
+  if (m_pStream || eEncoding == ContentEncoding_Identity) {
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  // zlib writes the gzip or zlib wrapper itself for these window bits.
+  int iWindowBits =
+    eEncoding == ContentEncoding_Gzip ? MAX_WBITS + 16 : MAX_WBITS;
+  auto pStream = new z_stream{};
+  if (deflateInit2(pStream, iLevel, Z_DEFLATED, iWindowBits, 8,
+        Z_DEFAULT_STRATEGY) != Z_OK) {
+    LOG_ERROR("CCompressStream::Begin: deflateInit2 failed");
+    delete pStream;
+    return ERRNO_INTERNAL_ERROR;
+  }
+  m_pStream = pStream;
+  return ERRNO_OK;
+#else
+  return ERRNO_INTERNAL_ERROR;
+#endif
+}
+
+int CCompressStream::Write(
+  std::string_view strData, std::string& strCompressed) {
+#if defined(TINYMCP_ZLIB)
+  return Deflate(strData, Z_SYNC_FLUSH, strCompressed);
+#else
+  return ERRNO_INTERNAL_ERROR;
+#endif
+}
+
+int CCompressStream::End(std::string& strCompressed) {
+#if defined(TINYMCP_ZLIB)
+  return Deflate(std::string_view(), Z_FINISH, strCompressed);
+#else
+  return ERRNO_INTERNAL_ERROR;
+#endif
+}
+
+int CCompressStream::Deflate(
+  std::string_view strData, int iFlush, std::string& strOut) {
+#if defined(TINYMCP_ZLIB)
+  strOut.clear();
+  if (!m_pStream) {
+    return ERRNO_INTERNAL_ERROR;
+  }
+  return RunDeflate(*static_cast<z_stream*>(m_pStream), strData, iFlush,
+    strOut);
+#else
+  return ERRNO_INTERNAL_ERROR;
+#endif
+}
+
+CPrecompressedTexts& CPrecompressedTexts::GetInstance() {
+  static CPrecompressedTexts s_Instance;
+  return s_Instance;
+}
+
+CPrecompressedTexts::Entries CPrecompressedTexts::CopyEntries() const {
+  Entries entries;
+  auto spEntries = std::atomic_load(&m_spEntries);
+  if (spEntries) {
+    for (const auto& entry : *spEntries) {
+      if (!entry.wpText.expired()) {
+        entries.push_back(entry);
+      }
+    }
+  }
+  return entries;
+}
+
+void CPrecompressedTexts::Register(
+  const std::shared_ptr<const std::string>& spText) {
+#if defined(TINYMCP_ZLIB)
+  if (!spText || spText->size() < MIN_TEXT_SIZE) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto entries = CopyEntries();
+  Entry entry;
+  entry.wpText = spText;
+  entries.push_back(std::move(entry));
+  std::atomic_store(&m_spEntries,
+    std::shared_ptr<const Entries>(
+      std::make_shared<Entries>(std::move(entries))));
+#endif
+}
+
+std::shared_ptr<const CPrecompressedTexts::Segment>
+CPrecompressedTexts::GetSegment(
+  const std::shared_ptr<const std::string>& spText, int iLevel) {
+#if defined(TINYMCP_ZLIB)
+  if (!spText) {
+    return nullptr;
+  }
+
+  // The caller holds the text, so a live entry cannot be a reused address.
+  auto fnLookup = [&](const Entries& entries, bool& bRegistered) {
+    for (const auto& entry : entries) {
+      if (entry.wpText.lock() == spText) {
+        bRegistered = true;
+        auto itr = entry.mapSegments.find(iLevel);
+        return itr != entry.mapSegments.end() ? itr->second : nullptr;
+      }
+    }
+    return std::shared_ptr<const Segment>();
+  };
+
+  bool bRegistered = false;
+  auto spEntries = std::atomic_load(&m_spEntries);
+  if (spEntries) {
+    auto spSegment = fnLookup(*spEntries, bRegistered);
+    if (spSegment || !bRegistered) {
+      return spSegment;
+    }
+  }
+  if (!bRegistered) {
+    return nullptr;
+  }
+
+  // First use at this level: compress once and publish a new snapshot.
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto entries = CopyEntries();
+  for (auto& entry : entries) {
+    if (entry.wpText.lock() != spText) {
+      continue;
+    }
+    auto& spSegment = entry.mapSegments[iLevel];
+    if (!spSegment) {
+      spSegment = MakeSegment(*spText, iLevel);
+      if (!spSegment) {
+        return nullptr;
+      }
+    }
+    auto spResult = spSegment;
+    std::atomic_store(&m_spEntries,
+      std::shared_ptr<const Entries>(
+        std::make_shared<Entries>(std::move(entries))));
+    return spResult;
+  }
+#endif
+  return nullptr;
+}
+
+void CPrecompressedTexts::Prepare(int iLevel) {
+#if defined(TINYMCP_ZLIB)
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto entries = CopyEntries();
+  for (auto& entry : entries) {
+    auto spText = entry.wpText.lock();
+    if (spText && !entry.mapSegments[iLevel]) {
+      entry.mapSegments[iLevel] = MakeSegment(*spText, iLevel);
+    }
+  }
+  std::atomic_store(&m_spEntries,
+    std::shared_ptr<const Entries>(
+      std::make_shared<Entries>(std::move(entries))));
+#endif
+}
+
+std::shared_ptr<const CPrecompressedTexts::Segment>
+CPrecompressedTexts::MakeSegment(const std::string& strText, int iLevel) {
+#if defined(TINYMCP_ZLIB)
+  auto spSegment = std::make_shared<Segment>();
+  if (ERRNO_OK != DeflateRaw(strText, iLevel, false, spSegment->strData)) {
+    return nullptr;
+  }
+  auto pData = reinterpret_cast<const Bytef*>(strText.data());
+  auto nTextSize = static_cast<uInt>(strText.size());
+  spSegment->ulCrc32 = crc32(crc32(0, Z_NULL, 0), pData, nTextSize);
+  spSegment->ulAdler32 = adler32(adler32(0, Z_NULL, 0), pData, nTextSize);
+  spSegment->nSize = strText.size();
+  LOG_DEBUG("CPrecompressedTexts: Compressed {} bytes to {} at level {}",
+    strText.size(), spSegment->strData.size(), iLevel);
+  return spSegment;
+#else
+  return nullptr;
+#endif
+}
+
+}  // namespace MCP
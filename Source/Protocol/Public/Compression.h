@@ -0,0 +1,108 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace MCP {
+
+// Content codings the HTTP transport can produce. Without zlib
+// (TINYMCP_ZLIB not defined) only identity is negotiated.
+enum ContentEncoding {
+  ContentEncoding_Identity,
+  ContentEncoding_Gzip,
+  ContentEncoding_Deflate,
+};
+
+// Picks gzip, then deflate, from an Accept-Encoding header, honouring q=0.
+ContentEncoding NegotiateEncoding(std::string_view strAcceptEncoding);
+const char* GetEncodingName(ContentEncoding eEncoding);
+
+// A shared text copied into a message at a known offset, such as the tools
+// catalog inside a tools/list response.
+struct EmbeddedText {
+  std::shared_ptr<const std::string> spText;
+  size_t nOffset{ 0 };
+};
+
+// Compresses one complete message. An embedded text registered with
+// CPrecompressedTexts is not compressed again; its cached deflate data is
+// spliced into the output.
+int CompressMessage(std::string_view strMessage, ContentEncoding eEncoding,
+  int iLevel, std::string& strCompressed,
+  const EmbeddedText& embedded = EmbeddedText());
+
+// Compresses a message written in pieces. Each Write() flushes, so the peer
+// can decode every piece as soon as it arrives.
+class CCompressStream {
+public:
+  CCompressStream() = default;
+  ~CCompressStream();
+  CCompressStream(const CCompressStream&) = delete;
+  CCompressStream& operator=(const CCompressStream&) = delete;
+
+  int Begin(ContentEncoding eEncoding, int iLevel);
+  int Write(std::string_view strData, std::string& strCompressed);
+  int End(std::string& strCompressed);
+
+private:
+  int Deflate(std::string_view strData, int iFlush, std::string& strOut);
+
+  // A z_stream, kept opaque so zlib.h stays out of the headers.
+  void* m_pStream{ nullptr };
+};
+
+// Texts that are sent over and over inside larger messages, such as the
+// serialized tools catalog. Their deflate data is computed once per level.
+class CPrecompressedTexts {
+public:
+  static CPrecompressedTexts& GetInstance();
+
+  // Texts shorter than this are compressed with the message.
+  static constexpr size_t MIN_TEXT_SIZE = 4 * 1024;
+
+  // The text is dropped from the cache once its last owner releases it.
+  void Register(const std::shared_ptr<const std::string>& spText);
+
+  // Raw deflate data of a text ending on a byte boundary without the final
+  // block flag, with the checksums needed to join it into a larger stream.
+  struct Segment {
+    std::string strData;
+    unsigned long ulCrc32{ 0 };
+    unsigned long ulAdler32{ 1 };
+    size_t nSize{ 0 };
+  };
+
+  // Returns the segment of a registered text for the level, or nullptr.
+  // Cached segments are read from a snapshot without locking.
+  std::shared_ptr<const Segment> GetSegment(
+    const std::shared_ptr<const std::string>& spText, int iLevel);
+
+  // Compresses the registered texts at the level ahead of the first
+  // GetSegment(), for instance before worker processes are forked.
+  void Prepare(int iLevel);
+
+private:
+  CPrecompressedTexts() = default;
+
+  static std::shared_ptr<const Segment> MakeSegment(
+    const std::string& strText, int iLevel);
+
+  struct Entry {
+    std::weak_ptr<const std::string> wpText;
+    std::map<int, std::shared_ptr<const Segment>> mapSegments;
+  };
+  using Entries = std::vector<Entry>;
+
+  // Copies the live entries of the current snapshot.
+  Entries CopyEntries() const;
+
+  // Serializes writers; readers only load m_spEntries atomically.
+  std::mutex m_mutex;
+  std::shared_ptr<const Entries> m_spEntries;
+};
+
+}  // namespace MCP
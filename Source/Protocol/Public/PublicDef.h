@@ -10,6 +10,13 @@ static constexpr const char* JSON_RPC_VER = "2.0";
 
 static constexpr const char* HEADER_SESSION_ID = "mcp-session-id";
 
+// Channel attributes describing the connected peer process, where the
+// transport can tell.
+static constexpr const char* ATTRIBUTE_PEER_PID = "peer-pid";
+static constexpr const char* ATTRIBUTE_PEER_UID = "peer-uid";
+static constexpr const char* ATTRIBUTE_PEER_GID = "peer-gid";
+static constexpr const char* ATTRIBUTE_PEER_ADDRESS = "peer-address";
+
 static constexpr const char* MSG_KEY_JSONRPC = "jsonrpc";
 static constexpr const char* MSG_KEY_ID = "id";
 static constexpr const char* MSG_KEY_METHOD = "method";
@@ -57,9 +64,22 @@ static constexpr const char* METHOD_NOTIFICATION_CANCELLED =
   "notifications/cancelled";
 static constexpr const char* METHOD_NOTIFICATION_PROGRESS =
   "notifications/progress";
+static constexpr const char* METHOD_NOTIFICATION_TOOLS_LIST_CHANGED =
+  "notifications/tools/list_changed";
 static constexpr const char* METHOD_TOOLS_LIST = "tools/list";
 static constexpr const char* METHOD_TOOLS_CALL = "tools/call";
 
+// Minimum interval between two progress notifications of one request.
+static constexpr const int DEFAULT_PROGRESS_NOTIFY_INTERVAL_MS = 100;
+
+// Sessions unused for this long are dropped, and the least recently used
+// are dropped beyond this count.
+static constexpr const int DEFAULT_SESSION_IDLE_TIMEOUT_S = 30 * 60;
+static constexpr const size_t DEFAULT_MAX_SESSIONS = 10000;
+
+// How long stopping the server waits for tool calls in progress.
+static constexpr const int DEFAULT_DRAIN_TIMEOUT_MS = 5000;
+
 static constexpr const char* CONST_TEXT = "text";
 static constexpr const char* CONST_IMAGE = "image";
 static constexpr const char* CONST_RESOURCE = "resource";
@@ -71,6 +91,8 @@ static constexpr const char* ERROR_MESSAGE_METHOD_NOT_FOUND =
   u8"method not found";
 static constexpr const char* ERROR_MESSAGE_INVALID_PARAMS = u8"invalid params";
 static constexpr const char* ERROR_MESSAGE_INTERNAL_ERROR = u8"internal error";
+static constexpr const char* ERROR_MESSAGE_SERVER_STOPPING =
+  u8"server stopping";
 
 // json rpc 2.0标准错误码
 static constexpr const int ERRNO_OK = 0;
@@ -87,6 +109,8 @@ static constexpr const int ERRNO_INVALID_NOTIFICATION = -32002;
 static constexpr const int ERRNO_INTERNAL_INPUT_TERMINATE = -32003;
 static constexpr const int ERRNO_INTERNAL_INPUT_ERROR = -32004;
 static constexpr const int ERRNO_INTERNAL_OUTPUT_ERROR = -32005;
+// A dispatched connection has no more input for now.
+static constexpr const int ERRNO_INTERNAL_INPUT_PENDING = -32006;
 static constexpr const int ERRNO_SERVER_ERROR_LAST = -32099;
 
 enum DataType {
@@ -130,5 +154,6 @@ enum MessageType {
   MessageType_ProgressToken,
   MessageType_ProgressNotification,
   MessageType_ErrorResponse,
+  MessageType_ToolListChangedNotification,
 };
 }  // namespace MCP
@@ -0,0 +1,115 @@
+#include "SessionId.h"
+
+#if defined(__linux__)
+#include <sys/random.h>
+
+#include <cerrno>
+#endif
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <random>
+
+namespace MCP {
+
+static constexpr std::string_view SESSION_ID_PREFIX = "session-";
+static constexpr const char* HEX_DIGITS = "0123456789abcdef";
+// "<shard>-<worker>-" after the prefix.
+static constexpr size_t SESSION_ID_FIELDS_SIZE = 6;
+
+static std::atomic<size_t> s_nWorker{ 0 };
+
+static int HexValue(char ch) {
+  if (ch >= '0' && ch <= '9')
+    return ch - '0';
+  if (ch >= 'a' && ch <= 'f')
+    return ch - 'a' + 10;
+  return -1;
+}
+
+static void AppendHex(std::string& strOut, uint64_t ullValue, int nDigits) {
+  for (int i = nDigits - 1; i >= 0; --i) {
+    strOut.push_back(HEX_DIGITS[(ullValue >> (4 * i)) & 0xf]);
+  }
+}
+
+// Fills the buffer from the operating system's random source. Every id
+// takes fresh bytes, so seeing some ids tells nothing about the others.
+static void FillRandom(unsigned char* pBuffer, size_t nSize) {
+  size_t nDone = 0;
+#if defined(__linux__)
+  while (nDone < nSize) {
+    ssize_t nRead = getrandom(pBuffer + nDone, nSize - nDone, 0);
+    if (nRead < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    nDone += static_cast<size_t>(nRead);
+  }
+#endif
+  // Elsewhere, or without getrandom(2), the standard library reads the
+  // system source (/dev/urandom, rdrand or the Windows RNG).
+  if (nDone < nSize) {
+    std::random_device device;
+    for (; nDone < nSize; ++nDone) {
+      pBuffer[nDone] = static_cast<unsigned char>(device());
+    }
+  }
+}
+
+std::string GenerateSessionId() {
+  static std::atomic<size_t> s_nNextShard{ 0 };
+
+  size_t nShard = s_nNextShard.fetch_add(1) % SESSION_SHARD_COUNT;
+  std::string strSessionId(SESSION_ID_PREFIX);
+  strSessionId.reserve(
+    SESSION_ID_PREFIX.size() + SESSION_ID_FIELDS_SIZE + 32);
+  AppendHex(strSessionId, nShard, 2);
+  strSessionId.push_back('-');
+  AppendHex(strSessionId, s_nWorker.load(std::memory_order_relaxed), 2);
+  strSessionId.push_back('-');
+  unsigned char random[16];
+  FillRandom(random, sizeof(random));
+  for (unsigned char byte : random) {
+    AppendHex(strSessionId, byte, 2);
+  }
+  return strSessionId;
+}
+
+size_t GetSessionShard(std::string_view strSessionId) {
+  size_t nPrefix = SESSION_ID_PREFIX.size();
+  if (strSessionId.size() > nPrefix + 2 &&
+      strSessionId.compare(0, nPrefix, SESSION_ID_PREFIX) == 0 &&
+      strSessionId[nPrefix + 2] == '-') {
+    int iHigh = HexValue(strSessionId[nPrefix]);
+    int iLow = HexValue(strSessionId[nPrefix + 1]);
+    if (iHigh >= 0 && iLow >= 0) {
+      return static_cast<size_t>(iHigh * 16 + iLow) % SESSION_SHARD_COUNT;
+    }
+  }
+  return std::hash<std::string_view>()(strSessionId) % SESSION_SHARD_COUNT;
+}
+
+void SetSessionIdWorker(size_t nWorker) {
+  s_nWorker = nWorker % MAX_SESSION_WORKERS;
+}
+
+int GetSessionWorker(std::string_view strSessionId) {
+  size_t nPrefix = SESSION_ID_PREFIX.size();
+  if (strSessionId.size() <= nPrefix + SESSION_ID_FIELDS_SIZE ||
+      strSessionId.compare(0, nPrefix, SESSION_ID_PREFIX) != 0 ||
+      strSessionId[nPrefix + 2] != '-' || strSessionId[nPrefix + 5] != '-') {
+    return -1;
+  }
+
+  int iHigh = HexValue(strSessionId[nPrefix + 3]);
+  int iLow = HexValue(strSessionId[nPrefix + 4]);
+  if (iHigh < 0 || iLow < 0) {
+    return -1;
+  }
+  return iHigh * 16 + iLow;
+}
+
+}  // namespace MCP
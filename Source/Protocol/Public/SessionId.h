@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace MCP {
+
+// Session tables are split into this many shards, each with its own lock.
+static constexpr size_t SESSION_SHARD_COUNT = 16;
+
+// Servers running in several worker processes (see
+// CMCPServer::SetWorkerProcesses) serve at most this many.
+static constexpr size_t MAX_SESSION_WORKERS = 256;
+
+// Returns a new unguessable id of the form
+// "session-<shard>-<worker>-<random>". The shard and the worker are two hex
+// digits each; new ids cycle through the shards.
+std::string GenerateSessionId();
+
+// The worker process whose ids GenerateSessionId() makes, 0 by default. Set
+// once in each worker before it serves.
+void SetSessionIdWorker(size_t nWorker);
+
+// The worker process owning a session, or -1 for ids not made by
+// GenerateSessionId().
+int GetSessionWorker(std::string_view strSessionId);
+
+// The shard holding a session. Ids not made by GenerateSessionId() are
+// hashed instead.
+size_t GetSessionShard(std::string_view strSessionId);
+
+}  // namespace MCP
@@ -2,7 +2,6 @@
 
 #include <algorithm>
 #include <chrono>
-#include <future>
 #include <memory>
 
 #include <json/json.h>
@@ -31,22 +30,28 @@ CMCPSession::~CMCPSession() {
 int CMCPSession::Run() {
   LOG_INFO("Session message loop started");
 
-  if (!m_channel) {
+  // Reads only the channel the loop started with; SetChannel() may hand the
+  // session a newer one meanwhile.
+  auto channel = GetChannel();
+  if (!channel) {
     LOG_ERROR("Channel not set");
     return ERRNO_INTERNAL_ERROR;
   }
 
   int iErrCode = ERRNO_OK;
 
-  while (m_channel->IsActive()) {
-    std::string strIncomingMsg;
-    iErrCode = m_channel->Read(strIncomingMsg);
+  // Reused across messages so its capacity is allocated only once.
+  std::string strIncomingMsg;
+  while (channel->IsActive()) {
+    iErrCode = channel->Read(strIncomingMsg);
     if (ERRNO_OK == iErrCode) {
+      std::lock_guard<std::mutex> lock(m_mtxProcess);
       std::shared_ptr<MCP::Message> spMsg;
       iErrCode = ParseMessage(strIncomingMsg, spMsg);
       iErrCode = ProcessMessage(iErrCode, spMsg);
     } else {
-      LOG_WARNING("Message loop exiting, error: {}", iErrCode);
+      if (ERRNO_INTERNAL_INPUT_PENDING != iErrCode)
+        LOG_WARNING("Message loop exiting, error: {}", iErrCode);
       break;
     }
   }
@@ -57,30 +62,93 @@ int CMCPSession::Run() {
 
 int CMCPSession::Terminate() {
   LOG_INFO("Session terminating");
+  m_eSessionState = SessionState_Shut;
 
   StopAsyncTaskThread();
+  CancelTasks();
+  StopProgressTimer();
 
   if (m_upTaskThread && m_upTaskThread->joinable()) {
-    auto future = std::async(std::launch::async, [this]() {
-      if (m_upTaskThread->joinable()) {
-        m_upTaskThread->join();
-      }
-    });
-
-    if (future.wait_for(std::chrono::seconds(3)) ==
-        std::future_status::timeout) {
-      LOG_ERROR("Session::Terminate: Async task thread join timeout");
-    }
+    // A tool call may end its own session.
+    if (m_upTaskThread->get_id() == std::this_thread::get_id())
+      m_upTaskThread->detach();
+    else
+      m_upTaskThread->join();
   }
 
-  if (m_channel) {
-    m_channel->Close();
+  auto channel = GetChannel();
+  if (channel) {
+    channel->Close();
   }
 
   LOG_INFO("Session terminated");
   return ERRNO_OK;
 }
 
+bool CMCPSession::WaitTasksIdle(
+  std::chrono::steady_clock::time_point tpDeadline) {
+  std::unique_lock<std::mutex> _lock(m_mtxAsyncThread);
+  return m_cvTasksIdle.wait_until(_lock, tpDeadline, [this]() {
+    return m_deqAsyncTasks.empty() && 0 == m_nTakenTasks &&
+           m_vecAsyncTasksCache.empty();
+  });
+}
+
+void CMCPSession::CancelTasks() {
+  std::unique_lock<std::mutex> _lock(m_mtxAsyncThread);
+  // Calls taken off the queue but not started are dropped by the task
+  // thread.
+  m_bTasksDropped = true;
+  std::deque<std::shared_ptr<MCP::CMCPTask>> deqDropped;
+  deqDropped.swap(m_deqAsyncTasks);
+  auto spExecutingTask = m_spExecutingTask;
+  auto vecTasks = m_vecAsyncTasksCache;
+  _lock.unlock();
+
+  if (!deqDropped.empty())
+    LOG_WARNING("Dropping {} queued tasks", deqDropped.size());
+  for (auto& spTask : deqDropped) {
+    AnswerDroppedTask(spTask);
+  }
+
+  // Cancel() may wait for the tool, so no lock is held meanwhile.
+  if (spExecutingTask)
+    spExecutingTask->Cancel();
+  for (auto& spTask : vecTasks) {
+    if (spTask && !spTask->IsFinished())
+      spTask->Cancel();
+  }
+}
+
+void CMCPSession::AnswerDroppedTask(
+  const std::shared_ptr<MCP::CMCPTask>& spTask) {
+  // The client still waits for the call.
+  auto spRequestTask = std::dynamic_pointer_cast<MCP::ProcessRequest>(spTask);
+  if (!spRequestTask || !spRequestTask->GetRequest())
+    return;
+
+  auto spErrorTask =
+    std::make_shared<ProcessErrorRequest>(spRequestTask->GetRequest());
+  if (spErrorTask) {
+    spErrorTask->SetSession(this);
+    spErrorTask->SetErrorCode(ERRNO_INTERNAL_ERROR);
+    spErrorTask->SetErrorMessage(ERROR_MESSAGE_SERVER_STOPPING);
+    spErrorTask->Execute();
+  }
+}
+
+void CMCPSession::OnAsyncTaskFinished() {
+  std::unique_lock<std::mutex> _lock(m_mtxAsyncThread);
+  // Tasks finishing within Execute() are released by the task thread itself.
+  if (m_upTaskThread && m_upTaskThread->get_id() == std::this_thread::get_id())
+    return;
+
+  m_bAsyncTaskFinished = true;
+  _lock.unlock();
+
+  m_cvAsyncThread.notify_one();
+}
+
 int CMCPSession::ProcessMessage(
   int iErrCode, const std::shared_ptr<MCP::Message>& spMsg) {
   if (!spMsg || !spMsg->IsValid()) {
@@ -213,25 +281,16 @@ int CMCPSession::ProcessRequest(
 
     LOG_INFO("Calling tool: {}", spCallToolRequest->strName);
 
-    auto spProcessCallToolRequest =
-      GetServerCallToolsTask(spCallToolRequest->strName);
-    if (!spProcessCallToolRequest) {
+    std::shared_ptr<MCP::ProcessCallToolRequest> spNewProcessCallToolRequest;
+    iErrCode = AcquireServerCallToolsTask(
+      spCallToolRequest->strName, spNewProcessCallToolRequest);
+    if (ERRNO_INVALID_PARAMS == iErrCode) {
       LOG_ERROR("Tool not found: {}", spCallToolRequest->strName);
       strMessage = ERROR_MESSAGE_INVALID_PARAMS;
-      iErrCode = ERRNO_INVALID_PARAMS;
-      goto PROC_END;
-    }
-    auto spNewTask = spProcessCallToolRequest->Clone();
-    if (!spNewTask) {
-      LOG_ERROR("Failed to clone task");
-      iErrCode = ERRNO_INTERNAL_ERROR;
       goto PROC_END;
     }
-    auto spNewProcessCallToolRequest =
-      std::dynamic_pointer_cast<MCP::ProcessCallToolRequest>(spNewTask);
-    if (!spNewProcessCallToolRequest) {
-      LOG_ERROR("Cannot cast to ProcessCallToolRequest");
-      iErrCode = ERRNO_INTERNAL_ERROR;
+    if (ERRNO_OK != iErrCode) {
+      LOG_ERROR("Failed to create tool task");
       goto PROC_END;
     }
     spNewProcessCallToolRequest->SetRequest(spRequest);
@@ -301,12 +360,7 @@ int CMCPSession::ProcessNotification(
   case MessageType_InitializedNotification: {
     int iErrCode = SwitchState(SessionState_Initialized);
     if (ERRNO_OK == iErrCode) {
-      auto channel = GetChannel();
-      if (!channel) {
-        LOG_ERROR("Channel not available");
-        return ERRNO_INTERNAL_ERROR;
-      }
-      if (ERRNO_OK != channel->Write("")) {
+      if (ERRNO_OK != WriteOutbound("")) {
         LOG_ERROR("Failed to write ping response");
         return ERRNO_INTERNAL_ERROR;
       }
@@ -512,13 +566,103 @@ void CMCPSession::SetServerToolsPagination(bool bPagination) {
   m_bToolsPagination = bPagination;
 }
 
-void CMCPSession::SetServerTools(const std::vector<MCP::Tool>& tools) {
-  m_tools = tools;
+void CMCPSession::SetProgressNotifyInterval(
+  std::chrono::milliseconds interval) {
+  m_progressInterval = interval;
+}
+
+std::chrono::milliseconds CMCPSession::GetProgressNotifyInterval() const {
+  return m_progressInterval;
+}
+
+void CMCPSession::ScheduleProgressFlush(
+  std::chrono::steady_clock::time_point tpDue) {
+  {
+    std::lock_guard<std::mutex> lock(m_mtxProgressTimer);
+    if (m_bProgressTimerStopped || tpDue >= m_tpProgressDue)
+      return;
+
+    m_tpProgressDue = tpDue;
+    if (!m_bProgressTimerActive) {
+      // The previous timer thread has returned or is about to.
+      if (m_upProgressThread && m_upProgressThread->joinable())
+        m_upProgressThread->join();
+      m_upProgressThread = std::make_unique<std::thread>(
+        &CMCPSession::ProgressTimerProc, this);
+      m_bProgressTimerActive = true;
+      return;
+    }
+  }
+  m_cvProgressTimer.notify_one();
+}
+
+void CMCPSession::ProgressTimerProc() {
+  std::unique_lock<std::mutex> lock(m_mtxProgressTimer);
+  while (!m_bProgressTimerStopped) {
+    // Nothing held back; the next update starts the timer again.
+    if (m_tpProgressDue == std::chrono::steady_clock::time_point::max()) {
+      m_bProgressTimerActive = false;
+      break;
+    }
+    // Woken early when an update is due sooner.
+    if (std::chrono::steady_clock::now() < m_tpProgressDue) {
+      m_cvProgressTimer.wait_until(lock, m_tpProgressDue);
+      continue;
+    }
+
+    m_tpProgressDue = std::chrono::steady_clock::time_point::max();
+    lock.unlock();
+    auto tpNext = FlushDueProgress();
+    lock.lock();
+    if (tpNext != std::chrono::steady_clock::time_point() &&
+        tpNext < m_tpProgressDue)
+      m_tpProgressDue = tpNext;
+  }
+}
+
+void CMCPSession::StopProgressTimer() {
+  {
+    std::lock_guard<std::mutex> lock(m_mtxProgressTimer);
+    m_bProgressTimerStopped = true;
+  }
+  m_cvProgressTimer.notify_all();
+
+  if (m_upProgressThread && m_upProgressThread->joinable()) {
+    if (m_upProgressThread->get_id() == std::this_thread::get_id())
+      m_upProgressThread->detach();
+    else
+      m_upProgressThread->join();
+  }
 }
 
-void CMCPSession::SetServerCallToolsTasks(const std::unordered_map<std::string,
-  std::shared_ptr<MCP::ProcessCallToolRequest>>& hashCallToolsTasks) {
-  m_hashCallToolsTasks = hashCallToolsTasks;
+std::chrono::steady_clock::time_point CMCPSession::FlushDueProgress() {
+  std::vector<std::shared_ptr<MCP::CMCPTask>> vecTasks;
+  {
+    std::lock_guard<std::mutex> lock(m_mtxAsyncThread);
+    vecTasks = m_vecAsyncTasksCache;
+    if (m_spExecutingTask)
+      vecTasks.push_back(m_spExecutingTask);
+  }
+
+  std::chrono::steady_clock::time_point tpNext;
+  for (auto& spTask : vecTasks) {
+    auto spToolTask =
+      std::dynamic_pointer_cast<MCP::ProcessCallToolRequest>(spTask);
+    if (!spToolTask)
+      continue;
+
+    auto tpDue = spToolTask->FlushDueProgress();
+    if (tpDue != std::chrono::steady_clock::time_point() &&
+        (tpNext == std::chrono::steady_clock::time_point() || tpDue < tpNext))
+      tpNext = tpDue;
+  }
+
+  return tpNext;
+}
+
+void CMCPSession::SetToolRegistry(
+  std::shared_ptr<MCP::CToolRegistry> spToolRegistry) {
+  m_spToolRegistry = spToolRegistry;
 }
 
 MCP::Implementation CMCPSession::GetServerInfo() const {
@@ -533,26 +677,32 @@ bool CMCPSession::GetServerToolsPagination() const {
   return m_bToolsPagination;
 }
 
-std::vector<MCP::Tool> CMCPSession::GetServerTools() const {
-  return m_tools;
+std::shared_ptr<const MCP::CToolsSnapshot>
+CMCPSession::GetServerToolsSnapshot() const {
+  if (!m_spToolRegistry)
+    return nullptr;
+
+  return m_spToolRegistry->GetSnapshot();
 }
 
 void CMCPSession::SetChannel(std::shared_ptr<IChannel> channel) {
+  std::lock_guard<std::mutex> lock(m_mtxChannel);
   m_channel = channel;
 }
 
 std::shared_ptr<IChannel> CMCPSession::GetChannel() const {
+  std::lock_guard<std::mutex> lock(m_mtxChannel);
   return m_channel;
 }
 
 int CMCPSession::SwitchState(SessionState eState) {
-  LOG_INFO("State transition: {} -> {}", static_cast<int>(m_eSessionState),
-    static_cast<int>(eState));
+  LOG_INFO("State transition: {} -> {}",
+    static_cast<int>(m_eSessionState.load()), static_cast<int>(eState));
 
   if (SessionState_Initializing == eState) {
     if (SessionState_Original != m_eSessionState) {
       LOG_ERROR("Invalid state transition to Initializing from {}",
-        static_cast<int>(m_eSessionState));
+        static_cast<int>(m_eSessionState.load()));
       return ERRNO_INTERNAL_ERROR;
     }
   }
@@ -560,7 +710,7 @@ int CMCPSession::SwitchState(SessionState eState) {
   if (SessionState_Initialized == eState) {
     if (SessionState_Initializing != m_eSessionState) {
       LOG_ERROR("Invalid state transition to Initialized from {}",
-        static_cast<int>(m_eSessionState));
+        static_cast<int>(m_eSessionState.load()));
       return ERRNO_INTERNAL_ERROR;
     }
   }
@@ -583,11 +733,155 @@ const std::string& CMCPSession::GetSessionId() const {
 }
 
 std::shared_ptr<MCP::ProcessRequest> CMCPSession::GetServerCallToolsTask(
-  const std::string& strToolName) {
-  if (m_hashCallToolsTasks.count(strToolName) > 0)
-    return m_hashCallToolsTasks[strToolName];
+  std::string_view strToolName) {
+  auto spSnapshot = GetServerToolsSnapshot();
+  if (!spSnapshot)
+    return nullptr;
 
-  return nullptr;
+  return spSnapshot->FindTask(strToolName);
+}
+
+int CMCPSession::AcquireServerCallToolsTask(std::string_view strToolName,
+  std::shared_ptr<MCP::ProcessCallToolRequest>& spTask) {
+  auto spSnapshot = GetServerToolsSnapshot();
+  if (!spSnapshot)
+    return ERRNO_INTERNAL_ERROR;
+
+  auto pEntry = spSnapshot->FindTaskEntry(strToolName);
+  if (!pEntry)
+    return ERRNO_INVALID_PARAMS;
+
+  spTask = pEntry->Acquire();
+  if (!spTask)
+    return ERRNO_INTERNAL_ERROR;
+
+  return ERRNO_OK;
+}
+
+int CMCPSession::NotifyToolsListChanged() {
+  if (SessionState_Initialized != GetSessionState())
+    return ERRNO_OK;
+
+  MCP::ToolListChangedNotification notification(false);
+  notification.strMethod = METHOD_NOTIFICATION_TOOLS_LIST_CHANGED;
+
+  std::string strNotification;
+  if (ERRNO_OK != notification.Serialize(strNotification)) {
+    LOG_ERROR("Failed to serialize tools list changed notification");
+    return ERRNO_INTERNAL_ERROR;
+  }
+  if (ERRNO_OK != WriteOutbound(strNotification)) {
+    LOG_ERROR("Failed to write tools list changed notification");
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  return ERRNO_OK;
+}
+
+int CMCPSession::WriteOutbound(
+  const std::string& strMessage, const EmbeddedText& embedded) {
+  auto channel = GetChannel();
+  if (!channel) {
+    LOG_ERROR("Channel not available");
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  std::unique_lock<std::mutex> lock(m_mtxOutbound);
+  // Backpressure: wait for the active writer while the peer is slow.
+  m_cvOutbound.wait(lock, [this]() {
+    return m_nOutboundBytes < MAX_OUTBOUND_QUEUE_BYTES || !m_bOutboundWriting;
+  });
+  // A write to the channel failed, whichever thread made it.
+  if (ERRNO_OK != m_iOutboundError && m_wpFailedChannel.lock() == channel)
+    return m_iOutboundError;
+
+  OutboundMessage message;
+  message.spChannel = channel;
+  message.strData = strMessage;
+  message.embedded = embedded;
+  m_nOutboundBytes += message.strData.size();
+  m_deqOutbound.push_back(std::move(message));
+
+  // Another thread is draining the queue and will pick this message up.
+  if (m_bOutboundWriting)
+    return ERRNO_OK;
+
+  m_bOutboundWriting = true;
+  int iErrCode = ERRNO_OK;
+  while (!m_deqOutbound.empty()) {
+    std::deque<OutboundMessage> deqBatch;
+    deqBatch.swap(m_deqOutbound);
+    auto spFailedChannel = m_wpFailedChannel.lock();
+    lock.unlock();
+
+    // Consecutive messages for the same channel go out in one write, except
+    // that a message with an embedded text is written on its own. The bytes
+    // stay counted until written.
+    size_t nBatchBytes = 0;
+    int iBatchErrCode = ERRNO_OK;
+    auto itr = deqBatch.begin();
+    while (itr != deqBatch.end()) {
+      auto spChannel = itr->spChannel;
+      std::vector<std::string> vecData;
+      EmbeddedText embedded;
+      for (; itr != deqBatch.end() && itr->spChannel == spChannel; ++itr) {
+        if (itr->embedded.spText) {
+          if (!vecData.empty())
+            break;
+          embedded = std::move(itr->embedded);
+          nBatchBytes += itr->strData.size();
+          vecData.push_back(std::move(itr->strData));
+          ++itr;
+          break;
+        }
+        nBatchBytes += itr->strData.size();
+        vecData.push_back(std::move(itr->strData));
+      }
+      if (spChannel == spFailedChannel)
+        continue;
+
+      int iResult = embedded.spText
+                      ? spChannel->WriteEmbedded(vecData.front(), embedded)
+                      : spChannel->WriteBatch(vecData);
+      if (ERRNO_OK != iResult) {
+        LOG_ERROR("Failed to write {} outbound messages, error: {}",
+          vecData.size(), iResult);
+        // The peer is gone or stuck; the session ends with its channel.
+        spChannel->Close();
+        spFailedChannel = spChannel;
+        iBatchErrCode = iResult;
+        iErrCode = iResult;
+      }
+    }
+
+    lock.lock();
+    m_nOutboundBytes -= nBatchBytes;
+    if (ERRNO_OK != iBatchErrCode) {
+      m_iOutboundError = iBatchErrCode;
+      m_wpFailedChannel = spFailedChannel;
+    }
+    m_cvOutbound.notify_all();
+  }
+  m_bOutboundWriting = false;
+  m_cvOutbound.notify_all();
+
+  return iErrCode;
+}
+
+void CMCPSession::FlushOutbound() {
+  std::unique_lock<std::mutex> lock(m_mtxOutbound);
+  m_cvOutbound.wait(lock,
+    [this]() { return m_deqOutbound.empty() && !m_bOutboundWriting; });
+}
+
+size_t CMCPSession::GetOutboundQueueDepth() const {
+  std::lock_guard<std::mutex> lock(m_mtxOutbound);
+  return m_deqOutbound.size();
+}
+
+size_t CMCPSession::GetOutboundQueueBytes() const {
+  std::lock_guard<std::mutex> lock(m_mtxOutbound);
+  return m_nOutboundBytes;
 }
 
 int CMCPSession::CommitAsyncTask(const std::shared_ptr<MCP::CMCPTask>& spTask) {
@@ -605,6 +899,8 @@ int CMCPSession::CommitAsyncTask(const std::shared_ptr<MCP::CMCPTask>& spTask) {
     }
 
     m_deqAsyncTasks.push_back(spTask);
+    if (m_bTasksEnabled && !m_bTaskThreadActive)
+      return LaunchAsyncTaskThread();
 
     _lock.unlock();
     m_cvAsyncThread.notify_one();
@@ -622,7 +918,8 @@ int CMCPSession::CancelAsyncTask(const MCP::RequestId& requestId) {
   if (m_bRunAsyncTask) {
     std::unique_lock<std::mutex> _lock(m_mtxAsyncThread);
 
-    if (!m_bRunAsyncTask) {
+    // Without a task thread, no call is running.
+    if (!m_bRunAsyncTask || !m_bTaskThreadActive) {
       _lock.unlock();
       return ERRNO_OK;
     }
@@ -637,14 +934,30 @@ int CMCPSession::CancelAsyncTask(const MCP::RequestId& requestId) {
 }
 
 int CMCPSession::StartAsyncTaskThread() {
-  LOG_INFO("Async task thread starting");
+  std::lock_guard<std::mutex> _lock(m_mtxAsyncThread);
+  m_bTasksEnabled = true;
+  if (m_deqAsyncTasks.empty() || m_bTaskThreadActive)
+    return ERRNO_OK;
+
+  return LaunchAsyncTaskThread();
+}
+
+int CMCPSession::LaunchAsyncTaskThread() {
+  if (!m_bRunAsyncTask)
+    return ERRNO_OK;
 
+  // The previous thread has returned or is about to.
+  if (m_upTaskThread && m_upTaskThread->joinable())
+    m_upTaskThread->join();
+
+  LOG_INFO("Async task thread starting");
   m_upTaskThread =
     std::make_unique<std::thread>(&CMCPSession::AsyncThreadProc, this);
   if (!m_upTaskThread) {
     LOG_ERROR("Failed to create thread");
     return ERRNO_INTERNAL_ERROR;
   }
+  m_bTaskThreadActive = true;
 
   return ERRNO_OK;
 }
@@ -668,19 +981,20 @@ int CMCPSession::AsyncThreadProc() {
     // Wait for tasks
     m_cvAsyncThread.wait(_lock, [this]() {
       return !m_deqAsyncTasks.empty() || !m_vecCancelledTaskIds.empty() ||
-             !m_bRunAsyncTask;
+             m_bAsyncTaskFinished || !m_bRunAsyncTask;
     });
+    m_bAsyncTaskFinished = false;
 
     // Break the loop and clean up tasks
     if (!m_bRunAsyncTask) {
+      auto vecTasks = m_vecAsyncTasksCache;
       _lock.unlock();
 
-      std::for_each(m_vecAsyncTasksCache.begin(), m_vecAsyncTasksCache.end(),
-        [this](auto& spTask) {
-          if (spTask) {
-            spTask->Cancel();
-          }
-        });
+      std::for_each(vecTasks.begin(), vecTasks.end(), [this](auto& spTask) {
+        if (spTask) {
+          spTask->Cancel();
+        }
+      });
 
       break;
     }
@@ -692,6 +1006,7 @@ int CMCPSession::AsyncThreadProc() {
       vecTasks.push_back(spTask);
       m_deqAsyncTasks.pop_front();
     }
+    m_nTakenTasks = vecTasks.size();
 
     //  Process task cancellation requests
     std::for_each(m_vecAsyncTasksCache.begin(), m_vecAsyncTasksCache.end(),
@@ -715,7 +1030,6 @@ int CMCPSession::AsyncThreadProc() {
         }
       });
     m_vecCancelledTaskIds.clear();
-    _lock.unlock();
 
     // Clean up completed tasks
     m_vecAsyncTasksCache.erase(
@@ -728,18 +1042,55 @@ int CMCPSession::AsyncThreadProc() {
           return false;
         }),
       m_vecAsyncTasksCache.end());
+    _lock.unlock();
 
     // Cache new tasks
     for (auto& spTask : vecTasks) {
       if (spTask) {
+        _lock.lock();
+        bool bDropped = m_bTasksDropped;
+        if (!bDropped)
+          m_spExecutingTask = spTask;
+        _lock.unlock();
+        if (bDropped) {
+          AnswerDroppedTask(spTask);
+          continue;
+        }
+
         int iResult = spTask->Execute();
+
+        _lock.lock();
+        m_spExecutingTask = nullptr;
         if (ERRNO_OK == iResult) {
-          m_vecAsyncTasksCache.push_back(spTask);
+          // Tasks that completed synchronously are released right away so a
+          // pooled instance is available for the next call.
+          if (!spTask->IsFinished())
+            m_vecAsyncTasksCache.push_back(spTask);
         } else {
           LOG_ERROR("Task execution failed, error: {}", iResult);
         }
+        _lock.unlock();
       }
     }
+
+    _lock.lock();
+    m_nTakenTasks = 0;
+    // With nothing queued or running, the thread ends until the next call.
+    bool bIdle = m_deqAsyncTasks.empty() && !m_bAsyncTaskFinished &&
+                 std::all_of(m_vecAsyncTasksCache.begin(),
+                   m_vecAsyncTasksCache.end(), [](auto& spTask) {
+                     return !spTask || spTask->IsFinished() ||
+                            spTask->IsCancelled();
+                   });
+    if (bIdle) {
+      m_vecAsyncTasksCache.clear();
+      m_vecCancelledTaskIds.clear();
+      m_bTaskThreadActive = false;
+    }
+    _lock.unlock();
+    m_cvTasksIdle.notify_all();
+    if (bIdle)
+      break;
   }
 
   LOG_INFO("Async task thread terminated");
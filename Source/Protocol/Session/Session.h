@@ -1,10 +1,12 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <deque>
 #include <memory>
 #include <mutex>
+#include <string_view>
 #include <thread>
 #include <unordered_map>
 #include <vector>
@@ -12,6 +14,7 @@
 #include "../Message/BasicMessage.h"
 #include "../Public/PublicDef.h"
 #include "../Task/BasicTask.h"
+#include "../Task/ToolRegistry.h"
 #include "../Transport/Channel.h"
 
 namespace MCP {
@@ -31,25 +34,52 @@ public:
   CMCPSession& operator=(const CMCPSession&) = delete;
 
   int Run();
+  // Stops the session for good; the server forgets a session once shut.
+  // Tool calls still running are cancelled and waited for.
   int Terminate();
+  // Returns true once no tool call of the session is queued or running, or
+  // false if some still are at the deadline.
+  bool WaitTasksIdle(std::chrono::steady_clock::time_point tpDeadline);
+  // Drops queued tool calls and cancels those running.
+  void CancelTasks();
+  // Called by a tool call when it has written its result.
+  void OnAsyncTaskFinished();
 
   void SetServerInfo(const MCP::Implementation& impl);
   void SetServerCapabilities(const MCP::ServerCapabilities& capabilities);
   void SetServerToolsPagination(bool bPagination);
-  void SetServerTools(const std::vector<MCP::Tool>& tools);
-  void SetServerCallToolsTasks(const std::unordered_map<std::string,
-    std::shared_ptr<MCP::ProcessCallToolRequest>>& hashCallToolsTasks);
+  void SetProgressNotifyInterval(std::chrono::milliseconds interval);
+  std::chrono::milliseconds GetProgressNotifyInterval() const;
+  // Progress held back by the interval is sent at tpDue by a timer thread, so
+  // a tool going quiet after an update leaves no stale value behind. The
+  // thread ends once nothing is held back.
+  void ScheduleProgressFlush(std::chrono::steady_clock::time_point tpDue);
+  void SetToolRegistry(std::shared_ptr<MCP::CToolRegistry> spToolRegistry);
   MCP::Implementation GetServerInfo() const;
   MCP::ServerCapabilities GetServerCapabilities() const;
   bool GetServerToolsPagination() const;
-  std::vector<MCP::Tool> GetServerTools() const;
+  std::shared_ptr<const MCP::CToolsSnapshot> GetServerToolsSnapshot() const;
   void SetChannel(std::shared_ptr<IChannel> channel);
   std::shared_ptr<IChannel> GetChannel() const;
   SessionState GetSessionState() const;
   std::shared_ptr<MCP::ProcessRequest> GetServerCallToolsTask(
-    const std::string& strToolName);
+    std::string_view strToolName);
+  int AcquireServerCallToolsTask(std::string_view strToolName,
+    std::shared_ptr<MCP::ProcessCallToolRequest>& spTask);
   void SetSessionId(const std::string& strSessionId);
   const std::string& GetSessionId() const;
+  int NotifyToolsListChanged();
+
+  // All outbound messages of the session go through one queue. The thread
+  // that finds it idle drains it, coalescing pending messages per write.
+  static constexpr size_t MAX_OUTBOUND_QUEUE_BYTES = 4 * 1024 * 1024;
+  // The embedded text, if any, lets a compressing channel reuse its cached
+  // deflate data.
+  int WriteOutbound(const std::string& strMessage,
+    const EmbeddedText& embedded = EmbeddedText());
+  void FlushOutbound();
+  size_t GetOutboundQueueDepth() const;
+  size_t GetOutboundQueueBytes() const;
 
 private:
   int ParseMessage(
@@ -69,32 +99,86 @@ private:
 
   int CommitAsyncTask(const std::shared_ptr<MCP::CMCPTask>& spTask);
   int CancelAsyncTask(const MCP::RequestId& requestId);
+  // Lets tool calls run once the session is initialized.
   int StartAsyncTaskThread();
+  // Called with m_mtxAsyncThread held.
+  int LaunchAsyncTaskThread();
   int StopAsyncTaskThread();
   int AsyncThreadProc();
+  // Answers a call dropped by CancelTasks() with an error.
+  void AnswerDroppedTask(const std::shared_ptr<MCP::CMCPTask>& spTask);
+  void ProgressTimerProc();
+  void StopProgressTimer();
+  // Returns when the next held back update is due, or the epoch if none is.
+  std::chrono::steady_clock::time_point FlushDueProgress();
+
+  struct OutboundMessage {
+    std::shared_ptr<IChannel> spChannel;
+    std::string strData;
+    EmbeddedText embedded;
+  };
 
-  SessionState m_eSessionState{ SessionState_Original };
+  // Read by the server after each request and while expiring sessions.
+  std::atomic<SessionState> m_eSessionState{ SessionState_Original };
   std::string m_strSessionId;
+  // Replaced by every HTTP request of the session, possibly while another
+  // request of the session is being processed.
+  mutable std::mutex m_mtxChannel;
   std::shared_ptr<IChannel> m_channel;
+  // Messages are processed one at a time even when several channels of the
+  // session are read at once; tool calls still run concurrently.
+  std::mutex m_mtxProcess;
 
   MCP::Implementation m_serverInfo;
   MCP::ServerCapabilities m_capabilities;
-  std::vector<MCP::Tool> m_tools;
+  std::shared_ptr<MCP::CToolRegistry> m_spToolRegistry;
   bool m_bToolsPagination{ false };
+  std::chrono::milliseconds m_progressInterval{
+    DEFAULT_PROGRESS_NOTIFY_INTERVAL_MS
+  };
 
   std::unordered_map<MessageCategory,
     std::vector<std::shared_ptr<MCP::Message>>>
     m_hashMessage;
-  std::unordered_map<std::string, std::shared_ptr<MCP::ProcessCallToolRequest>>
-    m_hashCallToolsTasks;
 
+  // Runs while tool calls are queued or running, so an idle session holds
+  // no thread.
   std::unique_ptr<std::thread> m_upTaskThread;
+  bool m_bTaskThreadActive{ false };
+  bool m_bTasksEnabled{ false };
   std::atomic_bool m_bRunAsyncTask{ true };
   std::mutex m_mtxAsyncThread;
   std::condition_variable m_cvAsyncThread;
+  std::condition_variable m_cvTasksIdle;
   std::deque<std::shared_ptr<MCP::CMCPTask>> m_deqAsyncTasks;
   std::vector<MCP::RequestId> m_vecCancelledTaskIds;
   std::vector<std::shared_ptr<MCP::CMCPTask>> m_vecAsyncTasksCache;
+  // Tasks taken off the queue and not yet executed or cached.
+  size_t m_nTakenTasks{ 0 };
+  std::shared_ptr<MCP::CMCPTask> m_spExecutingTask;
+  bool m_bAsyncTaskFinished{ false };
+  // Set by CancelTasks(); later calls are answered without running.
+  bool m_bTasksDropped{ false };
+
+  // Started by a held back progress update.
+  std::unique_ptr<std::thread> m_upProgressThread;
+  bool m_bProgressTimerActive{ false };
+  std::mutex m_mtxProgressTimer;
+  std::condition_variable m_cvProgressTimer;
+  std::chrono::steady_clock::time_point m_tpProgressDue{
+    std::chrono::steady_clock::time_point::max()
+  };
+  bool m_bProgressTimerStopped{ false };
+
+  mutable std::mutex m_mtxOutbound;
+  std::condition_variable m_cvOutbound;
+  std::deque<OutboundMessage> m_deqOutbound;
+  // Queued and being written.
+  size_t m_nOutboundBytes{ 0 };
+  bool m_bOutboundWriting{ false };
+  // The last write that failed, returned to later messages for its channel.
+  int m_iOutboundError{ ERRNO_OK };
+  std::weak_ptr<IChannel> m_wpFailedChannel;
 };
 
 }  // namespace MCP
@@ -0,0 +1,197 @@
+#include "SessionTable.h"
+
+namespace MCP {
+
+void CSessionTable::SetLimits(
+  std::chrono::milliseconds idleTimeout, size_t nMaxSessions) {
+  m_llIdleTimeoutMs = idleTimeout.count();
+  m_nMaxPerShard =
+    (nMaxSessions + SESSION_SHARD_COUNT - 1) / SESSION_SHARD_COUNT;
+}
+
+std::shared_ptr<CMCPSession> CSessionTable::Find(
+  std::string_view strSessionId) {
+  auto& shard = GetShard(strSessionId);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto itr = shard.hashEntries.find(strSessionId);
+  if (itr == shard.hashEntries.end())
+    return nullptr;
+
+  auto itrEntry = itr->second;
+  itrEntry->tpLastUsed = std::chrono::steady_clock::now();
+  shard.listEntries.splice(
+    shard.listEntries.begin(), shard.listEntries, itrEntry);
+  return itrEntry->spSession;
+}
+
+void CSessionTable::Insert(const std::shared_ptr<CMCPSession>& spSession,
+  std::vector<std::shared_ptr<CMCPSession>>& vecEvicted,
+  const InUseCheck& fnInUse) {
+  std::string_view strSessionId = spSession->GetSessionId();
+  auto& shard = GetShard(strSessionId);
+  std::vector<std::shared_ptr<CMCPSession>> vecOldest;
+  std::chrono::steady_clock::time_point tpNow;
+  size_t nOver = 0;
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    tpNow = std::chrono::steady_clock::now();
+    auto itr = shard.hashEntries.find(strSessionId);
+    if (itr != shard.hashEntries.end()) {
+      itr->second->tpLastUsed = tpNow;
+      shard.listEntries.splice(
+        shard.listEntries.begin(), shard.listEntries, itr->second);
+      return;
+    }
+
+    shard.listEntries.push_front(Entry{ spSession, tpNow });
+    shard.hashEntries.emplace(strSessionId, shard.listEntries.begin());
+    ++m_nSessions;
+
+    size_t nMaxPerShard = m_nMaxPerShard;
+    if (0 == nMaxPerShard || shard.listEntries.size() <= nMaxPerShard)
+      return;
+
+    // Least recently used first, not the new one.
+    nOver = shard.listEntries.size() - nMaxPerShard;
+    for (auto itrEntry = shard.listEntries.rbegin();
+         std::next(itrEntry) != shard.listEntries.rend(); ++itrEntry) {
+      vecOldest.push_back(itrEntry->spSession);
+    }
+  }
+
+  // Sessions in use are kept, so the shard may stay over its share until
+  // they are idle.
+  std::vector<std::shared_ptr<CMCPSession>> vecIdle;
+  for (auto& spOldest : vecOldest) {
+    if (vecIdle.size() == nOver)
+      break;
+    if (!fnInUse || !fnInUse(spOldest))
+      vecIdle.push_back(spOldest);
+  }
+  if (vecIdle.empty())
+    return;
+
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  for (auto& spIdle : vecIdle) {
+    // Skip sessions used or replaced while the table was unlocked.
+    auto itr = shard.hashEntries.find(spIdle->GetSessionId());
+    if (itr == shard.hashEntries.end())
+      continue;
+    auto itrEntry = itr->second;
+    if (itrEntry->spSession != spIdle || itrEntry->tpLastUsed >= tpNow)
+      continue;
+
+    shard.hashEntries.erase(itr);
+    vecEvicted.push_back(std::move(itrEntry->spSession));
+    shard.listEntries.erase(itrEntry);
+    --m_nSessions;
+    ++m_ullEvicted;
+  }
+}
+
+std::shared_ptr<CMCPSession> CSessionTable::Erase(
+  std::string_view strSessionId) {
+  // The key views the stored session's id, which may be what the caller
+  // passed; keep the session alive until the entry is gone.
+  std::shared_ptr<CMCPSession> spSession;
+  auto& shard = GetShard(strSessionId);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto itr = shard.hashEntries.find(strSessionId);
+  if (itr != shard.hashEntries.end()) {
+    auto itrEntry = itr->second;
+    spSession = std::move(itrEntry->spSession);
+    shard.hashEntries.erase(itr);
+    shard.listEntries.erase(itrEntry);
+    --m_nSessions;
+  }
+  return spSession;
+}
+
+std::shared_ptr<CMCPSession> CSessionTable::Delete(
+  std::string_view strSessionId) {
+  auto spSession = Erase(strSessionId);
+  if (spSession)
+    ++m_ullDeleted;
+
+  return spSession;
+}
+
+void CSessionTable::ExpireIdle(
+  std::vector<std::shared_ptr<CMCPSession>>& vecExpired,
+  const InUseCheck& fnInUse) {
+  std::chrono::milliseconds idleTimeout(m_llIdleTimeoutMs.load());
+  if (idleTimeout.count() <= 0)
+    return;
+
+  auto tpOldest = std::chrono::steady_clock::now() - idleTimeout;
+  for (auto& shard : m_arrShards) {
+    std::vector<std::shared_ptr<CMCPSession>> vecIdle;
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      for (auto itr = shard.listEntries.rbegin();
+           itr != shard.listEntries.rend() && itr->tpLastUsed < tpOldest;
+           ++itr) {
+        vecIdle.push_back(itr->spSession);
+      }
+    }
+    if (vecIdle.empty())
+      continue;
+
+    std::vector<bool> vecInUse;
+    for (auto& spSession : vecIdle) {
+      vecInUse.push_back(fnInUse && fnInUse(spSession));
+    }
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto tpNow = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < vecIdle.size(); ++i) {
+      // Skip sessions used or replaced while the table was unlocked.
+      auto itr = shard.hashEntries.find(vecIdle[i]->GetSessionId());
+      if (itr == shard.hashEntries.end())
+        continue;
+      auto itrEntry = itr->second;
+      if (itrEntry->spSession != vecIdle[i] ||
+          itrEntry->tpLastUsed >= tpOldest)
+        continue;
+
+      if (vecInUse[i]) {
+        itrEntry->tpLastUsed = tpNow;
+        shard.listEntries.splice(
+          shard.listEntries.begin(), shard.listEntries, itrEntry);
+        continue;
+      }
+      shard.hashEntries.erase(itr);
+      vecExpired.push_back(std::move(itrEntry->spSession));
+      shard.listEntries.erase(itrEntry);
+      --m_nSessions;
+      ++m_ullExpired;
+    }
+  }
+}
+
+void CSessionTable::Clear() {
+  for (auto& shard : m_arrShards) {
+    std::list<Entry> listEntries;
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      m_nSessions -= shard.listEntries.size();
+      shard.hashEntries.clear();
+      listEntries.swap(shard.listEntries);
+    }
+  }
+}
+
+SessionStats CSessionTable::GetStats() const {
+  SessionStats stats;
+  stats.nSessions = m_nSessions;
+  stats.ullExpired = m_ullExpired;
+  stats.ullEvicted = m_ullEvicted;
+  stats.ullDeleted = m_ullDeleted;
+  return stats;
+}
+
+CSessionTable::Shard& CSessionTable::GetShard(std::string_view strSessionId) {
+  return m_arrShards[GetSessionShard(strSessionId)];
+}
+
+}  // namespace MCP
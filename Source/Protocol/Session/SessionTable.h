@@ -0,0 +1,91 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "../Public/SessionId.h"
+#include "Session.h"
+
+namespace MCP {
+
+struct SessionStats {
+  size_t nSessions{ 0 };
+  // Removed after being idle longer than the timeout.
+  unsigned long long ullExpired{ 0 };
+  // Removed as least recently used when the table was full.
+  unsigned long long ullEvicted{ 0 };
+  // Ended by the client.
+  unsigned long long ullDeleted{ 0 };
+};
+
+// Sessions of a server by id, split into shards so requests of different
+// sessions do not wait on one lock. The shard is read from the id.
+class CSessionTable {
+public:
+  CSessionTable() = default;
+  CSessionTable(const CSessionTable&) = delete;
+  CSessionTable& operator=(const CSessionTable&) = delete;
+
+  // Zero disables the limit. The session count is enforced per shard, as
+  // its share of nMaxSessions.
+  void SetLimits(std::chrono::milliseconds idleTimeout, size_t nMaxSessions);
+
+  // Called without the table locked.
+  using InUseCheck =
+    std::function<bool(const std::shared_ptr<CMCPSession>& spSession)>;
+
+  // Marks the session as used.
+  std::shared_ptr<CMCPSession> Find(std::string_view strSessionId);
+  // Keyed by the session's id, which must not change while it is stored.
+  // Marks the session as used if it is already present. The least recently
+  // used sessions pushed out of a full shard are added to vecEvicted,
+  // skipping those fnInUse reports as still in use.
+  void Insert(const std::shared_ptr<CMCPSession>& spSession,
+    std::vector<std::shared_ptr<CMCPSession>>& vecEvicted,
+    const InUseCheck& fnInUse = InUseCheck());
+  std::shared_ptr<CMCPSession> Erase(std::string_view strSessionId);
+  // Erase() for a session the client ended.
+  std::shared_ptr<CMCPSession> Delete(std::string_view strSessionId);
+  // Moves the sessions idle longer than the timeout to vecExpired. Those
+  // fnInUse reports as still in use are marked as used instead.
+  void ExpireIdle(std::vector<std::shared_ptr<CMCPSession>>& vecExpired,
+    const InUseCheck& fnInUse = InUseCheck());
+  void Clear();
+
+  SessionStats GetStats() const;
+
+private:
+  struct Entry {
+    std::shared_ptr<CMCPSession> spSession;
+    std::chrono::steady_clock::time_point tpLastUsed;
+  };
+
+  struct Shard {
+    std::mutex mutex;
+    // Most recently used first.
+    std::list<Entry> listEntries;
+    // Keys view the id owned by the session.
+    std::unordered_map<std::string_view, std::list<Entry>::iterator>
+      hashEntries;
+  };
+
+  Shard& GetShard(std::string_view strSessionId);
+
+  std::array<Shard, SESSION_SHARD_COUNT> m_arrShards;
+  std::atomic<std::chrono::milliseconds::rep> m_llIdleTimeoutMs{ 0 };
+  std::atomic<size_t> m_nMaxPerShard{ 0 };
+  std::atomic<size_t> m_nSessions{ 0 };
+  std::atomic<unsigned long long> m_ullExpired{ 0 };
+  std::atomic<unsigned long long> m_ullEvicted{ 0 };
+  std::atomic<unsigned long long> m_ullDeleted{ 0 };
+};
+
+}  // namespace MCP
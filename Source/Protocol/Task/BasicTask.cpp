@@ -1,10 +1,11 @@
 #include "BasicTask.h"
 
 #include <chrono>
-#include <random>
+#include <string_view>
 
 #include "../Message/Notification.h"
 #include "../Public/Logger.h"
+#include "../Public/SessionId.h"
 #include "../Session/Session.h"
 
 namespace MCP {
@@ -102,12 +103,7 @@ int ProcessErrorRequest::Execute() {
     LOG_ERROR("Session not available");
     return ERRNO_INTERNAL_ERROR;
   }
-  auto channel = m_pSession->GetChannel();
-  if (!channel) {
-    LOG_ERROR("Channel not available");
-    return ERRNO_INTERNAL_ERROR;
-  }
-  if (ERRNO_OK != channel->Write(strResponse)) {
+  if (ERRNO_OK != m_pSession->WriteOutbound(strResponse)) {
     LOG_ERROR("Failed to write error response");
     return ERRNO_INTERNAL_ERROR;
   }
@@ -161,15 +157,7 @@ int ProcessInitializeRequest::Execute() {
     return ERRNO_INTERNAL_ERROR;
   }
 
-  auto now = std::chrono::system_clock::now();
-  auto timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
-    now.time_since_epoch())
-                     .count();
-  std::random_device rd;
-  std::mt19937 gen(rd());
-  std::uniform_int_distribution<> dis(1000, 9999);
-  std::string sessionId =
-    "session-" + std::to_string(timestamp) + "-" + std::to_string(dis(gen));
+  std::string sessionId = GenerateSessionId();
 
   m_pSession->SetSessionId(sessionId);
   LOG_INFO("ProcessInitializeRequest Creat Session ID: {}", sessionId);
@@ -178,7 +166,7 @@ int ProcessInitializeRequest::Execute() {
     return ERRNO_INTERNAL_ERROR;
   }
 
-  if (channel->Write(strResponse) != ERRNO_OK) {
+  if (m_pSession->WriteOutbound(strResponse) != ERRNO_OK) {
     LOG_ERROR("Failed to write initialize response");
     return ERRNO_INTERNAL_ERROR;
   }
@@ -217,12 +205,7 @@ int ProcessPingRequest::Execute() {
     LOG_ERROR("Failed to serialize ping result");
     return ERRNO_INTERNAL_ERROR;
   }
-  auto channel = m_pSession->GetChannel();
-  if (!channel) {
-    LOG_ERROR("Channel not available");
-    return ERRNO_INTERNAL_ERROR;
-  }
-  if (ERRNO_OK != channel->Write(strResponse)) {
+  if (ERRNO_OK != m_pSession->WriteOutbound(strResponse)) {
     LOG_ERROR("Failed to write ping response");
     return ERRNO_INTERNAL_ERROR;
   }
@@ -258,6 +241,8 @@ int ProcessListToolsRequest::Execute() {
 
   std::shared_ptr<ListToolsResult> spListToolsResult = nullptr;
   std::string strResponse;
+  // The shared tools catalog inside strResponse, if spliced in.
+  EmbeddedText embeddedTools;
 
   bool bPagination = m_pSession->GetServerToolsPagination();
   if (bPagination) {
@@ -272,7 +257,12 @@ int ProcessListToolsRequest::Execute() {
         bValidCursor = false;
       }
 
-      auto vecServerTools = m_pSession->GetServerTools();
+      auto spSnapshot = m_pSession->GetServerToolsSnapshot();
+      if (!spSnapshot) {
+        LOG_ERROR("Tools snapshot not available");
+        return ERRNO_INTERNAL_ERROR;
+      }
+      const auto& vecServerTools = spSnapshot->GetTools();
       if (bValidCursor) {
         if (nCursor >= vecServerTools.size()) {
           bValidCursor = false;
@@ -314,7 +304,12 @@ int ProcessListToolsRequest::Execute() {
         return ERRNO_INTERNAL_ERROR;
       }
       spListToolsResult->requestId = spListToolRequest->requestId;
-      auto vecServerTools = m_pSession->GetServerTools();
+      auto spSnapshot = m_pSession->GetServerToolsSnapshot();
+      if (!spSnapshot) {
+        LOG_ERROR("Tools snapshot not available");
+        return ERRNO_INTERNAL_ERROR;
+      }
+      const auto& vecServerTools = spSnapshot->GetTools();
       spListToolsResult->vecTools.clear();
       if (vecServerTools.size() > 0)
         spListToolsResult->vecTools.push_back(vecServerTools[0]);
@@ -329,7 +324,27 @@ int ProcessListToolsRequest::Execute() {
       return ERRNO_INTERNAL_ERROR;
     }
     spListToolsResult->requestId = spListToolRequest->requestId;
-    spListToolsResult->vecTools = m_pSession->GetServerTools();
+    auto spSnapshot = m_pSession->GetServerToolsSnapshot();
+    if (!spSnapshot) {
+      LOG_ERROR("Tools snapshot not available");
+      return ERRNO_INTERNAL_ERROR;
+    }
+    // The catalog is serialized once per snapshot; splice it into an
+    // otherwise empty result instead of rebuilding every tool.
+    if (ERRNO_OK != spListToolsResult->Serialize(strResponse)) {
+      LOG_ERROR("Failed to serialize list tools result");
+      return ERRNO_INTERNAL_ERROR;
+    }
+    static constexpr std::string_view EMPTY_TOOLS = "\"tools\":[]";
+    size_t nPos = strResponse.rfind(EMPTY_TOOLS);
+    if (nPos == std::string::npos) {
+      LOG_ERROR("Failed to find the tools array in list tools result");
+      return ERRNO_INTERNAL_ERROR;
+    }
+    embeddedTools.spText = spSnapshot->GetSerializedTools();
+    embeddedTools.nOffset = nPos + EMPTY_TOOLS.size() - 2;
+    strResponse.replace(embeddedTools.nOffset, 2, *embeddedTools.spText);
+    spListToolsResult = nullptr;
   }
 
   if (spListToolsResult) {
@@ -340,12 +355,7 @@ int ProcessListToolsRequest::Execute() {
   }
 
   if (!strResponse.empty()) {
-    auto channel = m_pSession->GetChannel();
-    if (!channel) {
-      LOG_ERROR("Channel not available");
-      return ERRNO_INTERNAL_ERROR;
-    }
-    if (ERRNO_OK != channel->Write(strResponse)) {
+    if (ERRNO_OK != m_pSession->WriteOutbound(strResponse, embeddedTools)) {
       LOG_ERROR("Failed to write list tools response");
       return ERRNO_INTERNAL_ERROR;
     }
@@ -365,6 +375,27 @@ bool ProcessCallToolRequest::IsCancelled() const {
   return m_bCancelled;
 }
 
+int ProcessCallToolRequest::Reset() {
+  m_bFinished = false;
+  m_bCancelled = false;
+  m_progress = ProgressState();
+  m_spRequest = nullptr;
+  m_pSession = nullptr;
+
+  return ERRNO_OK;
+}
+
+ProcessCallToolRequest::ProgressState&
+ProcessCallToolRequest::ProgressState::operator=(const ProgressState&) {
+  std::lock_guard<std::mutex> lock(mtx);
+  tpLast = std::chrono::steady_clock::time_point();
+  bPending = false;
+  iProgress = -1;
+  iTotal = -1;
+
+  return *this;
+}
+
 std::shared_ptr<MCP::CallToolResult> ProcessCallToolRequest::BuildResult() {
   if (!IsValid()) {
     LOG_ERROR("Invalid call tool request");
@@ -392,6 +423,74 @@ int ProcessCallToolRequest::NotifyProgress(int iProgress, int iTotal) {
     return ERRNO_INTERNAL_ERROR;
   }
 
+  if (!m_spRequest->progressToken.IsValid())
+    return ERRNO_OK;
+
+  // The write may wait for the peer, so it is done after unlocking.
+  {
+    std::lock_guard<std::mutex> lock(m_progress.mtx);
+    m_progress.iProgress = iProgress;
+    m_progress.iTotal = iTotal;
+    m_progress.bPending = true;
+
+    auto now = std::chrono::steady_clock::now();
+    auto interval = m_pSession->GetProgressNotifyInterval();
+    if (now - m_progress.tpLast < interval) {
+      m_pSession->ScheduleProgressFlush(m_progress.tpLast + interval);
+      return ERRNO_OK;
+    }
+
+    m_progress.tpLast = now;
+    m_progress.bPending = false;
+  }
+  return WriteProgress(iProgress, iTotal);
+}
+
+int ProcessCallToolRequest::FlushProgress() {
+  int iProgress = -1;
+  int iTotal = -1;
+  {
+    std::lock_guard<std::mutex> lock(m_progress.mtx);
+    if (!m_progress.bPending)
+      return ERRNO_OK;
+
+    m_progress.tpLast = std::chrono::steady_clock::now();
+    m_progress.bPending = false;
+    iProgress = m_progress.iProgress;
+    iTotal = m_progress.iTotal;
+  }
+  return WriteProgress(iProgress, iTotal);
+}
+
+std::chrono::steady_clock::time_point
+ProcessCallToolRequest::FlushDueProgress() {
+  int iProgress = -1;
+  int iTotal = -1;
+  {
+    std::lock_guard<std::mutex> lock(m_progress.mtx);
+    if (!m_progress.bPending || !m_pSession)
+      return std::chrono::steady_clock::time_point();
+
+    auto now = std::chrono::steady_clock::now();
+    auto tpDue = m_progress.tpLast + m_pSession->GetProgressNotifyInterval();
+    if (now < tpDue)
+      return tpDue;
+
+    m_progress.tpLast = now;
+    m_progress.bPending = false;
+    iProgress = m_progress.iProgress;
+    iTotal = m_progress.iTotal;
+  }
+  WriteProgress(iProgress, iTotal);
+  return std::chrono::steady_clock::time_point();
+}
+
+int ProcessCallToolRequest::WriteProgress(int iProgress, int iTotal) {
+  if (!m_spRequest || !m_pSession) {
+    LOG_ERROR("Request or session not available for progress notification");
+    return ERRNO_INTERNAL_ERROR;
+  }
+
   if (m_spRequest->progressToken.IsValid()) {
     LOG_DEBUG("Notifying progress: {}/{}", iProgress, iTotal);
     MCP::ProgressNotification progressNotification(false);
@@ -405,12 +504,7 @@ int ProcessCallToolRequest::NotifyProgress(int iProgress, int iTotal) {
       LOG_ERROR("Failed to serialize progress notification");
       return ERRNO_INTERNAL_ERROR;
     }
-    auto channel = m_pSession->GetChannel();
-    if (!channel) {
-      LOG_ERROR("Channel not available");
-      return ERRNO_INTERNAL_ERROR;
-    }
-    if (ERRNO_OK != channel->Write(strNotification)) {
+    if (ERRNO_OK != m_pSession->WriteOutbound(strNotification)) {
       LOG_ERROR("Failed to write progress notification");
       return ERRNO_INTERNAL_ERROR;
     }
@@ -435,22 +529,72 @@ int ProcessCallToolRequest::NotifyResult(
 
   LOG_INFO("Notifying call tool result");
 
+  if (ERRNO_OK != FlushProgress()) {
+    LOG_WARNING("Failed to flush pending progress notification");
+  }
+
+  int iErrCode = ERRNO_OK;
   std::string strResponse;
   if (ERRNO_OK != spResult->Serialize(strResponse)) {
     LOG_ERROR("Failed to serialize call tool result");
-    return ERRNO_INTERNAL_ERROR;
+    iErrCode = ERRNO_INTERNAL_ERROR;
+  } else if (ERRNO_OK != m_pSession->WriteOutbound(strResponse)) {
+    LOG_ERROR("Failed to write call tool response");
+    iErrCode = ERRNO_INTERNAL_ERROR;
   }
-  auto channel = m_pSession->GetChannel();
-  if (!channel) {
-    LOG_ERROR("Channel not available");
+
+  m_pSession->OnAsyncTaskFinished();
+  return iErrCode;
+}
+
+std::shared_ptr<MCP::CCallToolResultStream>
+ProcessCallToolRequest::BeginStreamResult() {
+  if (!IsValid()) {
+    LOG_ERROR("Invalid call tool request");
+    return nullptr;
+  }
+
+  if (!m_pSession) {
+    LOG_ERROR("Session not available");
+    return nullptr;
+  }
+
+  if (ERRNO_OK != FlushProgress()) {
+    LOG_WARNING("Failed to flush pending progress notification");
+  }
+  // Queued messages must reach the peer before the stream takes the channel.
+  m_pSession->FlushOutbound();
+
+  LOG_INFO("Streaming call tool result");
+
+  auto spStream = std::make_shared<MCP::CCallToolResultStream>(
+    m_pSession->GetChannel(), m_spRequest->requestId);
+  if (!spStream || ERRNO_OK != spStream->Begin()) {
+    LOG_ERROR("Failed to begin call tool result stream");
+    return nullptr;
+  }
+
+  return spStream;
+}
+
+int ProcessCallToolRequest::EndStreamResult(
+  std::shared_ptr<MCP::CCallToolResultStream> spStream, bool bIsError) {
+  m_bFinished = true;
+
+  if (!spStream) {
+    LOG_ERROR("Result stream not available");
     return ERRNO_INTERNAL_ERROR;
   }
-  if (ERRNO_OK != channel->Write(strResponse)) {
+
+  int iErrCode = ERRNO_OK;
+  if (ERRNO_OK != spStream->Finish(bIsError)) {
     LOG_ERROR("Failed to write call tool response");
-    return ERRNO_INTERNAL_ERROR;
+    iErrCode = ERRNO_INTERNAL_ERROR;
   }
 
-  return ERRNO_OK;
+  if (m_pSession)
+    m_pSession->OnAsyncTaskFinished();
+  return iErrCode;
 }
 
 }  // namespace MCP
@@ -2,8 +2,11 @@
 
 #include "../Message/Request.h"
 #include "../Message/Response.h"
+#include "CallToolResultStream.h"
 #include "Task.h"
+#include <chrono>
 #include <memory>
+#include <mutex>
 
 namespace MCP {
 
@@ -79,13 +82,44 @@ public:
 
   bool IsFinished() const override;
   bool IsCancelled() const override;
+  // Called before a pooled instance is reused (see CToolTaskPool). Override it
+  // to clear per-call state while keeping expensive state alive.
+  virtual int Reset();
   std::shared_ptr<MCP::CallToolResult> BuildResult();
+  // Progress updates are coalesced: within the session's progress interval
+  // only the latest value is kept. It is sent once the interval expired, or
+  // before the result.
   int NotifyProgress(int iProgress, int iTotal);
+  int FlushProgress();
+  // Sends the held back update once the interval since the last one expired.
+  // Returns when it is due otherwise, or the epoch if none is held back.
+  std::chrono::steady_clock::time_point FlushDueProgress();
   int NotifyResult(std::shared_ptr<MCP::CallToolResult> spResult);
+  // Streaming alternative to BuildResult/NotifyResult for large results:
+  // append content to the returned stream, then call EndStreamResult.
+  std::shared_ptr<MCP::CCallToolResultStream> BeginStreamResult();
+  int EndStreamResult(
+    std::shared_ptr<MCP::CCallToolResultStream> spStream, bool bIsError);
 
 private:
+  int WriteProgress(int iProgress, int iTotal);
+
+  // Coalescing state of NotifyProgress. Copies (see Clone()) start empty.
+  struct ProgressState {
+    ProgressState() = default;
+    ProgressState(const ProgressState&) {}
+    ProgressState& operator=(const ProgressState&);
+
+    std::mutex mtx;
+    std::chrono::steady_clock::time_point tpLast;
+    bool bPending{ false };
+    int iProgress{ -1 };
+    int iTotal{ -1 };
+  };
+
   bool m_bFinished{ false };
   bool m_bCancelled{ false };
+  ProgressState m_progress;
 };
 
 }  // namespace MCP
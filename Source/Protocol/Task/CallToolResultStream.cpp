@@ -0,0 +1,242 @@
+#include "CallToolResultStream.h"
+
+#include <json/json.h>
+
+#include "../Public/Logger.h"
+#include "../Public/PublicDef.h"
+
+namespace MCP {
+
+namespace {
+std::string WriteCompact(const Json::Value& jVal) {
+  Json::FastWriter writer;
+  writer.omitEndingLineFeed();
+  return writer.write(jVal);
+}
+
+// Escapes a chunk for use inside a JSON string. Bytes above 0x7f are copied
+// as is, so a UTF-8 sequence split across two chunks stays intact.
+void AppendEscaped(std::string& strOut, const std::string& strChunk) {
+  static const char* HEX = "0123456789abcdef";
+  strOut.reserve(strOut.size() + strChunk.size());
+  for (unsigned char ch : strChunk) {
+    switch (ch) {
+    case '"':
+      strOut += "\\\"";
+      break;
+    case '\\':
+      strOut += "\\\\";
+      break;
+    case '\b':
+      strOut += "\\b";
+      break;
+    case '\f':
+      strOut += "\\f";
+      break;
+    case '\n':
+      strOut += "\\n";
+      break;
+    case '\r':
+      strOut += "\\r";
+      break;
+    case '\t':
+      strOut += "\\t";
+      break;
+    default:
+      if (ch < 0x20) {
+        strOut += "\\u00";
+        strOut += HEX[ch >> 4];
+        strOut += HEX[ch & 0x0f];
+      } else {
+        strOut += static_cast<char>(ch);
+      }
+      break;
+    }
+  }
+}
+}  // namespace
+
+CCallToolResultStream::CCallToolResultStream(
+  std::shared_ptr<IChannel> spChannel, const MCP::RequestId& requestId)
+  : m_spChannel(spChannel), m_requestId(requestId) {}
+
+CCallToolResultStream::~CCallToolResultStream() {
+  if (m_bBegun && !m_bFinished) {
+    LOG_WARNING("Result stream destroyed before Finish, closing as error");
+    Finish(true);
+  }
+}
+
+int CCallToolResultStream::Begin() {
+  if (m_bBegun) {
+    LOG_ERROR("Result stream already started");
+    return ERRNO_INTERNAL_ERROR;
+  }
+  if (!m_spChannel) {
+    LOG_ERROR("Channel not available");
+    return ERRNO_INTERNAL_ERROR;
+  }
+  if (!m_requestId.IsValid()) {
+    LOG_ERROR("Invalid request id for result stream");
+    return ERRNO_INVALID_RESPONSE;
+  }
+
+  Json::Value jId(Json::objectValue);
+  m_requestId.DoSerialize(jId);
+
+  m_bBegun = true;
+  m_bStreaming = (ERRNO_OK == m_spChannel->BeginStream());
+  if (!m_bStreaming) {
+    LOG_DEBUG("Channel cannot stream, buffering result");
+  }
+
+  std::string strHead = "{\"";
+  strHead += MSG_KEY_ID;
+  strHead += "\":";
+  strHead += WriteCompact(jId[MSG_KEY_ID]);
+  strHead += ",\"";
+  strHead += MSG_KEY_JSONRPC;
+  strHead += "\":\"";
+  strHead += JSON_RPC_VER;
+  strHead += "\",\"";
+  strHead += MSG_KEY_RESULT;
+  strHead += "\":{\"";
+  strHead += MSG_KEY_CONTENT;
+  strHead += "\":[";
+
+  return Emit(strHead);
+}
+
+int CCallToolResultStream::AppendText(const std::string& strChunk) {
+  if (!m_bBegun || m_bFinished) {
+    LOG_ERROR("Result stream not open");
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  std::string strOut;
+  if (!m_bTextOpen) {
+    if (m_nItems++ > 0)
+      strOut += ",";
+    strOut += "{\"";
+    strOut += MSG_KEY_TYPE;
+    strOut += "\":\"";
+    strOut += CONST_TEXT;
+    strOut += "\",\"";
+    strOut += MSG_KEY_TEXT;
+    strOut += "\":\"";
+    m_bTextOpen = true;
+  }
+  AppendEscaped(strOut, strChunk);
+
+  return Emit(strOut);
+}
+
+int CCallToolResultStream::AppendContent(const MCP::TextContent& content) {
+  return AppendItem(content);
+}
+
+int CCallToolResultStream::AppendContent(const MCP::ImageContent& content) {
+  return AppendItem(content);
+}
+
+int CCallToolResultStream::AppendContent(
+  const MCP::EmbeddedResource& content) {
+  return AppendItem(content);
+}
+
+int CCallToolResultStream::Finish(bool bIsError) {
+  if (!m_bBegun || m_bFinished) {
+    LOG_ERROR("Result stream not open");
+    return ERRNO_INTERNAL_ERROR;
+  }
+  // Finished even if writing fails, so the destructor does not end the
+  // response a second time.
+  m_bFinished = true;
+
+  int iErrCode = CloseText();
+  if (ERRNO_OK == iErrCode) {
+    std::string strTail = "],\"";
+    strTail += MSG_KEY_IS_ERROR;
+    strTail += "\":";
+    strTail += bIsError ? "true" : "false";
+    strTail += "}}";
+    iErrCode = Emit(strTail);
+  }
+  if (ERRNO_OK != iErrCode) {
+    if (m_bStreaming)
+      m_spChannel->EndStream();
+    return iErrCode;
+  }
+
+  if (!m_bStreaming) {
+    // Keep the framing of Message::Serialize for the single write.
+    m_strBuffer += "\n";
+    iErrCode = m_spChannel->Write(m_strBuffer);
+    m_strBuffer.clear();
+    return iErrCode;
+  }
+
+  iErrCode = Flush();
+  int iEndErrCode = m_spChannel->EndStream();
+  return ERRNO_OK != iErrCode ? iErrCode : iEndErrCode;
+}
+
+bool CCallToolResultStream::IsFinished() const {
+  return m_bFinished;
+}
+
+int CCallToolResultStream::AppendItem(const MCP::Message& content) {
+  if (!m_bBegun || m_bFinished) {
+    LOG_ERROR("Result stream not open");
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  Json::Value jContent(Json::objectValue);
+  int iErrCode = content.DoSerialize(jContent);
+  if (ERRNO_OK != iErrCode) {
+    LOG_ERROR("Failed to serialize result content");
+    return iErrCode;
+  }
+
+  iErrCode = CloseText();
+  if (ERRNO_OK != iErrCode)
+    return iErrCode;
+
+  std::string strOut;
+  if (m_nItems++ > 0)
+    strOut += ",";
+  strOut += WriteCompact(jContent);
+
+  return Emit(strOut);
+}
+
+int CCallToolResultStream::CloseText() {
+  if (!m_bTextOpen)
+    return ERRNO_OK;
+
+  m_bTextOpen = false;
+  return Emit("\"}");
+}
+
+int CCallToolResultStream::Emit(const std::string& str) {
+  m_strBuffer += str;
+  if (!m_bStreaming || m_strBuffer.size() < FLUSH_THRESHOLD)
+    return ERRNO_OK;
+
+  return Flush();
+}
+
+int CCallToolResultStream::Flush() {
+  if (m_strBuffer.empty())
+    return ERRNO_OK;
+
+  int iErrCode = m_spChannel->WriteStream(m_strBuffer);
+  m_strBuffer.clear();
+  if (ERRNO_OK != iErrCode) {
+    LOG_ERROR("Failed to write result stream, error: {}", iErrCode);
+  }
+
+  return iErrCode;
+}
+
+}  // namespace MCP
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "../Message/BasicMessage.h"
+#include "../Transport/Channel.h"
+
+namespace MCP {
+
+// Writes a tools/call result while the tool is still producing it. Content
+// items and text chunks are serialized as they are appended, so the complete
+// result never has to be held in memory. The output is still exactly one
+// JSON-RPC response. Channels that cannot stream receive it with one Write.
+class CCallToolResultStream {
+public:
+  // Buffered output is handed to the channel once it reaches this size.
+  static constexpr size_t FLUSH_THRESHOLD = 64 * 1024;
+
+  CCallToolResultStream(
+    std::shared_ptr<IChannel> spChannel, const MCP::RequestId& requestId);
+  ~CCallToolResultStream();
+  CCallToolResultStream(const CCallToolResultStream&) = delete;
+  CCallToolResultStream& operator=(const CCallToolResultStream&) = delete;
+
+  int Begin();
+  // Appends a chunk to the current text content item, opening one if needed.
+  int AppendText(const std::string& strChunk);
+  int AppendContent(const MCP::TextContent& content);
+  int AppendContent(const MCP::ImageContent& content);
+  int AppendContent(const MCP::EmbeddedResource& content);
+  int Finish(bool bIsError);
+  bool IsFinished() const;
+
+private:
+  int AppendItem(const MCP::Message& content);
+  int CloseText();
+  int Emit(const std::string& str);
+  int Flush();
+
+  std::shared_ptr<IChannel> m_spChannel;
+  MCP::RequestId m_requestId;
+  bool m_bBegun{ false };
+  bool m_bStreaming{ false };
+  bool m_bTextOpen{ false };
+  bool m_bFinished{ false };
+  size_t m_nItems{ 0 };
+  std::string m_strBuffer;
+};
+
+}  // namespace MCP
@@ -0,0 +1,183 @@
+#include "ToolRegistry.h"
+
+#include <algorithm>
+
+#include <json/json.h>
+
+#include "../Public/Compression.h"
+#include "../Public/Logger.h"
+#include "../Public/PublicDef.h"
+
+namespace MCP {
+////////////////////////////////////////////////////////////////////////////////////////
+// ToolTaskEntry
+std::shared_ptr<MCP::ProcessCallToolRequest> ToolTaskEntry::Acquire() const {
+  if (spPool)
+    return spPool->Acquire();
+
+  if (!spPrototype)
+    return nullptr;
+
+  return std::dynamic_pointer_cast<MCP::ProcessCallToolRequest>(
+    spPrototype->Clone());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// CToolsSnapshot
+CToolsSnapshot::CToolsSnapshot(const std::vector<MCP::Tool>& vecTools,
+  const std::map<std::string, MCP::ToolTaskEntry>& mapTasks,
+  unsigned long long ullVersion)
+  : m_vecTools(vecTools), m_ullVersion(ullVersion) {
+  // Reserve up front so the views stored in m_hashTasks stay valid.
+  m_vecTaskNames.reserve(mapTasks.size());
+  m_hashTasks.reserve(mapTasks.size());
+  for (const auto& task : mapTasks) {
+    m_vecTaskNames.push_back(task.first);
+    m_hashTasks.emplace(m_vecTaskNames.back(), task.second);
+  }
+
+  Json::Value jTools(Json::arrayValue);
+  for (const auto& tool : m_vecTools) {
+    Json::Value jTool(Json::objectValue);
+    if (ERRNO_OK == tool.DoSerialize(jTool)) {
+      jTools.append(jTool);
+    }
+  }
+  Json::FastWriter writer;
+  writer.omitEndingLineFeed();
+  m_spSerializedTools =
+    std::make_shared<const std::string>(writer.write(jTools));
+  // Large catalogs are compressed once for HTTP clients instead of on every
+  // tools/list.
+  CPrecompressedTexts::GetInstance().Register(m_spSerializedTools);
+}
+
+const std::vector<MCP::Tool>& CToolsSnapshot::GetTools() const {
+  return m_vecTools;
+}
+
+std::shared_ptr<const std::string> CToolsSnapshot::GetSerializedTools() const {
+  return m_spSerializedTools;
+}
+
+std::shared_ptr<MCP::ProcessCallToolRequest> CToolsSnapshot::FindTask(
+  std::string_view strToolName) const {
+  auto pEntry = FindTaskEntry(strToolName);
+  if (pEntry)
+    return pEntry->spPrototype;
+
+  return nullptr;
+}
+
+const MCP::ToolTaskEntry* CToolsSnapshot::FindTaskEntry(
+  std::string_view strToolName) const {
+  auto itr = m_hashTasks.find(strToolName);
+  if (itr != m_hashTasks.end())
+    return &itr->second;
+
+  return nullptr;
+}
+
+unsigned long long CToolsSnapshot::GetVersion() const {
+  return m_ullVersion;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// CToolRegistry
+CToolRegistry::CToolRegistry() {
+  Publish();
+}
+
+std::shared_ptr<const CToolsSnapshot> CToolRegistry::GetSnapshot() const {
+  return std::atomic_load(&m_spSnapshot);
+}
+
+void CToolRegistry::SetTools(const std::vector<MCP::Tool>& vecTools) {
+  std::lock_guard<std::mutex> lock(m_mtxWriter);
+  m_vecTools = vecTools;
+  Publish();
+}
+
+void CToolRegistry::SetTask(const std::string& strToolName,
+  std::shared_ptr<MCP::ProcessCallToolRequest> spTask) {
+  std::lock_guard<std::mutex> lock(m_mtxWriter);
+  m_mapTasks[strToolName].spPrototype = spTask;
+  Publish();
+}
+
+void CToolRegistry::SetTaskPool(
+  const std::string& strToolName, std::shared_ptr<MCP::CToolTaskPool> spPool) {
+  std::lock_guard<std::mutex> lock(m_mtxWriter);
+  m_mapTasks[strToolName].spPool = spPool;
+  Publish();
+}
+
+int CToolRegistry::AddTool(const MCP::Tool& tool,
+  std::shared_ptr<MCP::ProcessCallToolRequest> spTask) {
+  if (!spTask) {
+    LOG_ERROR("CToolRegistry::AddTool: Invalid task");
+    return ERRNO_INVALID_PARAMS;
+  }
+
+  MCP::ToolTaskEntry entry;
+  entry.spPrototype = spTask;
+  return AddToolEntry(tool, entry);
+}
+
+int CToolRegistry::AddTool(
+  const MCP::Tool& tool, std::shared_ptr<MCP::CToolTaskPool> spPool) {
+  if (!spPool) {
+    LOG_ERROR("CToolRegistry::AddTool: Invalid task pool");
+    return ERRNO_INVALID_PARAMS;
+  }
+
+  MCP::ToolTaskEntry entry;
+  entry.spPool = spPool;
+  return AddToolEntry(tool, entry);
+}
+
+int CToolRegistry::AddToolEntry(
+  const MCP::Tool& tool, const MCP::ToolTaskEntry& entry) {
+  if (!tool.IsValid()) {
+    LOG_ERROR("CToolRegistry::AddTool: Invalid tool");
+    return ERRNO_INVALID_PARAMS;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mtxWriter);
+  auto itr = std::find_if(m_vecTools.begin(), m_vecTools.end(),
+    [&tool](const MCP::Tool& item) { return item.strName == tool.strName; });
+  if (itr != m_vecTools.end())
+    *itr = tool;
+  else
+    m_vecTools.push_back(tool);
+  m_mapTasks[tool.strName] = entry;
+  Publish();
+
+  LOG_INFO("CToolRegistry::AddTool: Tool added: {}", tool.strName);
+  return ERRNO_OK;
+}
+
+int CToolRegistry::RemoveTool(std::string_view strToolName) {
+  std::lock_guard<std::mutex> lock(m_mtxWriter);
+  auto itr = std::find_if(m_vecTools.begin(), m_vecTools.end(),
+    [&strToolName](
+      const MCP::Tool& item) { return item.strName == strToolName; });
+  if (itr == m_vecTools.end()) {
+    LOG_WARNING("CToolRegistry::RemoveTool: Tool not found: {}", strToolName);
+    return ERRNO_INVALID_PARAMS;
+  }
+  m_vecTools.erase(itr);
+  m_mapTasks.erase(std::string(strToolName));
+  Publish();
+
+  LOG_INFO("CToolRegistry::RemoveTool: Tool removed: {}", strToolName);
+  return ERRNO_OK;
+}
+
+void CToolRegistry::Publish() {
+  auto spSnapshot = std::make_shared<const CToolsSnapshot>(
+    m_vecTools, m_mapTasks, ++m_ullVersion);
+  std::atomic_store(&m_spSnapshot, spSnapshot);
+}
+
+}  // namespace MCP
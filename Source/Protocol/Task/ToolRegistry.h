@@ -0,0 +1,85 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "../Message/BasicMessage.h"
+#include "BasicTask.h"
+#include "ToolTaskPool.h"
+
+namespace MCP {
+
+// How instances of one tool are produced for each tools/call: from a pool
+// when one is registered, otherwise by cloning the prototype.
+struct ToolTaskEntry {
+  std::shared_ptr<MCP::ProcessCallToolRequest> spPrototype;
+  std::shared_ptr<MCP::CToolTaskPool> spPool;
+
+  std::shared_ptr<MCP::ProcessCallToolRequest> Acquire() const;
+};
+
+// An immutable view of the registered tools. Sessions hold the snapshot by
+// pointer, so creating a session no longer copies the tool catalog.
+class CToolsSnapshot {
+public:
+  CToolsSnapshot(const std::vector<MCP::Tool>& vecTools,
+    const std::map<std::string, MCP::ToolTaskEntry>& mapTasks,
+    unsigned long long ullVersion);
+  CToolsSnapshot(const CToolsSnapshot&) = delete;
+  CToolsSnapshot& operator=(const CToolsSnapshot&) = delete;
+
+  const std::vector<MCP::Tool>& GetTools() const;
+  // The tools as a compact JSON array, serialized once per snapshot.
+  std::shared_ptr<const std::string> GetSerializedTools() const;
+  std::shared_ptr<MCP::ProcessCallToolRequest> FindTask(
+    std::string_view strToolName) const;
+  const MCP::ToolTaskEntry* FindTaskEntry(std::string_view strToolName) const;
+  unsigned long long GetVersion() const;
+
+private:
+  std::vector<MCP::Tool> m_vecTools;
+  std::shared_ptr<const std::string> m_spSerializedTools;
+  // Owns the key storage referenced by m_hashTasks.
+  std::vector<std::string> m_vecTaskNames;
+  std::unordered_map<std::string_view, MCP::ToolTaskEntry> m_hashTasks;
+  unsigned long long m_ullVersion{ 0 };
+};
+
+// Tool catalog shared by every session of a server. Readers load the current
+// snapshot without locking; writers build a new snapshot and swap it in.
+class CToolRegistry {
+public:
+  CToolRegistry();
+  CToolRegistry(const CToolRegistry&) = delete;
+  CToolRegistry& operator=(const CToolRegistry&) = delete;
+
+  std::shared_ptr<const CToolsSnapshot> GetSnapshot() const;
+
+  void SetTools(const std::vector<MCP::Tool>& vecTools);
+  void SetTask(const std::string& strToolName,
+    std::shared_ptr<MCP::ProcessCallToolRequest> spTask);
+  void SetTaskPool(
+    const std::string& strToolName, std::shared_ptr<MCP::CToolTaskPool> spPool);
+  int AddTool(const MCP::Tool& tool,
+    std::shared_ptr<MCP::ProcessCallToolRequest> spTask);
+  int AddTool(
+    const MCP::Tool& tool, std::shared_ptr<MCP::CToolTaskPool> spPool);
+  int RemoveTool(std::string_view strToolName);
+
+private:
+  int AddToolEntry(const MCP::Tool& tool, const MCP::ToolTaskEntry& entry);
+  void Publish();
+
+  std::mutex m_mtxWriter;
+  std::vector<MCP::Tool> m_vecTools;
+  std::map<std::string, MCP::ToolTaskEntry> m_mapTasks;
+  unsigned long long m_ullVersion{ 0 };
+  std::shared_ptr<const CToolsSnapshot> m_spSnapshot;
+};
+
+}  // namespace MCP
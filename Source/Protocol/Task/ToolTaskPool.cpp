@@ -0,0 +1,81 @@
+#include "ToolTaskPool.h"
+
+#include "../Public/Logger.h"
+#include "../Public/PublicDef.h"
+
+namespace MCP {
+
+CToolTaskPool::CToolTaskPool(Factory fnFactory, size_t nMaxIdle)
+  : m_fnFactory(std::move(fnFactory)), m_nMaxIdle(nMaxIdle) {}
+
+CToolTaskPool::CToolTaskPool(
+  const std::shared_ptr<MCP::ProcessCallToolRequest>& spPrototype,
+  size_t nMaxIdle)
+  : m_nMaxIdle(nMaxIdle) {
+  m_fnFactory = [spPrototype]() -> std::shared_ptr<ProcessCallToolRequest> {
+    if (!spPrototype)
+      return nullptr;
+
+    return std::dynamic_pointer_cast<ProcessCallToolRequest>(
+      spPrototype->Clone());
+  };
+}
+
+std::shared_ptr<MCP::ProcessCallToolRequest> CToolTaskPool::Acquire() {
+  std::shared_ptr<MCP::ProcessCallToolRequest> spTask;
+  {
+    std::lock_guard<std::mutex> lock(m_mtxIdle);
+    if (!m_vecIdle.empty()) {
+      spTask = std::move(m_vecIdle.back());
+      m_vecIdle.pop_back();
+    }
+  }
+
+  if (!spTask && m_fnFactory) {
+    LOG_DEBUG("CToolTaskPool::Acquire: Creating new tool instance");
+    spTask = m_fnFactory();
+  }
+  if (!spTask) {
+    LOG_ERROR("CToolTaskPool::Acquire: Failed to create tool instance");
+    return nullptr;
+  }
+
+  // The handed out pointer shares the instance; dropping the last copy of it
+  // returns the instance instead of destroying it.
+  std::weak_ptr<CToolTaskPool> wpPool = shared_from_this();
+  auto* pTask = spTask.get();
+  return std::shared_ptr<MCP::ProcessCallToolRequest>(
+    pTask, [wpPool, spTask](MCP::ProcessCallToolRequest*) mutable {
+      auto spPool = wpPool.lock();
+      if (spPool)
+        spPool->Release(std::move(spTask));
+    });
+}
+
+size_t CToolTaskPool::GetIdleCount() const {
+  std::lock_guard<std::mutex> lock(m_mtxIdle);
+  return m_vecIdle.size();
+}
+
+void CToolTaskPool::Release(
+  std::shared_ptr<MCP::ProcessCallToolRequest> spTask) {
+  if (!spTask)
+    return;
+
+  // Work the tool started may still use an unfinished instance, so it is not
+  // handed out again.
+  if (!spTask->IsFinished()) {
+    LOG_DEBUG("CToolTaskPool::Release: Instance not finished, dropping it");
+    return;
+  }
+  if (ERRNO_OK != spTask->Reset()) {
+    LOG_WARNING("CToolTaskPool::Release: Reset failed, dropping instance");
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mtxIdle);
+  if (m_vecIdle.size() < m_nMaxIdle)
+    m_vecIdle.push_back(std::move(spTask));
+}
+
+}  // namespace MCP
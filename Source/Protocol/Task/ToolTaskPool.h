@@ -0,0 +1,43 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "BasicTask.h"
+
+namespace MCP {
+
+// Keeps finished tool instances around so that tools holding expensive state
+// (parsers, database handles, models) are not rebuilt for every tools/call.
+// An acquired instance goes back to the pool when its last reference is
+// released, if it finished (NotifyResult() or EndStreamResult());
+// ProcessCallToolRequest::Reset() is called before it is reused.
+class CToolTaskPool : public std::enable_shared_from_this<CToolTaskPool> {
+public:
+  using Factory = std::function<std::shared_ptr<MCP::ProcessCallToolRequest>()>;
+
+  static constexpr size_t DEFAULT_MAX_IDLE = 8;
+
+  explicit CToolTaskPool(Factory fnFactory, size_t nMaxIdle = DEFAULT_MAX_IDLE);
+  // Creates new instances by cloning the prototype.
+  explicit CToolTaskPool(
+    const std::shared_ptr<MCP::ProcessCallToolRequest>& spPrototype,
+    size_t nMaxIdle = DEFAULT_MAX_IDLE);
+  CToolTaskPool(const CToolTaskPool&) = delete;
+  CToolTaskPool& operator=(const CToolTaskPool&) = delete;
+
+  std::shared_ptr<MCP::ProcessCallToolRequest> Acquire();
+  size_t GetIdleCount() const;
+
+private:
+  void Release(std::shared_ptr<MCP::ProcessCallToolRequest> spTask);
+
+  Factory m_fnFactory;
+  size_t m_nMaxIdle{ DEFAULT_MAX_IDLE };
+  mutable std::mutex m_mtxIdle;
+  std::vector<std::shared_ptr<MCP::ProcessCallToolRequest>> m_vecIdle;
+};
+
+}  // namespace MCP
@@ -5,23 +5,74 @@
 #include <windows.h>
 #define STDIN_FILENO _fileno(stdin)
 #else
+#include <fcntl.h>
 #include <poll.h>
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#endif
 #include <unistd.h>
 #endif
 
+#include <algorithm>
 #include <chrono>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
 #include "../Public/Logger.h"
 #include "../Public/PublicDef.h"
+#include "IoHelper.h"
 
 namespace MCP {
 
-CStdioChannel::CStdioChannel() : m_active(true) {}
+CStdioChannel::CStdioChannel(StdioFraming eFraming, size_t nMaxFrameSize)
+  : m_active(true), m_eFraming(eFraming), m_nMaxFrameSize(nMaxFrameSize) {
+#if defined(__linux__)
+  m_fdWakeRead = m_fdWakeWrite = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (m_fdWakeRead < 0) {
+    LOG_ERROR("CStdioChannel: eventfd failed, error code: {}", errno);
+  }
+#elif !defined(_WIN32)
+  int fds[2];
+  if (pipe(fds) == 0) {
+    for (int fd : fds) {
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+      fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    m_fdWakeRead = fds[0];
+    m_fdWakeWrite = fds[1];
+  } else {
+    LOG_ERROR("CStdioChannel: pipe failed, error code: {}", errno);
+  }
+#endif
+}
+
+CStdioChannel::~CStdioChannel() {
+#ifndef _WIN32
+  if (m_fdWakeWrite >= 0 && m_fdWakeWrite != m_fdWakeRead) {
+    close(m_fdWakeWrite);
+  }
+  if (m_fdWakeRead >= 0) {
+    close(m_fdWakeRead);
+  }
+#endif
+}
 
 int CStdioChannel::Read(std::string& data) {
-  while (m_active) {
+  std::string_view frame;
+  int iErrCode = ReadFrame(frame);
+  if (ERRNO_OK == iErrCode) {
+    data.assign(frame.data(), frame.size());
+  }
+  return iErrCode;
+}
+
+int CStdioChannel::ReadFrame(std::string_view& frame) {
 #ifdef _WIN32
+  while (m_active) {
     HANDLE hStdin = GetStdHandle(STD_INPUT_HANDLE);
     if (hStdin == INVALID_HANDLE_VALUE) {
       LOG_ERROR("CStdioChannel::Read: Failed to get stdin handle");
@@ -46,7 +97,11 @@ int CStdioChannel::Read(std::string& data) {
         continue;
       }
 
+      std::string data;
       if (std::getline(std::cin, data)) {
+        m_vecReadBuffer.assign(data.begin(), data.end());
+        frame =
+          std::string_view(m_vecReadBuffer.data(), m_vecReadBuffer.size());
         return ERRNO_OK;
       } else {
         if (std::cin.eof()) {
@@ -57,14 +112,84 @@ int CStdioChannel::Read(std::string& data) {
         }
       }
     }
+  }
+
+  return ERRNO_INTERNAL_INPUT_TERMINATE;
 #else
-    struct pollfd fds[1];
+  if (m_vecReadBuffer.empty()) {
+    m_vecReadBuffer.resize(READ_BUFFER_SIZE);
+  }
+
+  while (m_active) {
+    if (StdioFraming_Auto == m_eFraming) {
+      DetectFraming();
+    }
+
+    if (StdioFraming_ContentLength == m_eFraming) {
+      if (ExtractContentLengthFrame(frame)) {
+        return ERRNO_OK;
+      }
+      if (m_bFramingError) {
+        // The rest of the input cannot be told apart from the next frame.
+        Close();
+        return ERRNO_INTERNAL_INPUT_ERROR;
+      }
+    } else if (StdioFraming_Newline == m_eFraming) {
+      if (ExtractLineFrame(frame)) {
+        return ERRNO_OK;
+      }
+    }
+
+    if (m_bEof) {
+      if (StdioFraming_ContentLength != m_eFraming && m_nEnd > m_nBegin &&
+          !m_bDiscarding) {
+        frame = std::string_view(
+          m_vecReadBuffer.data() + m_nBegin, m_nEnd - m_nBegin);
+        m_nBegin = m_nScan = m_nEnd;
+        return ERRNO_OK;
+      }
+      if (m_nEnd > m_nBegin) {
+        LOG_WARNING("CStdioChannel::Read: Incomplete frame at end of input");
+      }
+      return ERRNO_INTERNAL_INPUT_TERMINATE;
+    }
+
+    // Move the partial frame to the front, and grow only for frames that do
+    // not fit into the buffer. A Content-Length body gets its exact size.
+    if (m_nBegin > 0) {
+      memmove(m_vecReadBuffer.data(), m_vecReadBuffer.data() + m_nBegin,
+        m_nEnd - m_nBegin);
+      m_nEnd -= m_nBegin;
+      m_nScan -= m_nBegin;
+      m_nBegin = 0;
+    }
+    // Do not keep the memory of a large frame once it has been consumed.
+    if (m_vecReadBuffer.size() > READ_BUFFER_SIZE &&
+        m_nEnd < READ_BUFFER_SIZE &&
+        (m_nBodySize == NO_BODY || m_nBodySize < READ_BUFFER_SIZE)) {
+      std::vector<char> vecBuffer(READ_BUFFER_SIZE);
+      memcpy(vecBuffer.data(), m_vecReadBuffer.data(), m_nEnd);
+      m_vecReadBuffer.swap(vecBuffer);
+    }
+    if (m_nBodySize != NO_BODY && m_nBodySize > m_vecReadBuffer.size()) {
+      m_vecReadBuffer.resize(m_nBodySize);
+    } else if (m_nEnd == m_vecReadBuffer.size()) {
+      m_vecReadBuffer.resize(m_vecReadBuffer.size() * 2);
+    }
+
+    struct pollfd fds[2];
     fds[0].fd = STDIN_FILENO;
     fds[0].events = POLLIN;
+    fds[1].fd = m_fdWakeRead;
+    fds[1].events = POLLIN;
 
-    int ret = poll(fds, 1, 50);
+    // Without a wake descriptor fall back to checking m_active periodically.
+    int ret = m_fdWakeRead >= 0 ? poll(fds, 2, -1) : poll(fds, 1, 50);
 
     if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
       LOG_ERROR("CStdioChannel::Read: poll call failed, error code: {}", errno);
       return ERRNO_INTERNAL_INPUT_ERROR;
     }
@@ -73,35 +198,363 @@ int CStdioChannel::Read(std::string& data) {
       return ERRNO_INTERNAL_INPUT_TERMINATE;
     }
 
-    if (ret > 0 && (fds[0].revents & POLLIN)) {
-      if (std::getline(std::cin, data)) {
-        return ERRNO_OK;
-      } else {
-        if (std::cin.eof()) {
-          return ERRNO_INTERNAL_INPUT_TERMINATE;
-        } else {
-          LOG_ERROR("CStdioChannel::Read: Failed to read input");
-          return ERRNO_INTERNAL_INPUT_ERROR;
+    if (fds[0].revents & POLLNVAL) {
+      LOG_ERROR("CStdioChannel::Read: stdin is not open");
+      return ERRNO_INTERNAL_INPUT_ERROR;
+    }
+    if (ret == 0 || !(fds[0].revents & (POLLIN | POLLHUP | POLLERR))) {
+      continue;
+    }
+
+    ssize_t nRead = read(STDIN_FILENO, m_vecReadBuffer.data() + m_nEnd,
+      m_vecReadBuffer.size() - m_nEnd);
+    if (nRead > 0) {
+      m_nEnd += static_cast<size_t>(nRead);
+    } else if (nRead == 0) {
+      m_bEof = true;
+    } else if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK) {
+      LOG_ERROR("CStdioChannel::Read: read call failed, error code: {}", errno);
+      return ERRNO_INTERNAL_INPUT_ERROR;
+    }
+  }
+
+  return ERRNO_INTERNAL_INPUT_TERMINATE;
+#endif
+}
+
+#ifndef _WIN32
+void CStdioChannel::DetectFraming() {
+  // JSON text cannot start with a letter, so a header means the peer uses
+  // Content-Length framing.
+  static constexpr std::string_view HEADER_PREFIX = "content-";
+
+  size_t nAvailable = std::min(m_nEnd - m_nBegin, HEADER_PREFIX.size());
+  if (nAvailable == 0) {
+    return;
+  }
+  for (size_t i = 0; i < nAvailable; ++i) {
+    char ch = static_cast<char>(
+      tolower(static_cast<unsigned char>(m_vecReadBuffer[m_nBegin + i])));
+    if (ch != HEADER_PREFIX[i]) {
+      m_eFraming = StdioFraming_Newline;
+      LOG_DEBUG("CStdioChannel: Using newline framing");
+      return;
+    }
+  }
+  if (nAvailable == HEADER_PREFIX.size() || m_bEof) {
+    m_eFraming = StdioFraming_ContentLength;
+    LOG_DEBUG("CStdioChannel: Using Content-Length framing");
+  }
+}
+
+bool CStdioChannel::ExtractLineFrame(std::string_view& frame) {
+  while (true) {
+    const char* pBuffer = m_vecReadBuffer.data();
+    const char* pNewline = FindNewline(pBuffer + m_nScan, m_nEnd - m_nScan);
+    if (!pNewline) {
+      m_nScan = m_nEnd;
+      if (m_nEnd - m_nBegin > m_nMaxFrameSize) {
+        LOG_ERROR("CStdioChannel::Read: Frame exceeds {} bytes, discarding",
+          m_nMaxFrameSize);
+        m_bDiscarding = true;
+      }
+      if (m_bDiscarding) {
+        m_nBegin = m_nScan = m_nEnd = 0;
+      }
+      return false;
+    }
+
+    size_t nNewline = pNewline - pBuffer;
+    size_t nBegin = m_nBegin;
+    m_nBegin = m_nScan = nNewline + 1;
+
+    if (m_bDiscarding) {
+      m_bDiscarding = false;
+      continue;
+    }
+
+    size_t nLength = nNewline - nBegin;
+    if (nLength > 0 && pBuffer[nBegin + nLength - 1] == '\r') {
+      --nLength;
+    }
+    if (nLength == 0) {
+      continue;
+    }
+
+    frame = std::string_view(pBuffer + nBegin, nLength);
+    return true;
+  }
+}
+
+bool CStdioChannel::ExtractContentLengthFrame(std::string_view& frame) {
+  static constexpr std::string_view CONTENT_LENGTH = "content-length:";
+
+  while (true) {
+    if (m_nDiscardBytes > 0) {
+      size_t nSkip = std::min(m_nDiscardBytes, m_nEnd - m_nBegin);
+      m_nBegin = m_nScan = m_nBegin + nSkip;
+      m_nDiscardBytes -= nSkip;
+      if (m_nDiscardBytes > 0) {
+        m_nBegin = m_nScan = m_nEnd = 0;
+        return false;
+      }
+    }
+
+    // Headers are parsed line by line; m_nScan is the start of the next
+    // unparsed header line.
+    while (m_nBodySize == NO_BODY) {
+      const char* pBuffer = m_vecReadBuffer.data();
+      const char* pNewline = FindNewline(pBuffer + m_nScan, m_nEnd - m_nScan);
+      size_t nHeaderSize = pNewline ? pNewline - pBuffer + 1 - m_nBegin
+        : m_nEnd - m_nBegin;
+      if (nHeaderSize > MAX_HEADER_SIZE) {
+        LOG_ERROR("CStdioChannel::Read: Frame header too large, closing");
+        m_bFramingError = true;
+        return false;
+      }
+      if (!pNewline) {
+        return false;
+      }
+
+      std::string_view line(pBuffer + m_nScan, pNewline - pBuffer - m_nScan);
+      m_nScan = pNewline - pBuffer + 1;
+      if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+      }
+
+      if (!line.empty()) {
+        if (line.size() > CONTENT_LENGTH.size() &&
+            std::equal(CONTENT_LENGTH.begin(), CONTENT_LENGTH.end(),
+              line.begin(), [](char lhs, char rhs) {
+                return lhs == tolower(static_cast<unsigned char>(rhs));
+              })) {
+          std::string strValue(line.substr(CONTENT_LENGTH.size()));
+          char* pEnd = nullptr;
+          unsigned long long ullLength = strtoull(strValue.c_str(), &pEnd, 10);
+          if (pEnd != strValue.c_str()) {
+            m_nHeaderLength = static_cast<size_t>(ullLength);
+          }
+        }
+        continue;
+      }
+
+      // An empty line ends the header block; one on its own is skipped.
+      bool bHasHeaders = m_nScan - m_nBegin > 2;
+      m_nBegin = m_nScan;
+      if (m_nHeaderLength == NO_BODY) {
+        if (bHasHeaders) {
+          LOG_ERROR("CStdioChannel::Read: Frame without Content-Length");
         }
+        continue;
       }
+      if (m_nHeaderLength > m_nMaxFrameSize) {
+        LOG_ERROR("CStdioChannel::Read: Frame of {} bytes exceeds {} bytes, "
+          "discarding", m_nHeaderLength, m_nMaxFrameSize);
+        m_nDiscardBytes = m_nHeaderLength;
+        m_nHeaderLength = NO_BODY;
+        break;
+      }
+      m_nBodySize = m_nHeaderLength;
+      m_nHeaderLength = NO_BODY;
+    }
+    if (m_nDiscardBytes > 0) {
+      continue;
+    }
+
+    if (m_nEnd - m_nBegin < m_nBodySize) {
+      return false;
+    }
+
+    frame = std::string_view(m_vecReadBuffer.data() + m_nBegin, m_nBodySize);
+    m_nBegin = m_nScan = m_nBegin + m_nBodySize;
+    m_nBodySize = NO_BODY;
+    if (frame.empty()) {
+      continue;
     }
+
+    return true;
+  }
+}
 #endif
+
+int CStdioChannel::Write(const std::string& data) {
+  if (!m_active) {
+    return ERRNO_INTERNAL_ERROR;
   }
 
-  return ERRNO_INTERNAL_INPUT_TERMINATE;
+  std::lock_guard<std::mutex> lock(m_mtxWrite);
+  if (m_bStreaming) {
+    m_vecDeferred.push_back(data);
+    return ERRNO_OK;
+  }
+
+  return WriteFrames(&data, 1);
 }
 
-int CStdioChannel::Write(const std::string& data) {
+int CStdioChannel::WriteBatch(const std::vector<std::string>& vecData) {
   if (!m_active) {
     return ERRNO_INTERNAL_ERROR;
   }
 
-  std::cout << data << std::endl;
+  std::lock_guard<std::mutex> lock(m_mtxWrite);
+  if (m_bStreaming) {
+    m_vecDeferred.insert(m_vecDeferred.end(), vecData.begin(), vecData.end());
+    return ERRNO_OK;
+  }
+
+  return WriteFrames(vecData.data(), vecData.size());
+}
+
+int CStdioChannel::BeginStream() {
+  if (!m_active) {
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  // The length header has to precede the body, so a Content-Length frame
+  // cannot be written before the whole message is known.
+  if (StdioFraming_ContentLength == m_eFraming) {
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mtxWrite);
+  if (m_bStreaming) {
+    LOG_ERROR("CStdioChannel::BeginStream: Stream already open");
+    return ERRNO_INTERNAL_ERROR;
+  }
+  m_bStreaming = true;
+
+  return ERRNO_OK;
+}
+
+int CStdioChannel::WriteStream(const std::string& data) {
+  if (!m_active) {
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mtxWrite);
+  if (!m_bStreaming) {
+    LOG_ERROR("CStdioChannel::WriteStream: No open stream");
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  return WriteRaw(data.data(), data.size());
+}
+
+int CStdioChannel::EndStream() {
+  std::lock_guard<std::mutex> lock(m_mtxWrite);
+  if (!m_bStreaming) {
+    LOG_ERROR("CStdioChannel::EndStream: No open stream");
+    return ERRNO_INTERNAL_ERROR;
+  }
+  m_bStreaming = false;
+
+  int iErrCode = WriteRaw("\n", 1);
+  if (ERRNO_OK == iErrCode && !m_vecDeferred.empty()) {
+    iErrCode = WriteFrames(m_vecDeferred.data(), m_vecDeferred.size());
+  }
+  m_vecDeferred.clear();
+
+  return iErrCode;
+}
+
+int CStdioChannel::WriteFrames(const std::string* pFrames, size_t nCount) {
+#ifdef _WIN32
+  for (size_t i = 0; i < nCount; ++i) {
+    const std::string& data = pFrames[i];
+    if (data.empty()) {
+      continue;
+    }
+    std::cout << data;
+    if (data.back() != '\n') {
+      std::cout << '\n';
+    }
+  }
+  std::cout.flush();
+  if (!std::cout) {
+    LOG_ERROR("CStdioChannel::Write: Failed to write output");
+    return ERRNO_INTERNAL_OUTPUT_ERROR;
+  }
+
   return ERRNO_OK;
+#else
+  static char s_newline = '\n';
+
+  bool bContentLength = StdioFraming_ContentLength == m_eFraming;
+  std::vector<std::string> vecHeaders;
+  std::vector<struct iovec> vecIov;
+  vecHeaders.reserve(bContentLength ? nCount : 0);
+  vecIov.reserve(nCount * 2);
+  for (size_t i = 0; i < nCount; ++i) {
+    const std::string& data = pFrames[i];
+    if (data.empty()) {
+      continue;
+    }
+    if (bContentLength) {
+      size_t nSize = data.back() == '\n' ? data.size() - 1 : data.size();
+      vecHeaders.push_back(
+        "Content-Length: " + std::to_string(nSize) + "\r\n\r\n");
+      vecIov.push_back({ const_cast<char*>(vecHeaders.back().data()),
+        vecHeaders.back().size() });
+      vecIov.push_back({ const_cast<char*>(data.data()), nSize });
+      continue;
+    }
+    vecIov.push_back({ const_cast<char*>(data.data()), data.size() });
+    if (data.back() != '\n') {
+      vecIov.push_back({ &s_newline, 1 });
+    }
+  }
+  if (vecIov.empty()) {
+    return ERRNO_OK;
+  }
+
+  int iErrCode = WriteVector(STDOUT_FILENO, vecIov);
+  if (ERRNO_OK != iErrCode) {
+    LOG_ERROR("CStdioChannel::Write: Failed to write output, error code: {}",
+      errno);
+  }
+
+  return iErrCode;
+#endif
+}
+
+int CStdioChannel::WriteRaw(const char* pData, size_t nSize) {
+#ifdef _WIN32
+  std::cout.write(pData, nSize);
+  std::cout.flush();
+  if (!std::cout) {
+    LOG_ERROR("CStdioChannel::WriteStream: Failed to write output");
+    return ERRNO_INTERNAL_OUTPUT_ERROR;
+  }
+
+  return ERRNO_OK;
+#else
+  std::vector<struct iovec> vecIov{ { const_cast<char*>(pData), nSize } };
+  int iErrCode = WriteVector(STDOUT_FILENO, vecIov);
+  if (ERRNO_OK != iErrCode) {
+    LOG_ERROR("CStdioChannel::WriteStream: Failed to write output, "
+      "error code: {}", errno);
+  }
+
+  return iErrCode;
+#endif
 }
 
 int CStdioChannel::Close() {
   m_active = false;
+#ifndef _WIN32
+  if (m_fdWakeWrite >= 0) {
+#if defined(__linux__)
+    uint64_t wake = 1;
+#else
+    char wake = 1;
+#endif
+    if (write(m_fdWakeWrite, &wake, sizeof(wake)) < 0 &&
+        errno != EAGAIN) {
+      LOG_WARNING("CStdioChannel::Close: Failed to wake reader, error code: {}",
+        errno);
+    }
+  }
+#endif
   return ERRNO_OK;
 }
 
@@ -118,6 +571,377 @@ std::string CStdioChannel::GetAttribute(const std::string& key) {
   return "";
 }
 
+static size_t SkipSpace(std::string_view text, size_t nPos) {
+  while (nPos < text.size() && (text[nPos] == ' ' || text[nPos] == '\t' ||
+                                 text[nPos] == '\r' || text[nPos] == '\n')) {
+    ++nPos;
+  }
+  return nPos;
+}
+
+// nPos is at an opening quote. Returns the position after the closing quote.
+static size_t SkipString(std::string_view text, size_t nPos) {
+  for (++nPos; nPos < text.size(); ++nPos) {
+    if (text[nPos] == '\\') {
+      ++nPos;
+    } else if (text[nPos] == '"') {
+      return nPos + 1;
+    }
+  }
+  return std::string_view::npos;
+}
+
+static size_t SkipValue(std::string_view text, size_t nPos) {
+  if (text[nPos] == '"') {
+    return SkipString(text, nPos);
+  }
+
+  if (text[nPos] == '{' || text[nPos] == '[') {
+    int nDepth = 0;
+    while (nPos < text.size()) {
+      char c = text[nPos];
+      if (c == '"') {
+        nPos = SkipString(text, nPos);
+        if (nPos == std::string_view::npos) {
+          return nPos;
+        }
+        continue;
+      }
+      if (c == '{' || c == '[') {
+        ++nDepth;
+      } else if ((c == '}' || c == ']') && --nDepth == 0) {
+        return nPos + 1;
+      }
+      ++nPos;
+    }
+    return std::string_view::npos;
+  }
+
+  while (nPos < text.size() && text[nPos] != ',' && text[nPos] != '}' &&
+         !std::isspace(static_cast<unsigned char>(text[nPos]))) {
+    ++nPos;
+  }
+  return nPos;
+}
+
+// Calls fnMember(key, value) with the raw text of each top-level member of a
+// JSON object until it returns false. Returns false when the text is not a
+// JSON object.
+template <class Fn>
+static bool ScanMembers(std::string_view object, Fn fnMember) {
+  size_t nPos = SkipSpace(object, 0);
+  if (nPos >= object.size() || object[nPos] != '{') {
+    return false;
+  }
+
+  nPos = SkipSpace(object, nPos + 1);
+  if (nPos < object.size() && object[nPos] == '}') {
+    return true;
+  }
+
+  while (nPos < object.size() && object[nPos] == '"') {
+    size_t nKeyEnd = SkipString(object, nPos);
+    if (nKeyEnd == std::string_view::npos) {
+      return false;
+    }
+    auto key = object.substr(nPos + 1, nKeyEnd - nPos - 2);
+
+    nPos = SkipSpace(object, nKeyEnd);
+    if (nPos >= object.size() || object[nPos] != ':') {
+      return false;
+    }
+    nPos = SkipSpace(object, nPos + 1);
+    if (nPos >= object.size()) {
+      return false;
+    }
+    size_t nValueEnd = SkipValue(object, nPos);
+    if (nValueEnd == std::string_view::npos || nValueEnd == nPos) {
+      return false;
+    }
+
+    if (!fnMember(key, object.substr(nPos, nValueEnd - nPos))) {
+      return true;
+    }
+
+    nPos = SkipSpace(object, nValueEnd);
+    if (nPos >= object.size()) {
+      return false;
+    }
+    if (object[nPos] == '}') {
+      return true;
+    }
+    if (object[nPos] != ',') {
+      return false;
+    }
+    nPos = SkipSpace(object, nPos + 1);
+  }
+
+  return false;
+}
+
+bool PeekMessageHead(std::string_view message, MessageHead& head) {
+  head = MessageHead();
+  return ScanMembers(message, [&head](std::string_view key,
+                                std::string_view value) {
+    if (key == "id") {
+      head.id = value;
+    } else if (key == "method") {
+      head.has_method = true;
+    } else if (key == "result" || key == "error") {
+      head.has_result = true;
+    }
+    return head.id.empty() || (!head.has_method && !head.has_result);
+  });
+}
+
+bool PeekMember(
+  std::string_view object, std::string_view key, std::string_view& value) {
+  value = std::string_view();
+  bool bObject = ScanMembers(object, [key, &value](std::string_view member,
+                                      std::string_view memberValue) {
+    if (member == key) {
+      value = memberValue;
+      return false;
+    }
+    return true;
+  });
+  return bObject && !value.empty();
+}
+
+void CHttpSessionTable::AddSession(const std::string& strSessionId) {
+  auto& shard = GetShard(strSessionId);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  shard.hashSessions.emplace(strSessionId, Session());
+}
+
+bool CHttpSessionTable::HasSession(const std::string& strSessionId) {
+  auto& shard = GetShard(strSessionId);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  return shard.hashSessions.find(strSessionId) != shard.hashSessions.end();
+}
+
+bool CHttpSessionTable::HasStream(const std::string& strSessionId) {
+  auto& shard = GetShard(strSessionId);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto itr = shard.hashSessions.find(strSessionId);
+  if (itr == shard.hashSessions.end() || !itr->second.spStream) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> streamLock(itr->second.spStream->mutex);
+  return !itr->second.spStream->closed;
+}
+
+void CHttpSessionTable::RemoveSession(const std::string& strSessionId) {
+  auto& shard = GetShard(strSessionId);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto itr = shard.hashSessions.find(strSessionId);
+  if (itr == shard.hashSessions.end()) {
+    return;
+  }
+
+  auto& spStream = itr->second.spStream;
+  if (spStream) {
+    std::lock_guard<std::mutex> streamLock(spStream->mutex);
+    spStream->closed = true;
+    spStream->cond.notify_all();
+  }
+  shard.hashSessions.erase(itr);
+}
+
+std::shared_ptr<SseStream> CHttpSessionTable::OpenStream(
+  const std::string& strSessionId) {
+  auto& shard = GetShard(strSessionId);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto itr = shard.hashSessions.find(strSessionId);
+  if (itr == shard.hashSessions.end()) {
+    return nullptr;
+  }
+
+  auto& spStream = itr->second.spStream;
+  if (spStream) {
+    std::lock_guard<std::mutex> streamLock(spStream->mutex);
+    spStream->closed = true;
+    spStream->cond.notify_all();
+  }
+  spStream = std::make_shared<SseStream>();
+  return spStream;
+}
+
+void CHttpSessionTable::CloseStream(const std::string& strSessionId,
+  const std::shared_ptr<SseStream>& spStream) {
+  auto& shard = GetShard(strSessionId);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto itr = shard.hashSessions.find(strSessionId);
+  if (itr != shard.hashSessions.end() && itr->second.spStream == spStream) {
+    itr->second.spStream.reset();
+  }
+
+  std::lock_guard<std::mutex> streamLock(spStream->mutex);
+  spStream->closed = true;
+  spStream->cond.notify_all();
+}
+
+bool CHttpSessionTable::Send(
+  const std::string& strSessionId, const std::string& strMessage) {
+  auto& shard = GetShard(strSessionId);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto itr = shard.hashSessions.find(strSessionId);
+  if (itr == shard.hashSessions.end() || !itr->second.spStream) {
+    return false;
+  }
+
+  auto& spStream = itr->second.spStream;
+  std::lock_guard<std::mutex> streamLock(spStream->mutex);
+  if (spStream->closed) {
+    return false;
+  }
+  spStream->events.push_back(FormatEvent(strMessage));
+  spStream->cond.notify_all();
+  return true;
+}
+
+void CHttpSessionTable::BeginRequest(
+  const std::shared_ptr<ConnectionContext>& spContext) {
+  auto& shard = GetShard(spContext->session_id);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto itr = shard.hashSessions.find(spContext->session_id);
+  if (itr == shard.hashSessions.end()) {
+    return;
+  }
+
+  itr->second.hashRequests[spContext->request_id] = spContext;
+  if (!spContext->progress_token.empty()) {
+    itr->second.hashProgress[spContext->progress_token] = spContext;
+  }
+}
+
+void CHttpSessionTable::EndRequest(
+  const std::shared_ptr<ConnectionContext>& spContext) {
+  auto& shard = GetShard(spContext->session_id);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto itr = shard.hashSessions.find(spContext->session_id);
+  if (itr == shard.hashSessions.end()) {
+    return;
+  }
+
+  // A later POST may have reused the id or token.
+  auto fnErase = [&spContext](auto& hashRequests, const std::string& key) {
+    auto itrRequest = hashRequests.find(key);
+    if (itrRequest != hashRequests.end()) {
+      auto spCurrent = itrRequest->second.lock();
+      if (!spCurrent || spCurrent == spContext) {
+        hashRequests.erase(itrRequest);
+      }
+    }
+  };
+  fnErase(itr->second.hashRequests, spContext->request_id);
+  if (!spContext->progress_token.empty()) {
+    fnErase(itr->second.hashProgress, spContext->progress_token);
+  }
+}
+
+std::shared_ptr<ConnectionContext> CHttpSessionTable::FindRequest(
+  const std::string& strSessionId, std::string_view id) {
+  auto& shard = GetShard(strSessionId);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto itr = shard.hashSessions.find(strSessionId);
+  if (itr == shard.hashSessions.end()) {
+    return nullptr;
+  }
+
+  auto itrRequest = itr->second.hashRequests.find(std::string(id));
+  if (itrRequest == itr->second.hashRequests.end()) {
+    return nullptr;
+  }
+  return itrRequest->second.lock();
+}
+
+std::shared_ptr<ConnectionContext> CHttpSessionTable::FindProgress(
+  const std::string& strSessionId, std::string_view token) {
+  auto& shard = GetShard(strSessionId);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto itr = shard.hashSessions.find(strSessionId);
+  if (itr == shard.hashSessions.end()) {
+    return nullptr;
+  }
+
+  auto itrRequest = itr->second.hashProgress.find(std::string(token));
+  if (itrRequest == itr->second.hashProgress.end()) {
+    return nullptr;
+  }
+  return itrRequest->second.lock();
+}
+
+void CHttpSessionTable::CloseStreams() {
+  for (auto& shard : m_arrShards) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (auto& item : shard.hashSessions) {
+      auto& spStream = item.second.spStream;
+      if (spStream) {
+        std::lock_guard<std::mutex> streamLock(spStream->mutex);
+        spStream->closed = true;
+        spStream->cond.notify_all();
+      }
+      spStream.reset();
+    }
+  }
+}
+
+void CHttpSessionTable::CloseAll() {
+  CloseStreams();
+  std::vector<std::shared_ptr<ConnectionContext>> vecWaiting;
+  for (auto& shard : m_arrShards) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (auto& item : shard.hashSessions) {
+      for (auto& request : item.second.hashRequests) {
+        auto spContext = request.second.lock();
+        if (spContext) {
+          vecWaiting.push_back(std::move(spContext));
+        }
+      }
+    }
+    shard.hashSessions.clear();
+  }
+
+  // POSTs still waiting for their response are answered as stopped.
+  for (auto& spContext : vecWaiting) {
+    std::lock_guard<std::mutex> lock(spContext->mutex);
+    spContext->stream_aborted = true;
+    spContext->response_cond.notify_all();
+  }
+}
+
+CHttpSessionTable::Shard& CHttpSessionTable::GetShard(
+  std::string_view strSessionId) {
+  return m_arrShards[GetSessionShard(strSessionId)];
+}
+
+std::string CHttpSessionTable::FormatEvent(const std::string& strMessage) {
+  std::string strEvent = "event: message\n";
+  strEvent.reserve(strMessage.size() + 32);
+
+  // Every line of the message becomes a data field.
+  size_t nBegin = 0;
+  size_t nEnd = strMessage.size();
+  while (nEnd > 0 &&
+         (strMessage[nEnd - 1] == '\n' || strMessage[nEnd - 1] == '\r')) {
+    --nEnd;
+  }
+  while (nBegin <= nEnd) {
+    size_t nNewline = strMessage.find('\n', nBegin);
+    if (nNewline == std::string::npos || nNewline > nEnd) {
+      nNewline = nEnd;
+    }
+    strEvent.append("data: ");
+    strEvent.append(strMessage, nBegin, nNewline - nBegin);
+    strEvent.push_back('\n');
+    nBegin = nNewline + 1;
+  }
+  strEvent.push_back('\n');
+  return strEvent;
+}
+
 CHttpChannel::CHttpChannel(std::shared_ptr<ConnectionContext> context)
   : m_context(context) {}
 
@@ -130,11 +954,15 @@ int CHttpChannel::Read(std::string& data) {
   std::unique_lock<std::mutex> lock(m_context->mutex);
 
   if (!m_context->has_request) {
-    LOG_ERROR("CHttpChannel::Read: No request available");
+    // The session is done with the body; a POST without a request can now
+    // be acknowledged.
+    m_context->request_processed = true;
+    m_context->response_cond.notify_all();
+    LOG_TRACE("CHttpChannel::Read: Request body consumed");
     return ERRNO_INTERNAL_ERROR;
   }
 
-  data = m_context->request_body;
+  data.swap(m_context->request_body);
   m_context->request_body.clear();
   m_context->has_request = false;
 
@@ -143,18 +971,127 @@ int CHttpChannel::Read(std::string& data) {
 }
 
 int CHttpChannel::Write(const std::string& data) {
+  return WriteEmbedded(data, EmbeddedText());
+}
+
+int CHttpChannel::WriteEmbedded(
+  const std::string& data, const EmbeddedText& embedded) {
   if (!m_context) {
     LOG_ERROR("CHttpChannel::Write: Invalid context");
     return ERRNO_INTERNAL_ERROR;
   }
 
+  // Nothing to deliver, e.g. for a notification that needs no answer.
+  if (data.empty()) {
+    return ERRNO_OK;
+  }
+
+  std::string strSessionId;
+  {
+    std::lock_guard<std::mutex> lock(m_context->mutex);
+    strSessionId = m_context->session_id;
+  }
+
+  // The session writes on the channel of its latest POST, which need not be
+  // the one that carried the request being answered.
+  auto spTarget = m_context;
+  bool bFinal = false;
+  MessageHead head;
+  if (PeekMessageHead(data, head) && m_context->sessions) {
+    if (head.has_result && !head.id.empty()) {
+      if (head.id != m_context->request_id) {
+        spTarget = m_context->sessions->FindRequest(strSessionId, head.id);
+      }
+      bFinal = true;
+    } else if (!head.has_result && head.id.empty()) {
+      std::string_view params;
+      std::string_view token;
+      if (PeekMember(data, "params", params) &&
+          PeekMember(params, "progressToken", token) &&
+          token != m_context->progress_token) {
+        auto spOwner = m_context->sessions->FindProgress(strSessionId, token);
+        if (spOwner) {
+          spTarget = spOwner;
+        }
+      }
+    }
+  }
+
+  if (!spTarget) {
+    // A response to a POST that is already answered or gone.
+    SendToStream(*m_context->sessions, strSessionId, data);
+    return ERRNO_OK;
+  }
+
+  Deliver(*spTarget, data, bFinal, embedded);
+  return ERRNO_OK;
+}
+
+int CHttpChannel::BeginStream() {
+  if (!m_context) {
+    LOG_ERROR("CHttpChannel::BeginStream: Invalid context");
+    return ERRNO_INTERNAL_ERROR;
+  }
+
   std::lock_guard<std::mutex> lock(m_context->mutex);
 
-  m_context->response_body = data;
-  m_context->has_response = true;
-  m_context->response_cond.notify_one();
+  // The chunked body must be the whole POST response.
+  if (m_context->response_mode != ResponseMode_Pending ||
+      !m_context->response_messages.empty() || m_context->response_closed ||
+      m_context->request_id.empty()) {
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  m_context->response_mode = ResponseMode_Chunked;
+  m_context->response_cond.notify_all();
 
-  LOG_TRACE("CHttpChannel::Write: Data sent, size: {}", data.size());
+  LOG_TRACE("CHttpChannel::BeginStream: Chunked response started");
+  return ERRNO_OK;
+}
+
+int CHttpChannel::WriteStream(const std::string& data) {
+  if (!m_context) {
+    LOG_ERROR("CHttpChannel::WriteStream: Invalid context");
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  std::unique_lock<std::mutex> lock(m_context->mutex);
+  if (m_context->response_mode != ResponseMode_Chunked ||
+      m_context->stream_done) {
+    LOG_ERROR("CHttpChannel::WriteStream: No open stream");
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  m_context->response_cond.wait(lock, [this]() {
+    return m_context->response_chunks.size() < MAX_PENDING_CHUNKS ||
+           m_context->stream_aborted;
+  });
+  if (m_context->stream_aborted) {
+    LOG_ERROR("CHttpChannel::WriteStream: Stream aborted by peer");
+    return ERRNO_INTERNAL_OUTPUT_ERROR;
+  }
+
+  m_context->response_chunks.push_back(data);
+  m_context->response_cond.notify_all();
+
+  return ERRNO_OK;
+}
+
+int CHttpChannel::EndStream() {
+  if (!m_context) {
+    LOG_ERROR("CHttpChannel::EndStream: Invalid context");
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  std::lock_guard<std::mutex> lock(m_context->mutex);
+  if (m_context->response_mode != ResponseMode_Chunked) {
+    LOG_ERROR("CHttpChannel::EndStream: No open stream");
+    return ERRNO_INTERNAL_ERROR;
+  }
+  m_context->stream_done = true;
+  m_context->response_cond.notify_all();
+
+  LOG_TRACE("CHttpChannel::EndStream: Chunked response finished");
   return ERRNO_OK;
 }
 
@@ -164,7 +1101,8 @@ int CHttpChannel::Close() {
   }
 
   std::lock_guard<std::mutex> lock(m_context->mutex);
-  m_context->response_cond.notify_one();
+  m_context->stream_aborted = true;
+  m_context->response_cond.notify_all();
 
   return ERRNO_OK;
 }
@@ -185,7 +1123,20 @@ int CHttpChannel::SetAttribute(
   }
 
   std::lock_guard<std::mutex> lock(m_context->mutex);
-  m_context->response_header[key] = value;
+  auto itr = std::find_if(m_context->response_header.begin(),
+    m_context->response_header.end(),
+    [&key](const auto& header) { return header.first == key; });
+  if (itr != m_context->response_header.end()) {
+    itr->second = value;
+  } else {
+    m_context->response_header.emplace_back(key, value);
+  }
+  if (key == HEADER_SESSION_ID) {
+    m_context->session_id = value;
+    if (m_context->sessions) {
+      m_context->sessions->AddSession(value);
+    }
+  }
 
   LOG_TRACE("CHttpChannel::SetAttribute: Set header: {} = {}", key, value);
   return ERRNO_OK;
@@ -198,16 +1149,56 @@ std::string CHttpChannel::GetAttribute(const std::string& key) {
   }
 
   std::lock_guard<std::mutex> lock(m_context->mutex);
-  auto it = m_context->request_header.find(key);
-  if (it != m_context->request_header.end()) {
-    LOG_TRACE(
-      "CHttpChannel::GetAttribute: Get header: {} = {}", key, it->second);
-    return it->second;
+  if (key == HEADER_SESSION_ID && !m_context->session_id.empty()) {
+    LOG_TRACE("CHttpChannel::GetAttribute: Get header: {} = {}", key,
+      m_context->session_id);
+    return m_context->session_id;
   }
 
   LOG_TRACE("CHttpChannel::GetAttribute: Header not found: {}", key);
   return "";
 }
 
+void CHttpChannel::Deliver(ConnectionContext& context,
+  const std::string& data, bool bFinal, const EmbeddedText& embedded) {
+  std::unique_lock<std::mutex> lock(context.mutex);
+
+  // Only an event stream can carry messages ahead of the response.
+  bool bOnPost = !context.request_id.empty() && !context.has_response &&
+                 !context.response_closed && !context.stream_aborted &&
+                 context.response_mode != ResponseMode_Chunked &&
+                 (bFinal || context.accepts_sse);
+  if (bOnPost) {
+    context.response_messages.push_back(data);
+    if (bFinal) {
+      context.has_response = true;
+      context.response_text = embedded;
+    }
+    context.response_cond.notify_all();
+    LOG_TRACE("CHttpChannel::Write: Data sent, size: {}", data.size());
+    return;
+  }
+
+  std::string strSessionId = context.session_id;
+  auto spSessions = context.sessions;
+  lock.unlock();
+  if (spSessions) {
+    SendToStream(*spSessions, strSessionId, data);
+  }
+}
+
+void CHttpChannel::SendToStream(CHttpSessionTable& sessions,
+  const std::string& strSessionId, const std::string& data) {
+  if (strSessionId.empty() || !sessions.Send(strSessionId, data)) {
+    LOG_WARNING("CHttpChannel: No event stream open for session '{}', "
+                "message dropped, size: {}",
+      strSessionId, data.size());
+    return;
+  }
+
+  LOG_TRACE("CHttpChannel: Message sent on the event stream, size: {}",
+    data.size());
+}
+
 }  // namespace MCP
 
@@ -1,10 +1,20 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <condition_variable>
-#include <map>
+#include <deque>
+#include <utility>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "../Public/Compression.h"
+#include "../Public/PublicDef.h"
+#include "../Public/SessionId.h"
 
 namespace MCP {
 
@@ -19,31 +29,254 @@ public:
   virtual int SetAttribute(
     const std::string& key, const std::string& value) = 0;
   virtual std::string GetAttribute(const std::string& key) = 0;
+
+  // A dispatched channel that stays open for more messages once Read() has
+  // none waiting, which it reports with ERRNO_INTERNAL_INPUT_PENDING.
+  virtual bool IsPersistent() {
+    return false;
+  }
+
+  // Writes several complete messages. Channels that can deliver them with a
+  // single operation override this.
+  virtual int WriteBatch(const std::vector<std::string>& vecData) {
+    for (const auto& data : vecData) {
+      int iErrCode = Write(data);
+      if (ERRNO_OK != iErrCode) {
+        return iErrCode;
+      }
+    }
+    return ERRNO_OK;
+  }
+
+  // Writes a message that embeds a shared text, so channels that compress
+  // can reuse the cached deflate data of the text.
+  virtual int WriteEmbedded(
+    const std::string& data, const EmbeddedText& embedded) {
+    return Write(data);
+  }
+
+  // Writes one message in pieces: BeginStream, any number of WriteStream
+  // calls, then EndStream. Channels that cannot stream fail BeginStream and
+  // the caller falls back to a single Write.
+  virtual int BeginStream() {
+    return ERRNO_INTERNAL_ERROR;
+  }
+  virtual int WriteStream(const std::string& data) {
+    return ERRNO_INTERNAL_ERROR;
+  }
+  virtual int EndStream() {
+    return ERRNO_INTERNAL_ERROR;
+  }
+};
+
+// How messages are delimited on stdio. Auto looks at the first bytes from the
+// peer: a header selects Content-Length framing (as used by LSP), anything
+// else newline-delimited JSON. Replies use the same framing as the peer.
+enum StdioFraming {
+  StdioFraming_Auto,
+  StdioFraming_Newline,
+  StdioFraming_ContentLength,
 };
 
 class CStdioChannel : public IChannel {
 public:
-  CStdioChannel();
-  ~CStdioChannel() override = default;
+  static constexpr size_t DEFAULT_MAX_FRAME_SIZE = 64 * 1024 * 1024;
 
+  explicit CStdioChannel(StdioFraming eFraming = StdioFraming_Auto,
+    size_t nMaxFrameSize = DEFAULT_MAX_FRAME_SIZE);
+  ~CStdioChannel() override;
+  CStdioChannel(const CStdioChannel&) = delete;
+  CStdioChannel& operator=(const CStdioChannel&) = delete;
+
+  // Returns the next frame without its delimiter or headers. The view stays
+  // valid until the next read from this channel. The Windows build reads
+  // newline-delimited frames only.
+  int ReadFrame(std::string_view& frame);
   int Read(std::string& data) override;
   int Write(const std::string& data) override;
   int Close() override;
   bool IsActive() override;
   int SetAttribute(const std::string& key, const std::string& value) override;
   std::string GetAttribute(const std::string& key) override;
+  int WriteBatch(const std::vector<std::string>& vecData) override;
+  int BeginStream() override;
+  int WriteStream(const std::string& data) override;
+  int EndStream() override;
+
+private:
+  static constexpr size_t READ_BUFFER_SIZE = 64 * 1024;
+  static constexpr size_t MAX_HEADER_SIZE = 8 * 1024;
+  static constexpr size_t NO_BODY = static_cast<size_t>(-1);
+
+#ifndef _WIN32
+  void DetectFraming();
+  bool ExtractLineFrame(std::string_view& frame);
+  bool ExtractContentLengthFrame(std::string_view& frame);
+#endif
+
+  // Writes the frames with as few syscalls as possible; a newline is added to
+  // frames that do not already end with one. Called with m_mtxWrite held.
+  int WriteFrames(const std::string* pFrames, size_t nCount);
+  int WriteRaw(const char* pData, size_t nSize);
+
+  std::atomic<bool> m_active;
+  std::atomic<StdioFraming> m_eFraming{ StdioFraming_Auto };
+#ifndef _WIN32
+  // Read blocks until stdin is readable or Close() signals this descriptor
+  // (an eventfd on Linux, the write end of a pipe elsewhere).
+  int m_fdWakeRead{ -1 };
+  int m_fdWakeWrite{ -1 };
+#endif
+  // Input is read from the stdin descriptor into one reusable buffer; frames
+  // are [m_nBegin, newline) and m_nScan marks how far newlines were searched.
+  std::vector<char> m_vecReadBuffer;
+  size_t m_nBegin{ 0 };
+  size_t m_nScan{ 0 };
+  size_t m_nEnd{ 0 };
+  size_t m_nMaxFrameSize{ DEFAULT_MAX_FRAME_SIZE };
+  bool m_bDiscarding{ false };
+  bool m_bEof{ false };
+  // Content-Length framing: the length parsed from the current header block,
+  // the body size once the headers are complete, and bytes left to skip of
+  // an oversized body.
+  size_t m_nHeaderLength{ NO_BODY };
+  size_t m_nBodySize{ NO_BODY };
+  size_t m_nDiscardBytes{ 0 };
+  // A header block over MAX_HEADER_SIZE; the channel is closed on it.
+  bool m_bFramingError{ false };
+  // Serializes writes to stdout; messages written while a stream is open are
+  // deferred until it ends so they cannot land inside the streamed message.
+  std::mutex m_mtxWrite;
+  bool m_bStreaming{ false };
+  std::vector<std::string> m_vecDeferred;
+};
+
+// The parts of a JSON-RPC message the HTTP transport routes on. id holds the
+// raw JSON text of the "id" member and is empty when there is none.
+struct MessageHead {
+  std::string_view id;
+  bool has_method = false;
+  bool has_result = false;
+};
+
+// Scans the top-level members of a JSON object without parsing their values,
+// stopping once the message kind is known. Returns false when the text is not
+// a JSON object.
+bool PeekMessageHead(std::string_view message, MessageHead& head);
+
+// Finds the raw JSON text of a top-level member of an object. Returns false
+// when the member is missing or the text is not a JSON object.
+bool PeekMember(
+  std::string_view object, std::string_view key, std::string_view& value);
+
+// One open GET stream of a session. Events are queued here and written by the
+// HTTP worker serving the stream.
+struct SseStream {
+  std::deque<std::string> events;
+  bool closed = false;
+  std::mutex mutex;
+  std::condition_variable cond;
+};
+
+struct ConnectionContext;
+
+// Per-session state of the HTTP transport, known from the moment the
+// initialize response assigns the session id. A session can have several
+// POSTs in flight: their responses and progress notifications are routed to
+// the POST that carried the request, whichever channel the session writes
+// them on. Messages that belong to no open POST go to the session's GET
+// stream, of which there is at most one.
+class CHttpSessionTable {
+public:
+  void AddSession(const std::string& strSessionId);
+  bool HasSession(const std::string& strSessionId);
+  // True while a GET stream of the session is open.
+  bool HasStream(const std::string& strSessionId);
+  // Closes the session's stream and forgets its requests.
+  void RemoveSession(const std::string& strSessionId);
+  // Replaces the session's current stream. Returns nullptr for unknown ids.
+  std::shared_ptr<SseStream> OpenStream(const std::string& strSessionId);
+  void CloseStream(const std::string& strSessionId,
+    const std::shared_ptr<SseStream>& spStream);
+  // Returns false when the session has no open stream.
+  bool Send(const std::string& strSessionId, const std::string& strMessage);
+
+  // A POST of the session waits for the response to its request.
+  void BeginRequest(const std::shared_ptr<ConnectionContext>& spContext);
+  void EndRequest(const std::shared_ptr<ConnectionContext>& spContext);
+  // The POST waiting for the request with the raw id, or progress token.
+  std::shared_ptr<ConnectionContext> FindRequest(
+    const std::string& strSessionId, std::string_view id);
+  std::shared_ptr<ConnectionContext> FindProgress(
+    const std::string& strSessionId, std::string_view token);
+
+  // Ends the open streams; the sessions are kept.
+  void CloseStreams();
+  // Also wakes the POSTs waiting for a response, and forgets the sessions.
+  void CloseAll();
+
+  // Formats a message as one "message" event.
+  static std::string FormatEvent(const std::string& strMessage);
 
 private:
-  bool m_active;
+  struct Session {
+    std::shared_ptr<SseStream> spStream;
+    std::unordered_map<std::string, std::weak_ptr<ConnectionContext>>
+      hashRequests;
+    std::unordered_map<std::string, std::weak_ptr<ConnectionContext>>
+      hashProgress;
+  };
+
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_map<std::string, Session> hashSessions;
+  };
+
+  Shard& GetShard(std::string_view strSessionId);
+
+  // Split like the server's session table, by the shard in the id.
+  std::array<Shard, SESSION_SHARD_COUNT> m_arrShards;
+};
+
+enum ResponseMode {
+  ResponseMode_Pending,
+  // A single application/json body.
+  ResponseMode_Json,
+  // A text/event-stream that ends with the response to the request.
+  ResponseMode_Sse,
+  // The response written in pieces as a chunked application/json body.
+  ResponseMode_Chunked,
 };
 
 struct ConnectionContext {
   std::string request_body;
-  std::string response_body;
-  std::map<std::string, std::string> request_header;
-  std::map<std::string, std::string> response_header;
+  // Attributes set by the session, sent as response headers.
+  std::vector<std::pair<std::string, std::string>> response_header;
   bool has_request = false;
+  // Raw id of the request in the body; empty when the POST only carries
+  // notifications or responses.
+  std::string request_id;
+  // Raw params._meta.progressToken of the request, if any.
+  std::string progress_token;
+  // The only request header the session reads, taken when the POST arrives.
+  std::string session_id;
+  bool accepts_sse = false;
+  // Set once the session asked for the next message after the body.
+  bool request_processed = false;
+  ResponseMode response_mode = ResponseMode_Pending;
+  // Messages for the POST response, in order; has_response is set once the
+  // response to request_id is among them.
+  std::deque<std::string> response_messages;
   bool has_response = false;
+  // Shared text inside the response, passed on to compression.
+  EmbeddedText response_text;
+  // The POST has been answered; later messages go to the GET stream.
+  bool response_closed = false;
+  // Chunked response body, used when the message is written as a stream.
+  std::deque<std::string> response_chunks;
+  bool stream_done = false;
+  bool stream_aborted = false;
+  std::shared_ptr<CHttpSessionTable> sessions;
   std::mutex mutex;
   std::condition_variable response_cond;
 };
@@ -55,12 +288,27 @@ public:
 
   int Read(std::string& data) override;
   int Write(const std::string& data) override;
+  int WriteEmbedded(
+    const std::string& data, const EmbeddedText& embedded) override;
   int Close() override;
   bool IsActive() override;
   int SetAttribute(const std::string& key, const std::string& value) override;
   std::string GetAttribute(const std::string& key) override;
+  int BeginStream() override;
+  int WriteStream(const std::string& data) override;
+  int EndStream() override;
+
+  // Producers block once this many chunks wait for the HTTP worker.
+  static constexpr size_t MAX_PENDING_CHUNKS = 16;
 
 private:
+  // Queues a message on the POST of the context, or hands it to the
+  // session's GET stream when it cannot go there.
+  static void Deliver(ConnectionContext& context, const std::string& data,
+    bool bFinal, const EmbeddedText& embedded);
+  static void SendToStream(CHttpSessionTable& sessions,
+    const std::string& strSessionId, const std::string& data);
+
   std::shared_ptr<ConnectionContext> m_context;
 };
 
@@ -0,0 +1,273 @@
+#include "IoEngine.h"
+
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+#include "../Public/Logger.h"
+#include "../Public/PublicDef.h"
+#include "IoUringEngine.h"
+
+namespace MCP {
+
+static constexpr uint32_t CONNECTION_EVENTS = EPOLLIN | EPOLLRDHUP | EPOLLET;
+
+std::shared_ptr<CIoEngine> CIoEngine::Create() {
+#if defined(TINYMCP_IO_URING)
+  auto spUring = std::make_shared<CIoUringEngine>();
+  if (ERRNO_OK == spUring->Initialize()) {
+    return spUring;
+  }
+  LOG_WARNING("CIoEngine: io_uring is not available, falling back to epoll");
+#endif
+  return std::make_shared<CEpollEngine>();
+}
+
+bool CIoEngine::IsAcceptResourceError(int iError) {
+  return iError == EMFILE || iError == ENFILE || iError == ENOBUFS ||
+    iError == ENOMEM;
+}
+
+CEpollEngine::~CEpollEngine() {
+  for (int fd : { m_fdEpoll, m_fdWake }) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+const char* CEpollEngine::GetName() const {
+  return "epoll";
+}
+
+int CEpollEngine::Open(int fdListen) {
+  m_fdListen = fdListen;
+  m_fdEpoll = epoll_create1(EPOLL_CLOEXEC);
+  m_fdWake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (m_fdEpoll < 0 || m_fdWake < 0) {
+    LOG_ERROR("CEpollEngine::Open: Failed to create epoll, error code: {}",
+      errno);
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  for (int fd : { m_fdListen, m_fdWake }) {
+    struct epoll_event event {};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(m_fdEpoll, EPOLL_CTL_ADD, fd, &event) < 0) {
+      LOG_ERROR("CEpollEngine::Open: epoll_ctl failed, error code: {}", errno);
+      return ERRNO_INTERNAL_ERROR;
+    }
+  }
+
+  m_vecScratch.resize(READ_SCRATCH_SIZE);
+  m_running = true;
+  return ERRNO_OK;
+}
+
+int CEpollEngine::AddConnection(int fd) {
+  struct epoll_event event {};
+  event.events = CONNECTION_EVENTS;
+  event.data.fd = fd;
+  if (epoll_ctl(m_fdEpoll, EPOLL_CTL_ADD, fd, &event) < 0) {
+    LOG_ERROR("CEpollEngine: epoll_ctl failed, error code: {}", errno);
+    return ERRNO_INTERNAL_ERROR;
+  }
+  return ERRNO_OK;
+}
+
+void CEpollEngine::RemoveConnection(int fd) {
+  epoll_ctl(m_fdEpoll, EPOLL_CTL_DEL, fd, nullptr);
+  m_setPaused.erase(fd);
+  if (m_bAcceptPaused) {
+    // A descriptor is about to be freed.
+    std::lock_guard<std::mutex> lock(m_mtxAccept);
+    ResumeAccepting();
+  }
+}
+
+void CEpollEngine::Resume(int fd) {
+  // Handled on the engine thread so it cannot overtake the pause.
+  {
+    std::lock_guard<std::mutex> lock(m_mtxResume);
+    m_vecResume.push_back(fd);
+  }
+  uint64_t wake = 1;
+  if (write(m_fdWake, &wake, sizeof(wake)) < 0 && errno != EAGAIN) {
+    LOG_WARNING("CEpollEngine::Resume: Failed to wake the loop");
+  }
+}
+
+void CEpollEngine::Run(IIoHandler& handler) {
+  std::vector<struct epoll_event> vecEvents(256);
+  while (m_running) {
+    int iTimeout = m_bAcceptPaused
+      ? static_cast<int>(ACCEPT_RETRY_DELAY.count()) : -1;
+    int nEvents = epoll_wait(m_fdEpoll, vecEvents.data(),
+      static_cast<int>(vecEvents.size()), iTimeout);
+    if (nEvents < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG_ERROR("CEpollEngine: epoll_wait failed, error code: {}", errno);
+      break;
+    }
+
+    for (int i = 0; i < nEvents && m_running; ++i) {
+      int fd = vecEvents[i].data.fd;
+      if (fd == m_fdWake) {
+        uint64_t value = 0;
+        if (read(m_fdWake, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+          LOG_WARNING("CEpollEngine: Failed to read the wake descriptor");
+        }
+        continue;
+      }
+      if (fd == m_fdListen) {
+        AcceptConnections(handler);
+        continue;
+      }
+      // Hang ups of a paused connection are seen once it is resumed.
+      if (!m_setPaused.empty() && m_setPaused.count(fd) > 0) {
+        continue;
+      }
+      if (!ReadConnection(fd, handler)) {
+        handler.OnClosed(fd);
+      }
+    }
+
+    ResumeConnections();
+    if (m_bAcceptPaused &&
+        std::chrono::steady_clock::now() >= m_tpAcceptRetry) {
+      std::lock_guard<std::mutex> lock(m_mtxAccept);
+      ResumeAccepting();
+    }
+  }
+}
+
+void CEpollEngine::Shutdown() {
+  m_running = false;
+  if (m_fdWake >= 0) {
+    uint64_t wake = 1;
+    if (write(m_fdWake, &wake, sizeof(wake)) < 0 && errno != EAGAIN) {
+      LOG_WARNING("CEpollEngine::Shutdown: Failed to wake the loop");
+    }
+  }
+}
+
+void CEpollEngine::StopAccepting() {
+  m_bAccepting = false;
+  std::lock_guard<std::mutex> lock(m_mtxAccept);
+  if (m_fdEpoll >= 0 && m_fdListen >= 0) {
+    epoll_ctl(m_fdEpoll, EPOLL_CTL_DEL, m_fdListen, nullptr);
+  }
+}
+
+void CEpollEngine::AcceptConnections(IIoHandler& handler) {
+  std::lock_guard<std::mutex> lock(m_mtxAccept);
+  while (m_bAccepting) {
+    int fd =
+      accept4(m_fdListen, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      if (IsAcceptResourceError(errno)) {
+        // The listening socket stays readable, so retrying at once would
+        // spin until a descriptor is freed.
+        LOG_ERROR("CEpollEngine: accept failed, error code: {}, pausing",
+          errno);
+        PauseAccepting();
+      } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        LOG_ERROR("CEpollEngine: accept failed, error code: {}", errno);
+      }
+      return;
+    }
+    handler.OnAccepted(fd);
+  }
+}
+
+void CEpollEngine::PauseAccepting() {
+  epoll_ctl(m_fdEpoll, EPOLL_CTL_DEL, m_fdListen, nullptr);
+  m_bAcceptPaused = true;
+  m_tpAcceptRetry = std::chrono::steady_clock::now() + ACCEPT_RETRY_DELAY;
+}
+
+void CEpollEngine::ResumeAccepting() {
+  if (!m_bAcceptPaused) {
+    return;
+  }
+  m_bAcceptPaused = false;
+  if (!m_bAccepting) {
+    return;
+  }
+
+  struct epoll_event event {};
+  event.events = EPOLLIN;
+  event.data.fd = m_fdListen;
+  if (epoll_ctl(m_fdEpoll, EPOLL_CTL_ADD, m_fdListen, &event) < 0) {
+    LOG_ERROR("CEpollEngine: epoll_ctl failed, error code: {}", errno);
+  }
+}
+
+bool CEpollEngine::ReadConnection(int fd, IIoHandler& handler) {
+  while (true) {
+    ssize_t nRead = recv(fd, m_vecScratch.data(), m_vecScratch.size(), 0);
+    if (nRead > 0) {
+      if (!handler.OnReceived(fd, m_vecScratch.data(), nRead)) {
+        // Stop reading until Resume(); the socket buffer then pushes back on
+        // the peer.
+        struct epoll_event event {};
+        event.events = EPOLLET;
+        event.data.fd = fd;
+        if (epoll_ctl(m_fdEpoll, EPOLL_CTL_MOD, fd, &event) < 0) {
+          LOG_WARNING("CEpollEngine: epoll_ctl failed, error code: {}",
+            errno);
+        }
+        m_setPaused.insert(fd);
+        return true;
+      }
+      continue;
+    }
+    if (nRead < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return true;
+      }
+      LOG_INFO("CEpollEngine: recv on fd {} failed, error code: {}", fd,
+        errno);
+    }
+    return false;
+  }
+}
+
+void CEpollEngine::ResumeConnections() {
+  std::vector<int> vecResume;
+  {
+    std::lock_guard<std::mutex> lock(m_mtxResume);
+    vecResume.swap(m_vecResume);
+  }
+
+  for (int fd : vecResume) {
+    if (m_setPaused.erase(fd) == 0) {
+      continue;
+    }
+    // Modifying an edge-triggered registration reports the socket again if
+    // input is already waiting.
+    struct epoll_event event {};
+    event.events = CONNECTION_EVENTS;
+    event.data.fd = fd;
+    if (epoll_ctl(m_fdEpoll, EPOLL_CTL_MOD, fd, &event) < 0 &&
+        errno != ENOENT && errno != EBADF) {
+      LOG_WARNING("CEpollEngine::Resume: epoll_ctl failed, error code: {}",
+        errno);
+    }
+  }
+}
+
+}  // namespace MCP
+#endif
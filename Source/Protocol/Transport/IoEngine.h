@@ -0,0 +1,116 @@
+#pragma once
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+namespace MCP {
+
+// Receives the events of an I/O engine. All calls are made on the thread
+// running CIoEngine::Run().
+class IIoHandler {
+public:
+  virtual ~IIoHandler() = default;
+
+  // A connection was accepted on the listening socket.
+  virtual void OnAccepted(int fd) = 0;
+  // Bytes arrived on a connection. The data is only valid during the call.
+  // Returning false asks the engine to stop reading the connection until
+  // CIoEngine::Resume() is called.
+  virtual bool OnReceived(int fd, const char* pData, size_t nSize) = 0;
+  // The peer closed the connection or reading it failed.
+  virtual void OnClosed(int fd) = 0;
+};
+
+// The event loop behind the socket transports. It accepts connections on one
+// listening socket and reads every connection added to it, handing the bytes
+// to an IIoHandler. Writes do not go through the engine.
+class CIoEngine {
+public:
+  virtual ~CIoEngine() = default;
+
+  // Returns the io_uring engine when it was built in and the kernel supports
+  // it, and the epoll engine otherwise.
+  static std::shared_ptr<CIoEngine> Create();
+
+  virtual const char* GetName() const = 0;
+  virtual int Open(int fdListen) = 0;
+  // Both are only called from the engine thread.
+  virtual int AddConnection(int fd) = 0;
+  virtual void RemoveConnection(int fd) = 0;
+  // Reads a connection paused by IIoHandler::OnReceived again. May be called
+  // from any thread.
+  virtual void Resume(int fd) = 0;
+  // Dispatches events until Shutdown() is called.
+  virtual void Run(IIoHandler& handler) = 0;
+  // May be called from any thread.
+  virtual void Shutdown() = 0;
+  // Leaves the listening socket, which another process may share, to others;
+  // connections already accepted are still read. Returns once no more are
+  // handed out. May be called from any thread but the engine's.
+  virtual void StopAccepting() = 0;
+
+protected:
+  // How long accepting pauses when accept fails for lack of descriptors or
+  // memory, so the loop does not spin on the same error.
+  static constexpr std::chrono::milliseconds ACCEPT_RETRY_DELAY{ 100 };
+
+  static bool IsAcceptResourceError(int iError);
+};
+
+// Edge-triggered epoll. Readable sockets are drained into one scratch buffer
+// shared by all connections. A paused connection is registered without
+// EPOLLIN until it is resumed on the engine thread.
+class CEpollEngine : public CIoEngine {
+public:
+  CEpollEngine() = default;
+  ~CEpollEngine() override;
+  CEpollEngine(const CEpollEngine&) = delete;
+  CEpollEngine& operator=(const CEpollEngine&) = delete;
+
+  const char* GetName() const override;
+  int Open(int fdListen) override;
+  int AddConnection(int fd) override;
+  void RemoveConnection(int fd) override;
+  void Resume(int fd) override;
+  void Run(IIoHandler& handler) override;
+  void Shutdown() override;
+  void StopAccepting() override;
+
+private:
+  static constexpr size_t READ_SCRATCH_SIZE = 256 * 1024;
+
+  void AcceptConnections(IIoHandler& handler);
+  // Both are called with m_mtxAccept held.
+  void PauseAccepting();
+  void ResumeAccepting();
+  // Returns false once the connection is finished.
+  bool ReadConnection(int fd, IIoHandler& handler);
+  void ResumeConnections();
+
+  int m_fdListen{ -1 };
+  int m_fdEpoll{ -1 };
+  int m_fdWake{ -1 };
+  std::atomic<bool> m_running{ false };
+  std::atomic<bool> m_bAccepting{ true };
+  // Held by the engine thread while it accepts.
+  std::mutex m_mtxAccept;
+  std::vector<char> m_vecScratch;
+
+  // Only used on the engine thread.
+  std::unordered_set<int> m_setPaused;
+  bool m_bAcceptPaused{ false };
+  std::chrono::steady_clock::time_point m_tpAcceptRetry;
+
+  std::mutex m_mtxResume;
+  std::vector<int> m_vecResume;
+};
+
+}  // namespace MCP
+#endif
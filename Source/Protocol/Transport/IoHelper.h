@@ -0,0 +1,100 @@
+#pragma once
+
+#ifndef _WIN32
+#include <limits.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#include "../Public/PublicDef.h"
+
+namespace MCP {
+
+// Returns the first '\n' in [pData, pData + nSize), or nullptr.
+inline const char* FindNewline(const char* pData, size_t nSize) {
+#if defined(__SSE2__)
+  const __m128i newline = _mm_set1_epi8('\n');
+  while (nSize >= 16) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pData));
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+    if (mask != 0) {
+      return pData + __builtin_ctz(mask);
+    }
+    pData += 16;
+    nSize -= 16;
+  }
+#endif
+  return static_cast<const char*>(memchr(pData, '\n', nSize));
+}
+
+// Writes every byte described by vecIov, continuing after partial writes and
+// waiting for the descriptor when it is non-blocking and full. Sockets are
+// written with MSG_NOSIGNAL so a vanished peer is an error, not SIGPIPE, and
+// without blocking even on a blocking socket. Fails with errno ETIMEDOUT when
+// the descriptor takes no bytes for iTimeoutMs; -1 waits without limit.
+inline int WriteVector(int fd, std::vector<struct iovec>& vecIov,
+  bool bSocket = false, int iTimeoutMs = -1) {
+  size_t nIndex = 0;
+  while (nIndex < vecIov.size()) {
+    int nCount = static_cast<int>(
+      std::min<size_t>(vecIov.size() - nIndex, IOV_MAX));
+    ssize_t nWritten = 0;
+    if (bSocket) {
+      struct msghdr msg {};
+      msg.msg_iov = &vecIov[nIndex];
+      msg.msg_iovlen = nCount;
+#ifdef MSG_NOSIGNAL
+      nWritten = sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+#else
+      nWritten = sendmsg(fd, &msg, MSG_DONTWAIT);
+#endif
+    } else {
+      nWritten = writev(fd, &vecIov[nIndex], nCount);
+    }
+    if (nWritten < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        struct pollfd fds[1];
+        fds[0].fd = fd;
+        fds[0].events = POLLOUT;
+        int iReady = poll(fds, 1, iTimeoutMs);
+        if (iReady < 0 && errno != EINTR) {
+          return ERRNO_INTERNAL_OUTPUT_ERROR;
+        }
+        if (iReady == 0) {
+          errno = ETIMEDOUT;
+          return ERRNO_INTERNAL_OUTPUT_ERROR;
+        }
+        continue;
+      }
+      return ERRNO_INTERNAL_OUTPUT_ERROR;
+    }
+
+    size_t nRemain = static_cast<size_t>(nWritten);
+    while (nIndex < vecIov.size() && nRemain >= vecIov[nIndex].iov_len) {
+      nRemain -= vecIov[nIndex].iov_len;
+      ++nIndex;
+    }
+    if (nRemain > 0) {
+      vecIov[nIndex].iov_base =
+        static_cast<char*>(vecIov[nIndex].iov_base) + nRemain;
+      vecIov[nIndex].iov_len -= nRemain;
+    }
+  }
+
+  return ERRNO_OK;
+}
+
+}  // namespace MCP
+#endif
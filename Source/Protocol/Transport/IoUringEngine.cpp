@@ -0,0 +1,526 @@
+#include "IoUringEngine.h"
+
+#if defined(__linux__) && defined(TINYMCP_IO_URING)
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "../Public/Logger.h"
+#include "../Public/PublicDef.h"
+
+namespace MCP {
+
+static int SetupRing(unsigned nEntries, struct io_uring_params& params) {
+  return static_cast<int>(syscall(__NR_io_uring_setup, nEntries, &params));
+}
+
+static int EnterRing(int fdRing, unsigned nSubmit, unsigned nWaitFor,
+  unsigned uFlags) {
+  return static_cast<int>(syscall(
+    __NR_io_uring_enter, fdRing, nSubmit, nWaitFor, uFlags, nullptr, 0));
+}
+
+static int RegisterRing(int fdRing, unsigned uOpcode, void* pArg,
+  unsigned nArgs) {
+  return static_cast<int>(
+    syscall(__NR_io_uring_register, fdRing, uOpcode, pArg, nArgs));
+}
+
+static void* MapMemory(size_t nSize, int fd, off_t offset) {
+  int iFlags =
+    fd >= 0 ? MAP_SHARED | MAP_POPULATE : MAP_PRIVATE | MAP_ANONYMOUS;
+  void* pMemory =
+    mmap(nullptr, nSize, PROT_READ | PROT_WRITE, iFlags, fd, offset);
+  return pMemory == MAP_FAILED ? nullptr : pMemory;
+}
+
+CIoUringEngine::~CIoUringEngine() {
+  // Closing the ring cancels whatever is still in flight.
+  if (m_fdRing >= 0) {
+    close(m_fdRing);
+  }
+  if (m_fdWake >= 0) {
+    close(m_fdWake);
+  }
+  if (m_pSqes) {
+    munmap(m_pSqes, m_nSqesSize);
+  }
+  if (m_pCqRing && m_pCqRing != m_pSqRing) {
+    munmap(m_pCqRing, m_nCqRingSize);
+  }
+  if (m_pSqRing) {
+    munmap(m_pSqRing, m_nSqRingSize);
+  }
+  if (m_pBufferRing) {
+    munmap(m_pBufferRing, m_nBufferRingSize);
+  }
+  if (m_pBuffers) {
+    munmap(m_pBuffers, BUFFER_COUNT * BUFFER_SIZE);
+  }
+}
+
+int CIoUringEngine::Initialize() {
+  struct io_uring_params params {};
+  params.flags =
+    IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+  params.cq_entries = COMPLETION_DEPTH;
+  m_fdRing = SetupRing(QUEUE_DEPTH, params);
+  if (m_fdRing < 0 && errno == EINVAL) {
+    // Older kernels reject the optional flags.
+    params = {};
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = COMPLETION_DEPTH;
+    m_fdRing = SetupRing(QUEUE_DEPTH, params);
+  }
+  if (m_fdRing < 0) {
+    LOG_INFO("CIoUringEngine: io_uring_setup failed, error code: {}", errno);
+    return ERRNO_INTERNAL_ERROR;
+  }
+  if (!(params.features & IORING_FEAT_NODROP)) {
+    LOG_INFO("CIoUringEngine: Kernel io_uring is too old");
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  m_nSqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  m_nCqRingSize =
+    params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    m_nSqRingSize = m_nCqRingSize = std::max(m_nSqRingSize, m_nCqRingSize);
+  }
+  m_pSqRing = MapMemory(m_nSqRingSize, m_fdRing, IORING_OFF_SQ_RING);
+  m_pCqRing = (params.features & IORING_FEAT_SINGLE_MMAP)
+    ? m_pSqRing
+    : MapMemory(m_nCqRingSize, m_fdRing, IORING_OFF_CQ_RING);
+  m_nSqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+  m_pSqes = static_cast<struct io_uring_sqe*>(
+    MapMemory(m_nSqesSize, m_fdRing, IORING_OFF_SQES));
+  if (!m_pSqRing || !m_pCqRing || !m_pSqes) {
+    LOG_ERROR("CIoUringEngine: Failed to map the rings, error code: {}",
+      errno);
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  char* pSq = static_cast<char*>(m_pSqRing);
+  m_puSqHead = reinterpret_cast<unsigned*>(pSq + params.sq_off.head);
+  m_puSqTail = reinterpret_cast<unsigned*>(pSq + params.sq_off.tail);
+  m_uSqMask = *reinterpret_cast<unsigned*>(pSq + params.sq_off.ring_mask);
+  m_uSqEntries = params.sq_entries;
+  m_uSqTail = *m_puSqTail;
+  // Submission entries are always used in ring order.
+  unsigned* puSqArray =
+    reinterpret_cast<unsigned*>(pSq + params.sq_off.array);
+  for (unsigned i = 0; i < m_uSqEntries; ++i) {
+    puSqArray[i] = i;
+  }
+  char* pCq = static_cast<char*>(m_pCqRing);
+  m_puCqHead = reinterpret_cast<unsigned*>(pCq + params.cq_off.head);
+  m_puCqTail = reinterpret_cast<unsigned*>(pCq + params.cq_off.tail);
+  m_uCqMask = *reinterpret_cast<unsigned*>(pCq + params.cq_off.ring_mask);
+  m_pCqes = reinterpret_cast<struct io_uring_cqe*>(pCq + params.cq_off.cqes);
+
+  m_nBufferRingSize = BUFFER_COUNT * sizeof(struct io_uring_buf);
+  m_pBufferRing = static_cast<struct io_uring_buf_ring*>(
+    MapMemory(m_nBufferRingSize, -1, 0));
+  m_pBuffers =
+    static_cast<char*>(MapMemory(BUFFER_COUNT * BUFFER_SIZE, -1, 0));
+  if (!m_pBufferRing || !m_pBuffers) {
+    LOG_ERROR("CIoUringEngine: Failed to allocate buffers, error code: {}",
+      errno);
+    return ERRNO_INTERNAL_ERROR;
+  }
+  struct io_uring_buf_reg reg {};
+  reg.ring_addr = reinterpret_cast<uint64_t>(m_pBufferRing);
+  reg.ring_entries = BUFFER_COUNT;
+  reg.bgid = BUFFER_GROUP;
+  if (RegisterRing(m_fdRing, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+    LOG_INFO("CIoUringEngine: Provided buffer rings are not supported, "
+             "error code: {}",
+      errno);
+    return ERRNO_INTERNAL_ERROR;
+  }
+  for (unsigned i = 0; i < BUFFER_COUNT; ++i) {
+    RecycleBuffer(static_cast<uint16_t>(i));
+  }
+
+  // Left blocking so that the read queued on it waits for a wakeup.
+  m_fdWake = eventfd(0, EFD_CLOEXEC);
+  if (m_fdWake < 0) {
+    LOG_ERROR("CIoUringEngine: eventfd failed, error code: {}", errno);
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  return ERRNO_OK;
+}
+
+const char* CIoUringEngine::GetName() const {
+  return "io_uring";
+}
+
+int CIoUringEngine::Open(int fdListen) {
+  m_fdListen = fdListen;
+  m_running = true;
+  ArmAccept();
+  ArmWake();
+  return ERRNO_OK;
+}
+
+int CIoUringEngine::AddConnection(int fd) {
+  Connection& connection = m_hashConnections[fd];
+  connection = Connection();
+  connection.uGeneration = ++m_uNextGeneration & 0xffffff;
+  ArmRecv(fd, connection);
+  return ERRNO_OK;
+}
+
+void CIoUringEngine::RemoveConnection(int fd) {
+  auto iter = m_hashConnections.find(fd);
+  if (iter == m_hashConnections.end()) {
+    return;
+  }
+  if (iter->second.bArmed) {
+    Cancel(MakeUserData(OPERATION_RECV, iter->second.uGeneration, fd));
+  }
+  m_hashConnections.erase(iter);
+}
+
+void CIoUringEngine::Resume(int fd) {
+  {
+    std::lock_guard<std::mutex> lock(m_mtxResume);
+    m_vecResume.push_back(fd);
+  }
+  uint64_t wake = 1;
+  if (write(m_fdWake, &wake, sizeof(wake)) < 0) {
+    LOG_WARNING("CIoUringEngine::Resume: Failed to wake the loop");
+  }
+}
+
+void CIoUringEngine::Run(IIoHandler& handler) {
+  while (m_running) {
+    // Submits everything queued since the last round and waits for at
+    // least one completion in the same system call.
+    if (Enter(1) < 0 && errno != EINTR && errno != EBUSY && errno != EAGAIN) {
+      LOG_ERROR("CIoUringEngine: io_uring_enter failed, error code: {}",
+        errno);
+      break;
+    }
+
+    unsigned uHead = *m_puCqHead;
+    unsigned uTail = __atomic_load_n(m_puCqTail, __ATOMIC_ACQUIRE);
+    while (uHead != uTail && m_running) {
+      struct io_uring_cqe cqe = m_pCqes[uHead & m_uCqMask];
+      ++uHead;
+      __atomic_store_n(m_puCqHead, uHead, __ATOMIC_RELEASE);
+      HandleCompletion(cqe, handler);
+    }
+
+    ResumeConnections();
+    if (!m_bAccepting) {
+      StopAccept();
+    }
+  }
+}
+
+void CIoUringEngine::Shutdown() {
+  m_running = false;
+  if (m_fdWake >= 0) {
+    uint64_t wake = 1;
+    if (write(m_fdWake, &wake, sizeof(wake)) < 0) {
+      LOG_WARNING("CIoUringEngine::Shutdown: Failed to wake the loop");
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mtxAccept);
+  }
+  m_cvAccept.notify_all();
+}
+
+void CIoUringEngine::StopAccepting() {
+  m_bAccepting = false;
+  if (m_fdWake >= 0) {
+    uint64_t wake = 1;
+    if (write(m_fdWake, &wake, sizeof(wake)) < 0) {
+      LOG_WARNING("CIoUringEngine::StopAccepting: Failed to wake the loop");
+    }
+  }
+
+  std::unique_lock<std::mutex> lock(m_mtxAccept);
+  if (!m_cvAccept.wait_for(lock, ACCEPT_STOP_TIMEOUT,
+        [this]() { return m_bAcceptStopped || !m_running; })) {
+    LOG_WARNING("CIoUringEngine::StopAccepting: Accept still armed");
+  }
+}
+
+void CIoUringEngine::StopAccept() {
+  if (m_bAcceptArmed) {
+    // Accepts completing before the cancellation are still handed out.
+    if (!m_bAcceptCancelled) {
+      Cancel(MakeUserData(OPERATION_ACCEPT, 0, m_fdListen));
+      m_bAcceptCancelled = true;
+    }
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mtxAccept);
+  if (!m_bAcceptStopped) {
+    m_bAcceptStopped = true;
+    m_cvAccept.notify_all();
+  }
+}
+
+uint64_t CIoUringEngine::MakeUserData(Operation eOperation,
+  uint32_t uGeneration, int fd) {
+  return (static_cast<uint64_t>(eOperation) << 56) |
+    (static_cast<uint64_t>(uGeneration & 0xffffff) << 32) |
+    static_cast<uint32_t>(fd);
+}
+
+struct io_uring_sqe* CIoUringEngine::GetSqe() {
+  unsigned uHead = __atomic_load_n(m_puSqHead, __ATOMIC_ACQUIRE);
+  if (m_uSqTail - uHead >= m_uSqEntries) {
+    // Full: hand the queued entries to the kernel first.
+    Enter(0);
+    uHead = __atomic_load_n(m_puSqHead, __ATOMIC_ACQUIRE);
+    if (m_uSqTail - uHead >= m_uSqEntries) {
+      LOG_ERROR("CIoUringEngine: Submission queue is full");
+      return nullptr;
+    }
+  }
+
+  struct io_uring_sqe* pSqe = &m_pSqes[m_uSqTail & m_uSqMask];
+  memset(pSqe, 0, sizeof(*pSqe));
+  ++m_uSqTail;
+  return pSqe;
+}
+
+int CIoUringEngine::Enter(unsigned nWaitFor) {
+  __atomic_store_n(m_puSqTail, m_uSqTail, __ATOMIC_RELEASE);
+  unsigned nSubmit =
+    m_uSqTail - __atomic_load_n(m_puSqHead, __ATOMIC_ACQUIRE);
+  if (nSubmit == 0 && nWaitFor == 0) {
+    return 0;
+  }
+  return EnterRing(m_fdRing, nSubmit, nWaitFor,
+    nWaitFor > 0 ? IORING_ENTER_GETEVENTS : 0);
+}
+
+void CIoUringEngine::ArmAccept() {
+  struct io_uring_sqe* pSqe = GetSqe();
+  if (!pSqe) {
+    return;
+  }
+  pSqe->opcode = IORING_OP_ACCEPT;
+  pSqe->fd = m_fdListen;
+  // Writes block on the session thread, so connections stay blocking.
+  pSqe->accept_flags = SOCK_CLOEXEC;
+  pSqe->ioprio = m_bMultishotAccept ? IORING_ACCEPT_MULTISHOT : 0;
+  pSqe->user_data = MakeUserData(OPERATION_ACCEPT, 0, m_fdListen);
+  m_bAcceptArmed = true;
+}
+
+void CIoUringEngine::ArmAcceptRetry() {
+  struct io_uring_sqe* pSqe = GetSqe();
+  if (!pSqe) {
+    return;
+  }
+  auto seconds =
+    std::chrono::duration_cast<std::chrono::seconds>(ACCEPT_RETRY_DELAY);
+  m_tsAcceptRetry.tv_sec = seconds.count();
+  m_tsAcceptRetry.tv_nsec =
+    std::chrono::nanoseconds(ACCEPT_RETRY_DELAY - seconds).count();
+  pSqe->opcode = IORING_OP_TIMEOUT;
+  pSqe->fd = -1;
+  pSqe->addr = reinterpret_cast<uint64_t>(&m_tsAcceptRetry);
+  pSqe->len = 1;
+  pSqe->user_data = MakeUserData(OPERATION_ACCEPT_RETRY, 0, 0);
+}
+
+void CIoUringEngine::ArmRecv(int fd, Connection& connection) {
+  struct io_uring_sqe* pSqe = GetSqe();
+  if (!pSqe) {
+    return;
+  }
+  pSqe->opcode = IORING_OP_RECV;
+  pSqe->fd = fd;
+  pSqe->flags = IOSQE_BUFFER_SELECT;
+  pSqe->buf_group = BUFFER_GROUP;
+  pSqe->ioprio = m_bMultishotRecv ? IORING_RECV_MULTISHOT : 0;
+  pSqe->user_data = MakeUserData(OPERATION_RECV, connection.uGeneration, fd);
+  connection.bArmed = true;
+}
+
+void CIoUringEngine::ArmWake() {
+  struct io_uring_sqe* pSqe = GetSqe();
+  if (!pSqe) {
+    return;
+  }
+  pSqe->opcode = IORING_OP_READ;
+  pSqe->fd = m_fdWake;
+  pSqe->addr = reinterpret_cast<uint64_t>(&m_ullWakeValue);
+  pSqe->len = sizeof(m_ullWakeValue);
+  pSqe->user_data = MakeUserData(OPERATION_WAKE, 0, m_fdWake);
+}
+
+void CIoUringEngine::Cancel(uint64_t ullUserData) {
+  struct io_uring_sqe* pSqe = GetSqe();
+  if (!pSqe) {
+    return;
+  }
+  pSqe->opcode = IORING_OP_ASYNC_CANCEL;
+  pSqe->fd = -1;
+  pSqe->addr = ullUserData;
+  pSqe->user_data = MakeUserData(OPERATION_CANCEL, 0, 0);
+}
+
+void CIoUringEngine::HandleCompletion(
+  const struct io_uring_cqe& cqe, IIoHandler& handler) {
+  bool bMore = cqe.flags & IORING_CQE_F_MORE;
+  switch (static_cast<Operation>(cqe.user_data >> 56)) {
+  case OPERATION_ACCEPT:
+    if (cqe.res >= 0) {
+      handler.OnAccepted(cqe.res);
+    } else if (cqe.res == -EINVAL && m_bMultishotAccept) {
+      LOG_INFO("CIoUringEngine: Multishot accept not supported");
+      m_bMultishotAccept = false;
+    } else if (IsAcceptResourceError(-cqe.res)) {
+      // Accepting again at once would fail the same way until a descriptor
+      // is freed.
+      LOG_ERROR("CIoUringEngine: accept failed, error code: {}, pausing",
+        -cqe.res);
+      if (!m_bAcceptBackoff && bMore) {
+        Cancel(cqe.user_data);
+      }
+      m_bAcceptBackoff = true;
+    } else if (cqe.res != -ECANCELED) {
+      LOG_ERROR("CIoUringEngine: accept failed, error code: {}", -cqe.res);
+    }
+    if (!bMore) {
+      m_bAcceptArmed = false;
+      if (m_running && m_bAccepting) {
+        if (m_bAcceptBackoff) {
+          ArmAcceptRetry();
+        } else {
+          ArmAccept();
+        }
+      }
+    }
+    break;
+  case OPERATION_ACCEPT_RETRY:
+    m_bAcceptBackoff = false;
+    if (m_running && m_bAccepting && !m_bAcceptArmed) {
+      ArmAccept();
+    }
+    break;
+  case OPERATION_RECV:
+    HandleRecv(cqe, handler);
+    break;
+  case OPERATION_WAKE:
+    if (m_running) {
+      ArmWake();
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+void CIoUringEngine::HandleRecv(
+  const struct io_uring_cqe& cqe, IIoHandler& handler) {
+  int fd = static_cast<int>(cqe.user_data & 0xffffffff);
+  uint32_t uGeneration = (cqe.user_data >> 32) & 0xffffff;
+  bool bHasBuffer = cqe.flags & IORING_CQE_F_BUFFER;
+  uint16_t uBufferId = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+
+  auto iter = m_hashConnections.find(fd);
+  if (iter == m_hashConnections.end() ||
+      iter->second.uGeneration != uGeneration) {
+    // Left over from a connection that is already gone.
+    if (bHasBuffer) {
+      RecycleBuffer(uBufferId);
+    }
+    return;
+  }
+
+  Connection& connection = iter->second;
+  if (!(cqe.flags & IORING_CQE_F_MORE)) {
+    connection.bArmed = false;
+  }
+
+  if (cqe.res > 0 && bHasBuffer) {
+    bool bWantMore = handler.OnReceived(
+      fd, m_pBuffers + uBufferId * BUFFER_SIZE, static_cast<size_t>(cqe.res));
+    RecycleBuffer(uBufferId);
+    if (!bWantMore && !connection.bPaused) {
+      // Anything already received still arrives; nothing new is read until
+      // Resume().
+      connection.bPaused = true;
+      if (connection.bArmed) {
+        Cancel(cqe.user_data);
+      }
+    }
+  } else if (bHasBuffer) {
+    RecycleBuffer(uBufferId);
+  }
+
+  if (cqe.res == 0) {
+    handler.OnClosed(fd);
+    return;
+  }
+  if (cqe.res < 0 && cqe.res != -ENOBUFS && cqe.res != -ECANCELED) {
+    if (cqe.res == -EINVAL && m_bMultishotRecv) {
+      LOG_INFO("CIoUringEngine: Multishot receive not supported");
+      m_bMultishotRecv = false;
+    } else {
+      LOG_INFO("CIoUringEngine: recv on fd {} failed, error code: {}", fd,
+        -cqe.res);
+      handler.OnClosed(fd);
+      return;
+    }
+  }
+
+  if (!connection.bArmed && !connection.bPaused && m_running) {
+    ArmRecv(fd, connection);
+  }
+}
+
+void CIoUringEngine::RecycleBuffer(uint16_t uBufferId) {
+  // Not through io_uring_buf_ring::bufs: in C++ the empty struct of the
+  // flexible array declaration moves it away from the start of the ring.
+  auto* pRing = reinterpret_cast<struct io_uring_buf*>(m_pBufferRing);
+  struct io_uring_buf* pBuffer = &pRing[m_uBufferTail & (BUFFER_COUNT - 1)];
+  pBuffer->addr = reinterpret_cast<uint64_t>(m_pBuffers) +
+    static_cast<uint64_t>(uBufferId) * BUFFER_SIZE;
+  pBuffer->len = BUFFER_SIZE;
+  pBuffer->bid = uBufferId;
+  ++m_uBufferTail;
+  // The tail shares its place with the reserved field of the first entry.
+  __atomic_store_n(&pRing[0].resv, m_uBufferTail, __ATOMIC_RELEASE);
+}
+
+void CIoUringEngine::ResumeConnections() {
+  std::vector<int> vecResume;
+  {
+    std::lock_guard<std::mutex> lock(m_mtxResume);
+    vecResume.swap(m_vecResume);
+  }
+
+  for (int fd : vecResume) {
+    auto iter = m_hashConnections.find(fd);
+    if (iter == m_hashConnections.end() || !iter->second.bPaused) {
+      continue;
+    }
+    iter->second.bPaused = false;
+    if (!iter->second.bArmed) {
+      ArmRecv(fd, iter->second);
+    }
+  }
+}
+
+}  // namespace MCP
+#endif
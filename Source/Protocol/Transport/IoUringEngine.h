@@ -0,0 +1,142 @@
+#pragma once
+
+#if defined(__linux__) && defined(TINYMCP_IO_URING)
+#include <linux/io_uring.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "IoEngine.h"
+
+namespace MCP {
+
+// io_uring engine, driven through the raw system calls. Accepts and receives
+// are multishot requests, so a busy connection costs no system call per
+// read; re-arming and waiting for completions of all connections share one
+// io_uring_enter() per loop iteration. Kernels without multishot support are
+// served by single shot requests instead.
+//
+// Receives pick their buffer from a provided buffer ring
+// (IORING_REGISTER_PBUF_RING). These are not fixed buffers
+// (IORING_REGISTER_BUFFERS), which only serve the *_FIXED operations; the
+// kernel still copies each read into them. Writes do not go through the
+// ring: the session threads write with writev() or sendmsg() as before, one
+// system call per batch, since handing replies to the engine thread would
+// cost a thread hop each. The stdio channel does not use an engine.
+class CIoUringEngine : public CIoEngine {
+public:
+  CIoUringEngine() = default;
+  ~CIoUringEngine() override;
+  CIoUringEngine(const CIoUringEngine&) = delete;
+  CIoUringEngine& operator=(const CIoUringEngine&) = delete;
+
+  // Sets up the rings and the receive buffers. Fails when the kernel does
+  // not support io_uring or provided buffer rings.
+  int Initialize();
+
+  const char* GetName() const override;
+  int Open(int fdListen) override;
+  int AddConnection(int fd) override;
+  void RemoveConnection(int fd) override;
+  void Resume(int fd) override;
+  void Run(IIoHandler& handler) override;
+  void Shutdown() override;
+  void StopAccepting() override;
+
+private:
+  static constexpr unsigned QUEUE_DEPTH = 256;
+  static constexpr std::chrono::seconds ACCEPT_STOP_TIMEOUT{ 1 };
+  static constexpr unsigned COMPLETION_DEPTH = 4096;
+  // Must be a power of two.
+  static constexpr unsigned BUFFER_COUNT = 256;
+  static constexpr size_t BUFFER_SIZE = 16 * 1024;
+  static constexpr uint16_t BUFFER_GROUP = 0;
+
+  enum Operation : uint64_t {
+    OPERATION_ACCEPT = 1,
+    OPERATION_RECV,
+    OPERATION_WAKE,
+    OPERATION_CANCEL,
+    OPERATION_ACCEPT_RETRY,
+  };
+
+  struct Connection {
+    // Tells completions for an earlier connection on the same fd apart.
+    uint32_t uGeneration{ 0 };
+    bool bArmed{ false };
+    bool bPaused{ false };
+  };
+
+  static uint64_t MakeUserData(Operation eOperation, uint32_t uGeneration,
+    int fd);
+
+  struct io_uring_sqe* GetSqe();
+  int Enter(unsigned nWaitFor);
+  void ArmAccept();
+  // Arms the accept again after ACCEPT_RETRY_DELAY.
+  void ArmAcceptRetry();
+  // Cancels the accept after StopAccepting(), then signals once it is gone.
+  void StopAccept();
+  void ArmRecv(int fd, Connection& connection);
+  void ArmWake();
+  void Cancel(uint64_t ullUserData);
+  void HandleCompletion(const struct io_uring_cqe& cqe, IIoHandler& handler);
+  void HandleRecv(const struct io_uring_cqe& cqe, IIoHandler& handler);
+  void RecycleBuffer(uint16_t uBufferId);
+  void ResumeConnections();
+
+  int m_fdRing{ -1 };
+  int m_fdListen{ -1 };
+  int m_fdWake{ -1 };
+  uint64_t m_ullWakeValue{ 0 };
+  std::atomic<bool> m_running{ false };
+  bool m_bMultishotAccept{ true };
+  std::atomic<bool> m_bAccepting{ true };
+  // Only used on the engine thread.
+  bool m_bAcceptArmed{ false };
+  bool m_bAcceptCancelled{ false };
+  bool m_bAcceptBackoff{ false };
+  struct __kernel_timespec m_tsAcceptRetry {};
+  // Signalled once the last accept completed after StopAccepting().
+  std::mutex m_mtxAccept;
+  std::condition_variable m_cvAccept;
+  bool m_bAcceptStopped{ false };
+  bool m_bMultishotRecv{ true };
+
+  // Submission and completion rings shared with the kernel.
+  void* m_pSqRing{ nullptr };
+  size_t m_nSqRingSize{ 0 };
+  void* m_pCqRing{ nullptr };
+  size_t m_nCqRingSize{ 0 };
+  struct io_uring_sqe* m_pSqes{ nullptr };
+  size_t m_nSqesSize{ 0 };
+  unsigned* m_puSqHead{ nullptr };
+  unsigned* m_puSqTail{ nullptr };
+  unsigned m_uSqMask{ 0 };
+  unsigned m_uSqEntries{ 0 };
+  unsigned m_uSqTail{ 0 };
+  unsigned* m_puCqHead{ nullptr };
+  unsigned* m_puCqTail{ nullptr };
+  unsigned m_uCqMask{ 0 };
+  struct io_uring_cqe* m_pCqes{ nullptr };
+
+  // Receive buffers handed to the kernel through a provided buffer ring.
+  struct io_uring_buf_ring* m_pBufferRing{ nullptr };
+  size_t m_nBufferRingSize{ 0 };
+  char* m_pBuffers{ nullptr };
+  uint16_t m_uBufferTail{ 0 };
+
+  // Only used on the engine thread.
+  std::unordered_map<int, Connection> m_hashConnections;
+  uint32_t m_uNextGeneration{ 0 };
+
+  std::mutex m_mtxResume;
+  std::vector<int> m_vecResume;
+};
+
+}  // namespace MCP
+#endif
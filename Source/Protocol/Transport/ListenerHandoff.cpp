@@ -0,0 +1,287 @@
+#include "ListenerHandoff.h"
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "../Public/Logger.h"
+#include "../Public/PublicDef.h"
+#include "SocketTransport.h"
+
+namespace MCP {
+
+namespace {
+constexpr char HANDOFF_CONFIRM = 'R';
+
+struct HandoffHeader {
+  uint32_t uVersion;
+  uint32_t uCount;
+};
+
+void CloseFd(int& fd) {
+  if (fd >= 0) {
+    close(fd);
+    fd = -1;
+  }
+}
+}  // namespace
+
+CListenerHandoff::~CListenerHandoff() {
+  Close();
+  CloseFd(m_fdPredecessor);
+}
+
+int CListenerHandoff::Receive(
+  const std::string& strPath, std::vector<int>& vecFds) {
+  vecFds.clear();
+
+  struct sockaddr_un addr {};
+  socklen_t nAddrLen = 0;
+  int iErrCode = MakeUnixAddress(strPath, addr, nAddrLen);
+  if (ERRNO_OK != iErrCode) {
+    return iErrCode;
+  }
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    LOG_ERROR("CListenerHandoff: socket failed, error code: {}", errno);
+    return ERRNO_INTERNAL_ERROR;
+  }
+  if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr), nAddrLen) < 0) {
+    int iError = errno;
+    close(fd);
+    if (ENOENT == iError || ECONNREFUSED == iError) {
+      LOG_INFO("CListenerHandoff: No server to take over on '{}'", strPath);
+      return ERRNO_OK;
+    }
+    LOG_ERROR("CListenerHandoff: Failed to connect to '{}', error code: {}",
+      strPath, iError);
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  struct timeval timeout {};
+  timeout.tv_sec = HANDOFF_TIMEOUT.count();
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  HandoffHeader header {};
+  struct iovec iov {
+    &header, sizeof(header)
+  };
+  alignas(struct cmsghdr) char control[CMSG_SPACE(
+    sizeof(int) * MAX_LISTENERS)] = {};
+  struct msghdr msg {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  ssize_t nReceived = 0;
+  do {
+    nReceived = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+  } while (nReceived < 0 && errno == EINTR);
+
+  struct cmsghdr* pCmsg = CMSG_FIRSTHDR(&msg);
+  if (pCmsg && pCmsg->cmsg_level == SOL_SOCKET &&
+      pCmsg->cmsg_type == SCM_RIGHTS) {
+    size_t nFds = (pCmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    vecFds.resize(nFds);
+    memcpy(vecFds.data(), CMSG_DATA(pCmsg), nFds * sizeof(int));
+  }
+  if (nReceived != static_cast<ssize_t>(sizeof(header)) ||
+      (msg.msg_flags & MSG_CTRUNC) || header.uVersion != HANDOFF_VERSION ||
+      header.uCount != vecFds.size()) {
+    LOG_ERROR("CListenerHandoff: Invalid hand-over from '{}'", strPath);
+    for (int& fdListener : vecFds) {
+      CloseFd(fdListener);
+    }
+    vecFds.clear();
+    close(fd);
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  LOG_INFO("CListenerHandoff: Took over {} listeners from '{}'",
+    vecFds.size(), strPath);
+  m_fdPredecessor = fd;
+  return ERRNO_OK;
+}
+
+int CListenerHandoff::Confirm(bool bServing) {
+  if (m_fdPredecessor < 0) {
+    return ERRNO_OK;
+  }
+
+  int iErrCode = ERRNO_OK;
+  if (bServing) {
+    if (send(m_fdPredecessor, &HANDOFF_CONFIRM, 1, MSG_NOSIGNAL) != 1) {
+      LOG_ERROR("CListenerHandoff: Failed to confirm, error code: {}", errno);
+      iErrCode = ERRNO_INTERNAL_ERROR;
+    } else {
+      // The predecessor hangs up once it left the path.
+      char cByte = 0;
+      while (recv(m_fdPredecessor, &cByte, 1, 0) < 0 && errno == EINTR) {
+      }
+    }
+  }
+
+  CloseFd(m_fdPredecessor);
+  return iErrCode;
+}
+
+int CListenerHandoff::Listen(const std::string& strPath,
+  ListenersGetter fnGetListeners, HandedOffHandler fnHandedOff) {
+  Close();
+
+  int iErrCode = CreateUnixListener(strPath, m_fdListen);
+  if (ERRNO_OK != iErrCode) {
+    return iErrCode;
+  }
+  m_fdWake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (m_fdWake < 0) {
+    LOG_ERROR("CListenerHandoff: eventfd failed, error code: {}", errno);
+    CloseFd(m_fdListen);
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  m_strPath = strPath;
+  m_bHandedOff = false;
+  m_fnGetListeners = std::move(fnGetListeners);
+  m_fnHandedOff = std::move(fnHandedOff);
+  m_upThread =
+    std::make_unique<std::thread>(&CListenerHandoff::ListenLoop, this);
+  return ERRNO_OK;
+}
+
+void CListenerHandoff::Close() {
+  if (m_fdWake >= 0) {
+    uint64_t ullValue = 1;
+    if (write(m_fdWake, &ullValue, sizeof(ullValue)) < 0) {
+      LOG_WARNING("CListenerHandoff: Failed to wake the handoff thread");
+    }
+  }
+  if (m_upThread && m_upThread->joinable()) {
+    // The handoff thread stops the server itself once it handed off; a
+    // later call joins it.
+    if (m_upThread->get_id() == std::this_thread::get_id()) {
+      return;
+    }
+    m_upThread->join();
+  }
+  m_upThread.reset();
+
+  // The path belongs to the successor once handed off.
+  if (m_fdListen >= 0 && !m_bHandedOff) {
+    RemoveUnixSocketPath(m_strPath);
+  }
+  CloseFd(m_fdListen);
+  CloseFd(m_fdWake);
+}
+
+void CListenerHandoff::ListenLoop() {
+  while (true) {
+    struct pollfd fds[2] = { { m_fdListen, POLLIN, 0 },
+      { m_fdWake, POLLIN, 0 } };
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG_ERROR("CListenerHandoff: poll failed, error code: {}", errno);
+      break;
+    }
+    if (fds[1].revents != 0) {
+      break;
+    }
+
+    int fd = accept4(m_fdListen, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) {
+      continue;
+    }
+    if (!HandOver(fd)) {
+      close(fd);
+      continue;
+    }
+
+    // Leaves the path before hanging up, so the successor can bind it.
+    m_bHandedOff = true;
+    CloseFd(m_fdListen);
+    close(fd);
+    if (m_fnHandedOff) {
+      m_fnHandedOff();
+    }
+    break;
+  }
+}
+
+bool CListenerHandoff::HandOver(int fd) {
+  PeerCredentials credentials;
+  if (ERRNO_OK != ReadPeerCredentials(fd, credentials)) {
+    return false;
+  }
+  if (credentials.uid != geteuid()) {
+    LOG_WARNING("CListenerHandoff: Rejected peer pid {} uid {}",
+      credentials.pid, credentials.uid);
+    return false;
+  }
+
+  std::vector<int> vecFds;
+  if (m_fnGetListeners) {
+    vecFds = m_fnGetListeners();
+  }
+  if (vecFds.size() > MAX_LISTENERS) {
+    LOG_ERROR("CListenerHandoff: Too many listeners: {}", vecFds.size());
+    return false;
+  }
+
+  HandoffHeader header { HANDOFF_VERSION,
+    static_cast<uint32_t>(vecFds.size()) };
+  struct iovec iov {
+    &header, sizeof(header)
+  };
+  alignas(struct cmsghdr) char control[CMSG_SPACE(
+    sizeof(int) * MAX_LISTENERS)] = {};
+  struct msghdr msg {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  if (!vecFds.empty()) {
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * vecFds.size());
+    struct cmsghdr* pCmsg = CMSG_FIRSTHDR(&msg);
+    pCmsg->cmsg_level = SOL_SOCKET;
+    pCmsg->cmsg_type = SCM_RIGHTS;
+    pCmsg->cmsg_len = CMSG_LEN(sizeof(int) * vecFds.size());
+    memcpy(CMSG_DATA(pCmsg), vecFds.data(), sizeof(int) * vecFds.size());
+  }
+  if (sendmsg(fd, &msg, MSG_NOSIGNAL) < 0) {
+    LOG_ERROR("CListenerHandoff: Failed to hand over, error code: {}", errno);
+    return false;
+  }
+  LOG_INFO("CListenerHandoff: Handed {} listeners to pid {}", vecFds.size(),
+    credentials.pid);
+
+  // The successor confirms once it serves.
+  auto timeout = std::chrono::milliseconds(HANDOFF_TIMEOUT);
+  struct pollfd fds[2] = { { fd, POLLIN, 0 }, { m_fdWake, POLLIN, 0 } };
+  int iReady = 0;
+  do {
+    iReady = poll(fds, 2, static_cast<int>(timeout.count()));
+  } while (iReady < 0 && errno == EINTR);
+
+  char cConfirm = 0;
+  if (iReady <= 0 || fds[1].revents != 0 || recv(fd, &cConfirm, 1, 0) != 1 ||
+      cConfirm != HANDOFF_CONFIRM) {
+    LOG_WARNING("CListenerHandoff: Pid {} did not take over, still serving",
+      credentials.pid);
+    return false;
+  }
+
+  LOG_INFO("CListenerHandoff: Pid {} took over", credentials.pid);
+  return true;
+}
+
+}  // namespace MCP
+#endif
@@ -0,0 +1,67 @@
+#pragma once
+
+#if defined(__linux__)
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace MCP {
+
+// Zero-downtime restart, see CMCPServer::SetHandoffPath(). The serving
+// process waits for its successor on a Unix domain socket. The successor
+// connects before it starts and receives the listening sockets of the
+// transport (SCM_RIGHTS), so connections queue on the same sockets while
+// both run. Once it serves it confirms, and the old process stops accepting
+// and drains.
+class CListenerHandoff {
+public:
+  using ListenersGetter = std::function<std::vector<int>()>;
+  using HandedOffHandler = std::function<void()>;
+
+  static constexpr uint32_t HANDOFF_VERSION = 1;
+  static constexpr size_t MAX_LISTENERS = 8;
+  // How long either side waits for the other.
+  static constexpr std::chrono::seconds HANDOFF_TIMEOUT{ 10 };
+
+  CListenerHandoff() = default;
+  ~CListenerHandoff();
+  CListenerHandoff(const CListenerHandoff&) = delete;
+  CListenerHandoff& operator=(const CListenerHandoff&) = delete;
+
+  // Successor: takes the listening sockets of the process serving on the
+  // path. vecFds stays empty when no process serves there.
+  int Receive(const std::string& strPath, std::vector<int>& vecFds);
+  // Successor: tells the predecessor whether this process serves now and
+  // waits until the predecessor left the path. Unless confirmed, the
+  // predecessor keeps serving.
+  int Confirm(bool bServing);
+
+  // Serving process: answers successors on a thread of its own until
+  // Close(). fnHandedOff runs on that thread once one took over.
+  int Listen(const std::string& strPath, ListenersGetter fnGetListeners,
+    HandedOffHandler fnHandedOff);
+  void Close();
+
+private:
+  void ListenLoop();
+  // Returns true once the successor confirmed.
+  bool HandOver(int fd);
+
+  int m_fdPredecessor{ -1 };
+
+  std::string m_strPath;
+  int m_fdListen{ -1 };
+  int m_fdWake{ -1 };
+  std::atomic<bool> m_bHandedOff{ false };
+  ListenersGetter m_fnGetListeners;
+  HandedOffHandler m_fnHandedOff;
+  std::unique_ptr<std::thread> m_upThread;
+};
+
+}  // namespace MCP
+#endif
@@ -0,0 +1,788 @@
+#include "ShmTransport.h"
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#include "../Public/Logger.h"
+#include "../Public/PublicDef.h"
+#include "SocketTransport.h"
+
+namespace MCP {
+
+namespace {
+constexpr uint32_t SHM_MAGIC = 0x4d435052;  // "MCPR"
+constexpr uint32_t SHM_VERSION = 2;
+constexpr size_t SHM_HANDOVER_FDS = 5;
+constexpr size_t SHM_HEADER_SIZE = 64;
+constexpr size_t FRAME_LENGTH_SIZE = sizeof(uint32_t);
+
+struct SegmentHeader {
+  uint32_t uMagic;
+  uint32_t uVersion;
+  uint64_t ullRingCapacity;
+};
+static_assert(sizeof(SegmentHeader) <= SHM_HEADER_SIZE, "header too large");
+
+void CloseFd(int& fd) {
+  if (fd >= 0) {
+    close(fd);
+    fd = -1;
+  }
+}
+
+void SignalEventFd(int fd) {
+  uint64_t ullValue = 1;
+  if (fd >= 0 && write(fd, &ullValue, sizeof(ullValue)) < 0 &&
+      errno != EAGAIN) {
+    LOG_WARNING("Failed to signal eventfd, error code: {}", errno);
+  }
+}
+
+void DrainEventFd(int fd) {
+  uint64_t ullValue = 0;
+  while (read(fd, &ullValue, sizeof(ullValue)) > 0) {
+  }
+}
+}  // namespace
+
+// Lives in the shared segment. Head and tail sit on separate cache lines so
+// the two processes do not contend on the same line.
+struct CShmEndpoint::RingControl {
+  alignas(64) std::atomic<uint64_t> ullHead{ 0 };
+  alignas(64) std::atomic<uint64_t> ullTail{ 0 };
+  alignas(64) std::atomic<uint32_t> uReaderWaiting{ 0 };
+  std::atomic<uint32_t> uWriterWaiting{ 0 };
+  std::atomic<uint32_t> uClosed{ 0 };
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+  "shared memory rings need lock-free 64-bit atomics");
+
+CShmEndpoint::~CShmEndpoint() {
+  if (m_pMapping) {
+    munmap(m_pMapping, m_nMappingSize);
+  }
+  CloseFd(m_fdMemory);
+  CloseFd(m_fdServerNotify);
+  CloseFd(m_fdClientNotify);
+  CloseFd(m_fdServerSpace);
+  CloseFd(m_fdClientSpace);
+}
+
+int CShmEndpoint::Create(size_t nRingCapacity) {
+  // Power of two capacities keep positions valid across wrap-around.
+  size_t nCapacity = 4096;
+  while (nCapacity < nRingCapacity) {
+    nCapacity <<= 1;
+  }
+
+  m_fdMemory = memfd_create("tinymcp-shm", MFD_CLOEXEC);
+  m_fdServerNotify = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  m_fdClientNotify = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  m_fdServerSpace = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  m_fdClientSpace = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (m_fdMemory < 0 || m_fdServerNotify < 0 || m_fdClientNotify < 0 ||
+      m_fdServerSpace < 0 || m_fdClientSpace < 0) {
+    LOG_ERROR("CShmEndpoint::Create: Failed to create descriptors, "
+      "error code: {}", errno);
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  size_t nSize = SHM_HEADER_SIZE + 2 * sizeof(RingControl) + 2 * nCapacity;
+  if (ftruncate(m_fdMemory, static_cast<off_t>(nSize)) < 0) {
+    LOG_ERROR("CShmEndpoint::Create: ftruncate failed, error code: {}", errno);
+    return ERRNO_INTERNAL_ERROR;
+  }
+  void* pMapping =
+    mmap(nullptr, nSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fdMemory, 0);
+  if (pMapping == MAP_FAILED) {
+    LOG_ERROR("CShmEndpoint::Create: mmap failed, error code: {}", errno);
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  char* pBase = static_cast<char*>(pMapping);
+  auto* pHeader = reinterpret_cast<SegmentHeader*>(pBase);
+  pHeader->uMagic = SHM_MAGIC;
+  pHeader->uVersion = SHM_VERSION;
+  pHeader->ullRingCapacity = nCapacity;
+  new (pBase + SHM_HEADER_SIZE) RingControl();
+  new (pBase + SHM_HEADER_SIZE + sizeof(RingControl)) RingControl();
+  munmap(pMapping, nSize);
+
+  return Map(m_fdMemory, true);
+}
+
+int CShmEndpoint::Attach(int fdMemory, int fdServerNotify, int fdClientNotify,
+  int fdServerSpace, int fdClientSpace) {
+  m_fdMemory = fdMemory;
+  m_fdServerNotify = fdServerNotify;
+  m_fdClientNotify = fdClientNotify;
+  m_fdServerSpace = fdServerSpace;
+  m_fdClientSpace = fdClientSpace;
+  return Map(m_fdMemory, false);
+}
+
+int CShmEndpoint::GetMemoryFd() const {
+  return m_fdMemory;
+}
+
+int CShmEndpoint::GetServerNotifyFd() const {
+  return m_fdServerNotify;
+}
+
+int CShmEndpoint::GetClientNotifyFd() const {
+  return m_fdClientNotify;
+}
+
+int CShmEndpoint::GetServerSpaceFd() const {
+  return m_fdServerSpace;
+}
+
+int CShmEndpoint::GetClientSpaceFd() const {
+  return m_fdClientSpace;
+}
+
+int CShmEndpoint::Map(int fdMemory, bool bServer) {
+  struct stat st {};
+  if (fstat(fdMemory, &st) < 0 ||
+      static_cast<size_t>(st.st_size) < SHM_HEADER_SIZE) {
+    LOG_ERROR("CShmEndpoint: Invalid shared memory segment");
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  m_nMappingSize = static_cast<size_t>(st.st_size);
+  m_pMapping = mmap(
+    nullptr, m_nMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fdMemory, 0);
+  if (m_pMapping == MAP_FAILED) {
+    m_pMapping = nullptr;
+    LOG_ERROR("CShmEndpoint: mmap failed, error code: {}", errno);
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  char* pBase = static_cast<char*>(m_pMapping);
+  const auto* pHeader = reinterpret_cast<const SegmentHeader*>(pBase);
+  uint64_t ullCapacity = pHeader->ullRingCapacity;
+  if (pHeader->uMagic != SHM_MAGIC || pHeader->uVersion != SHM_VERSION ||
+      ullCapacity == 0 || (ullCapacity & (ullCapacity - 1)) != 0 ||
+      m_nMappingSize <
+        SHM_HEADER_SIZE + 2 * sizeof(RingControl) + 2 * ullCapacity) {
+    LOG_ERROR("CShmEndpoint: Unsupported shared memory segment");
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  // Ring 0 carries client to server messages, ring 1 the replies.
+  Ring rings[2];
+  for (int i = 0; i < 2; ++i) {
+    rings[i].pControl = reinterpret_cast<RingControl*>(
+      pBase + SHM_HEADER_SIZE + i * sizeof(RingControl));
+    rings[i].pData =
+      pBase + SHM_HEADER_SIZE + 2 * sizeof(RingControl) + i * ullCapacity;
+    rings[i].ullCapacity = ullCapacity;
+  }
+  rings[0].fdNotify = m_fdServerNotify;
+  rings[0].fdSpace = m_fdClientSpace;
+  rings[1].fdNotify = m_fdClientNotify;
+  rings[1].fdSpace = m_fdServerSpace;
+
+  m_bServer = bServer;
+  m_rx = bServer ? rings[0] : rings[1];
+  m_tx = bServer ? rings[1] : rings[0];
+  return ERRNO_OK;
+}
+
+void CShmEndpoint::CopyIn(
+  Ring& ring, uint64_t ullPos, const char* pSrc, size_t nSize) {
+  size_t nOffset = static_cast<size_t>(ullPos & (ring.ullCapacity - 1));
+  size_t nFirst =
+    std::min(nSize, static_cast<size_t>(ring.ullCapacity) - nOffset);
+  memcpy(ring.pData + nOffset, pSrc, nFirst);
+  memcpy(ring.pData, pSrc + nFirst, nSize - nFirst);
+}
+
+void CShmEndpoint::CopyOut(
+  const Ring& ring, uint64_t ullPos, char* pDst, size_t nSize) {
+  size_t nOffset = static_cast<size_t>(ullPos & (ring.ullCapacity - 1));
+  size_t nFirst =
+    std::min(nSize, static_cast<size_t>(ring.ullCapacity) - nOffset);
+  memcpy(pDst, ring.pData + nOffset, nFirst);
+  memcpy(pDst + nFirst, ring.pData, nSize - nFirst);
+}
+
+int CShmEndpoint::Send(
+  const std::string* pFrames, size_t nCount, int fdPeer, int fdWake) {
+  if (!m_tx.pControl) {
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  for (size_t i = 0; i < nCount; ++i) {
+    const std::string& data = pFrames[i];
+    size_t nSize = data.size();
+    if (nSize > 0 && data.back() == '\n') {
+      --nSize;
+    }
+    if (nSize == 0) {
+      continue;
+    }
+    if (nSize > m_nMaxFrameSize) {
+      LOG_ERROR("CShmEndpoint::Send: Message of {} bytes is too large", nSize);
+      return ERRNO_INTERNAL_OUTPUT_ERROR;
+    }
+
+    uint32_t uLength = static_cast<uint32_t>(nSize);
+    int iErrCode = WriteBytes(reinterpret_cast<const char*>(&uLength),
+      FRAME_LENGTH_SIZE, fdPeer, fdWake);
+    if (ERRNO_OK == iErrCode) {
+      iErrCode = WriteBytes(data.data(), nSize, fdPeer, fdWake);
+    }
+    if (ERRNO_OK != iErrCode) {
+      return iErrCode;
+    }
+  }
+  NotifyReader();
+
+  return ERRNO_OK;
+}
+
+int CShmEndpoint::WriteBytes(
+  const char* pData, size_t nSize, int fdPeer, int fdWake) {
+  RingControl* pControl = m_tx.pControl;
+  while (nSize > 0) {
+    if (m_rx.pControl->uClosed.load()) {
+      // The peer has closed its end and will not read any more.
+      return ERRNO_INTERNAL_OUTPUT_ERROR;
+    }
+
+    // The head only moves forward and never past what was written.
+    uint64_t ullHead = pControl->ullHead.load(std::memory_order_acquire);
+    if (ullHead < m_ullTxHead || ullHead > m_ullTxTail) {
+      LOG_ERROR("CShmEndpoint::Send: Invalid ring head {}, tail {}", ullHead,
+        m_ullTxTail);
+      return ERRNO_INTERNAL_OUTPUT_ERROR;
+    }
+    m_ullTxHead = ullHead;
+    size_t nFree =
+      static_cast<size_t>(m_tx.ullCapacity - (m_ullTxTail - ullHead));
+    if (nFree == 0) {
+      // Announce that this side sleeps, then check once more so space freed
+      // in between is not missed.
+      NotifyReader();
+      pControl->uWriterWaiting.store(1);
+      if (pControl->ullHead.load() != ullHead) {
+        pControl->uWriterWaiting.store(0);
+        continue;
+      }
+
+      struct pollfd fds[3];
+      fds[0].fd = m_tx.fdSpace;
+      fds[0].events = POLLIN;
+      fds[1].fd = fdPeer;
+      fds[1].events = POLLIN;
+      fds[2].fd = fdWake;
+      fds[2].events = POLLIN;
+      if (poll(fds, 3, -1) < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        LOG_ERROR("CShmEndpoint::Send: poll failed, error code: {}", errno);
+        return ERRNO_INTERNAL_OUTPUT_ERROR;
+      }
+      if (fds[1].revents != 0 || fds[2].revents != 0) {
+        return ERRNO_INTERNAL_OUTPUT_ERROR;
+      }
+      if (fds[0].revents & POLLIN) {
+        DrainEventFd(m_tx.fdSpace);
+      }
+      continue;
+    }
+
+    size_t nChunk = std::min(nFree, nSize);
+    CopyIn(m_tx, m_ullTxTail, pData, nChunk);
+    m_ullTxTail += nChunk;
+    pControl->ullTail.store(m_ullTxTail);
+    pData += nChunk;
+    nSize -= nChunk;
+  }
+
+  return ERRNO_OK;
+}
+
+void CShmEndpoint::NotifyReader() {
+  if (m_tx.pControl && m_tx.pControl->uReaderWaiting.exchange(0) == 1) {
+    SignalEventFd(m_tx.fdNotify);
+  }
+}
+
+int CShmEndpoint::Receive(std::string& data, int fdPeer, int fdWake) {
+  if (!m_rx.pControl) {
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  RingControl* pControl = m_rx.pControl;
+  bool bPeerGone = false;
+  while (true) {
+    uint64_t ullHead = m_ullRxHead;
+    uint64_t ullTail = pControl->ullTail.load(std::memory_order_acquire);
+    // The tail only moves forward and never more than a ring ahead.
+    if (ullTail < m_ullRxTail || ullTail - ullHead > m_rx.ullCapacity) {
+      LOG_ERROR("CShmEndpoint::Receive: Invalid ring tail {}, head {}",
+        ullTail, ullHead);
+      return ERRNO_INTERNAL_INPUT_ERROR;
+    }
+    m_ullRxTail = ullTail;
+    bool bProgress = false;
+
+    if (!m_bHaveLength && ullTail - ullHead >= FRAME_LENGTH_SIZE) {
+      CopyOut(m_rx, ullHead, reinterpret_cast<char*>(&m_uFrameSize),
+        FRAME_LENGTH_SIZE);
+      ullHead += FRAME_LENGTH_SIZE;
+      if (m_uFrameSize > m_nMaxFrameSize) {
+        LOG_ERROR("CShmEndpoint::Receive: Message of {} bytes is too large",
+          m_uFrameSize);
+        return ERRNO_INTERNAL_INPUT_ERROR;
+      }
+      m_bHaveLength = true;
+      m_strFrame.clear();
+      m_strFrame.reserve(m_uFrameSize);
+      bProgress = true;
+    }
+    if (m_bHaveLength) {
+      size_t nNeed = m_uFrameSize - m_strFrame.size();
+      size_t nChunk =
+        std::min(nNeed, static_cast<size_t>(ullTail - ullHead));
+      if (nChunk > 0) {
+        size_t nOld = m_strFrame.size();
+        m_strFrame.resize(nOld + nChunk);
+        CopyOut(m_rx, ullHead, &m_strFrame[nOld], nChunk);
+        ullHead += nChunk;
+        bProgress = true;
+      }
+    }
+    if (bProgress) {
+      m_ullRxHead = ullHead;
+      pControl->ullHead.store(ullHead);
+      if (pControl->uWriterWaiting.exchange(0) == 1) {
+        SignalEventFd(m_rx.fdSpace);
+      }
+    }
+
+    if (m_bHaveLength && m_strFrame.size() == m_uFrameSize) {
+      m_bHaveLength = false;
+      data.swap(m_strFrame);
+      m_strFrame.clear();
+      return ERRNO_OK;
+    }
+    if (bProgress) {
+      continue;
+    }
+
+    // Nothing to read: announce that this side sleeps, then check once more
+    // so a message published in between is not missed.
+    pControl->uReaderWaiting.store(1);
+    if (pControl->ullTail.load() != ullHead) {
+      pControl->uReaderWaiting.store(0);
+      continue;
+    }
+    if (pControl->uClosed.load() || bPeerGone) {
+      return ERRNO_INTERNAL_INPUT_TERMINATE;
+    }
+
+    struct pollfd fds[3];
+    fds[0].fd = m_rx.fdNotify;
+    fds[0].events = POLLIN;
+    fds[1].fd = fdPeer;
+    fds[1].events = POLLIN;
+    fds[2].fd = fdWake;
+    fds[2].events = POLLIN;
+    if (poll(fds, 3, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG_ERROR("CShmEndpoint::Receive: poll failed, error code: {}", errno);
+      return ERRNO_INTERNAL_INPUT_ERROR;
+    }
+    if (fds[2].revents != 0) {
+      return ERRNO_INTERNAL_INPUT_TERMINATE;
+    }
+    if (fds[0].revents & POLLIN) {
+      DrainEventFd(m_rx.fdNotify);
+    }
+    // The socket carries no data after the hand-over, so any event on it
+    // means the peer is gone. Messages it left in the ring are still read.
+    if (fds[1].revents != 0) {
+      bPeerGone = true;
+    }
+  }
+}
+
+void CShmEndpoint::MarkClosed() {
+  if (m_tx.pControl) {
+    m_tx.pControl->uClosed.store(1);
+    SignalEventFd(m_tx.fdNotify);
+  }
+}
+
+CShmChannel::CShmChannel(
+  std::unique_ptr<CShmEndpoint> upEndpoint, int fdSocket)
+  : m_upEndpoint(std::move(upEndpoint)), m_fdSocket(fdSocket) {
+  m_fdWake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+CShmChannel::~CShmChannel() {
+  CloseFd(m_fdSocket);
+  CloseFd(m_fdWake);
+}
+
+int CShmChannel::Read(std::string& data) {
+  if (!m_active) {
+    return ERRNO_INTERNAL_INPUT_TERMINATE;
+  }
+
+  int iErrCode = m_upEndpoint->Receive(data, m_fdSocket, m_fdWake);
+  if (!m_active) {
+    return ERRNO_INTERNAL_INPUT_TERMINATE;
+  }
+  if (ERRNO_OK != iErrCode && ERRNO_INTERNAL_INPUT_TERMINATE != iErrCode) {
+    // The client broke the protocol; nothing more is read or written.
+    Close();
+  }
+  return iErrCode;
+}
+
+int CShmChannel::Write(const std::string& data) {
+  if (!m_active) {
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mtxWrite);
+  int iErrCode = m_upEndpoint->Send(&data, 1, m_fdSocket, m_fdWake);
+  if (ERRNO_OK != iErrCode) {
+    Close();
+  }
+  return iErrCode;
+}
+
+int CShmChannel::WriteBatch(const std::vector<std::string>& vecData) {
+  if (!m_active) {
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mtxWrite);
+  int iErrCode =
+    m_upEndpoint->Send(vecData.data(), vecData.size(), m_fdSocket, m_fdWake);
+  if (ERRNO_OK != iErrCode) {
+    Close();
+  }
+  return iErrCode;
+}
+
+int CShmChannel::Close() {
+  if (m_active.exchange(false)) {
+    m_upEndpoint->MarkClosed();
+    SignalEventFd(m_fdWake);
+  }
+  return ERRNO_OK;
+}
+
+bool CShmChannel::IsActive() {
+  return m_active;
+}
+
+int CShmChannel::SetAttribute(
+  const std::string& key, const std::string& value) {
+  std::lock_guard<std::mutex> lock(m_mtxAttributes);
+  m_mapAttributes[key] = value;
+  return ERRNO_OK;
+}
+
+std::string CShmChannel::GetAttribute(const std::string& key) {
+  std::lock_guard<std::mutex> lock(m_mtxAttributes);
+  auto iter = m_mapAttributes.find(key);
+  if (iter != m_mapAttributes.end()) {
+    return iter->second;
+  }
+  return "";
+}
+
+CShmTransport::CShmTransport(const std::string& strPath, size_t nRingCapacity)
+  : m_strPath(strPath), m_nRingCapacity(nRingCapacity) {}
+
+CShmTransport::~CShmTransport() {
+  Stop();
+}
+
+void CShmTransport::SetPeerFilter(PeerFilter fnFilter) {
+  m_fnPeerFilter = std::move(fnFilter);
+}
+
+int CShmTransport::Start() {
+  if (m_running) {
+    return ERRNO_OK;
+  }
+
+  int iErrCode = CreateUnixListener(m_strPath, m_fdListen);
+  if (ERRNO_OK != iErrCode) {
+    return iErrCode;
+  }
+  if (m_strPath[0] != '@' &&
+      chmod(m_strPath.c_str(), S_IRUSR | S_IWUSR) < 0) {
+    LOG_ERROR("CShmTransport::Start: chmod failed, error code: {}", errno);
+    Stop();
+    return ERRNO_INTERNAL_ERROR;
+  }
+  m_fdWake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (m_fdWake < 0) {
+    LOG_ERROR("CShmTransport::Start: eventfd failed, error code: {}", errno);
+    Stop();
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  m_running = true;
+  m_upAcceptThread = std::make_unique<std::thread>([this]() { AcceptLoop(); });
+
+  LOG_INFO("CShmTransport::Start: Shared memory transport started");
+  return ERRNO_OK;
+}
+
+int CShmTransport::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_running = false;
+  }
+
+  SignalEventFd(m_fdWake);
+  if (m_upAcceptThread && m_upAcceptThread->joinable()) {
+    m_upAcceptThread->join();
+  }
+  m_upAcceptThread.reset();
+
+  std::vector<std::weak_ptr<IChannel>> vecChannels;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    vecChannels.swap(m_vecChannels);
+  }
+  for (auto& wpChannel : vecChannels) {
+    auto spChannel = wpChannel.lock();
+    if (spChannel) {
+      spChannel->Close();
+    }
+  }
+
+  bool bStarted = m_fdListen >= 0;
+  CloseFd(m_fdListen);
+  CloseFd(m_fdWake);
+  if (bStarted) {
+    RemoveUnixSocketPath(m_strPath);
+    LOG_INFO("CShmTransport::Stop: Shared memory transport stopped");
+  }
+
+  m_channelCond.notify_all();
+  return ERRNO_OK;
+}
+
+std::shared_ptr<IChannel> CShmTransport::AcceptChannel() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_channelCond.wait(
+    lock, [this]() { return !m_pendingChannels.empty() || !m_running; });
+  if (!m_running || m_pendingChannels.empty()) {
+    return nullptr;
+  }
+
+  auto channel = m_pendingChannels.front();
+  m_pendingChannels.pop();
+  return channel;
+}
+
+void CShmTransport::AcceptLoop() {
+  while (m_running) {
+    struct pollfd fds[2];
+    fds[0].fd = m_fdListen;
+    fds[0].events = POLLIN;
+    fds[1].fd = m_fdWake;
+    fds[1].events = POLLIN;
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG_ERROR("CShmTransport: poll failed, error code: {}", errno);
+      break;
+    }
+    if (!m_running || fds[1].revents != 0) {
+      break;
+    }
+
+    int fd =
+      accept4(m_fdListen, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR &&
+          errno != ECONNABORTED) {
+        LOG_ERROR("CShmTransport: accept failed, error code: {}", errno);
+      }
+      continue;
+    }
+    if (ERRNO_OK != HandOver(fd)) {
+      close(fd);
+    }
+  }
+}
+
+int CShmTransport::HandOver(int fdSocket) {
+  PeerCredentials credentials;
+  int iErrCode = ReadPeerCredentials(fdSocket, credentials);
+  if (ERRNO_OK != iErrCode) {
+    return iErrCode;
+  }
+  bool bAllowed = m_fnPeerFilter ? m_fnPeerFilter(credentials)
+    : credentials.uid == geteuid();
+  if (!bAllowed) {
+    LOG_WARNING("CShmTransport: Rejected peer pid {} uid {}", credentials.pid,
+      credentials.uid);
+    return ERRNO_INVALID_REQUEST;
+  }
+
+  auto upEndpoint = std::make_unique<CShmEndpoint>();
+  iErrCode = upEndpoint->Create(m_nRingCapacity);
+  if (ERRNO_OK != iErrCode) {
+    return iErrCode;
+  }
+
+  int fds[SHM_HANDOVER_FDS] = { upEndpoint->GetMemoryFd(),
+    upEndpoint->GetServerNotifyFd(), upEndpoint->GetClientNotifyFd(),
+    upEndpoint->GetServerSpaceFd(), upEndpoint->GetClientSpaceFd() };
+  uint32_t uVersion = SHM_VERSION;
+  struct iovec iov {
+    &uVersion, sizeof(uVersion)
+  };
+  alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(fds))] = {};
+  struct msghdr msg {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  struct cmsghdr* pCmsg = CMSG_FIRSTHDR(&msg);
+  pCmsg->cmsg_level = SOL_SOCKET;
+  pCmsg->cmsg_type = SCM_RIGHTS;
+  pCmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+  memcpy(CMSG_DATA(pCmsg), fds, sizeof(fds));
+  if (sendmsg(fdSocket, &msg, MSG_NOSIGNAL) < 0) {
+    LOG_ERROR("CShmTransport: Failed to hand over segment, error code: {}",
+      errno);
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  auto spChannel =
+    std::make_shared<CShmChannel>(std::move(upEndpoint), fdSocket);
+  spChannel->SetAttribute(ATTRIBUTE_PEER_PID, std::to_string(credentials.pid));
+  spChannel->SetAttribute(ATTRIBUTE_PEER_UID, std::to_string(credentials.uid));
+  spChannel->SetAttribute(ATTRIBUTE_PEER_GID, std::to_string(credentials.gid));
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_vecChannels.erase(
+      std::remove_if(m_vecChannels.begin(), m_vecChannels.end(),
+        [](const std::weak_ptr<IChannel>& wpChannel) {
+          return wpChannel.expired();
+        }),
+      m_vecChannels.end());
+    m_vecChannels.push_back(spChannel);
+    m_pendingChannels.push(spChannel);
+  }
+  m_channelCond.notify_one();
+
+  LOG_INFO("CShmTransport: Client pid {} connected", credentials.pid);
+  return ERRNO_OK;
+}
+
+CShmClient::~CShmClient() {
+  Close();
+}
+
+int CShmClient::Connect(const std::string& strPath) {
+  Close();
+
+  struct sockaddr_un addr {};
+  socklen_t nAddrLen = 0;
+  int iErrCode = MakeUnixAddress(strPath, addr, nAddrLen);
+  if (ERRNO_OK != iErrCode) {
+    return iErrCode;
+  }
+
+  m_fdSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (m_fdSocket < 0 ||
+      connect(m_fdSocket, reinterpret_cast<struct sockaddr*>(&addr),
+        nAddrLen) < 0) {
+    LOG_ERROR("CShmClient: Failed to connect to '{}', error code: {}", strPath,
+      errno);
+    Close();
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  int fds[SHM_HANDOVER_FDS] = { -1, -1, -1, -1, -1 };
+  uint32_t uVersion = 0;
+  struct iovec iov {
+    &uVersion, sizeof(uVersion)
+  };
+  alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(fds))] = {};
+  struct msghdr msg {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  ssize_t nReceived = 0;
+  do {
+    nReceived = recvmsg(m_fdSocket, &msg, MSG_CMSG_CLOEXEC);
+  } while (nReceived < 0 && errno == EINTR);
+
+  struct cmsghdr* pCmsg = CMSG_FIRSTHDR(&msg);
+  if (nReceived != static_cast<ssize_t>(sizeof(uVersion)) || !pCmsg ||
+      pCmsg->cmsg_type != SCM_RIGHTS ||
+      pCmsg->cmsg_len != CMSG_LEN(sizeof(fds))) {
+    LOG_ERROR("CShmClient: Invalid hand-over from '{}'", strPath);
+    Close();
+    return ERRNO_INTERNAL_ERROR;
+  }
+  memcpy(fds, CMSG_DATA(pCmsg), sizeof(fds));
+
+  m_upEndpoint = std::make_unique<CShmEndpoint>();
+  iErrCode = m_upEndpoint->Attach(fds[0], fds[1], fds[2], fds[3], fds[4]);
+  if (ERRNO_OK != iErrCode || uVersion != SHM_VERSION) {
+    Close();
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  return ERRNO_OK;
+}
+
+int CShmClient::Send(const std::string& strMessage) {
+  if (!m_upEndpoint) {
+    return ERRNO_INTERNAL_ERROR;
+  }
+  return m_upEndpoint->Send(&strMessage, 1, m_fdSocket);
+}
+
+int CShmClient::Receive(std::string& strMessage) {
+  if (!m_upEndpoint) {
+    return ERRNO_INTERNAL_ERROR;
+  }
+  return m_upEndpoint->Receive(strMessage, m_fdSocket, -1);
+}
+
+int CShmClient::Close() {
+  if (m_upEndpoint) {
+    m_upEndpoint->MarkClosed();
+    m_upEndpoint.reset();
+  }
+  CloseFd(m_fdSocket);
+  return ERRNO_OK;
+}
+
+}  // namespace MCP
+#endif
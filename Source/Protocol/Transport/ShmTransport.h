@@ -0,0 +1,187 @@
+#pragma once
+
+#if defined(__linux__)
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Channel.h"
+#include "SocketTransport.h"
+#include "Transport.h"
+
+namespace MCP {
+
+// One end of a pair of single-producer single-consumer byte rings in a
+// shared memory segment, one ring per direction. Messages are copied straight
+// into the peer's mapping as a 32-bit length followed by the JSON text. A
+// reader that finds its ring empty, or a writer that finds it full, flags
+// itself as waiting and sleeps on an eventfd, so the other side only makes a
+// syscall when someone actually sleeps. The peer can write the whole segment,
+// so its ring positions are checked against the ones kept here; a ring that
+// breaks the protocol fails the read or write.
+class CShmEndpoint {
+public:
+  static constexpr size_t DEFAULT_RING_CAPACITY = 1024 * 1024;
+  static constexpr size_t DEFAULT_MAX_FRAME_SIZE = 64 * 1024 * 1024;
+
+  CShmEndpoint() = default;
+  ~CShmEndpoint();
+  CShmEndpoint(const CShmEndpoint&) = delete;
+  CShmEndpoint& operator=(const CShmEndpoint&) = delete;
+
+  // Server side: creates the segment and the notification descriptors.
+  int Create(size_t nRingCapacity = DEFAULT_RING_CAPACITY);
+  // Client side: maps a segment received from the server.
+  int Attach(int fdMemory, int fdServerNotify, int fdClientNotify,
+    int fdServerSpace, int fdClientSpace);
+
+  int GetMemoryFd() const;
+  int GetServerNotifyFd() const;
+  int GetClientNotifyFd() const;
+  int GetServerSpaceFd() const;
+  int GetClientSpaceFd() const;
+
+  // Writes each frame as one message, waiting while the ring is full. A
+  // hang-up on fdPeer or fdWake becoming readable aborts the wait. Either
+  // descriptor may be -1.
+  int Send(const std::string* pFrames, size_t nCount, int fdPeer,
+    int fdWake = -1);
+  // Blocks until a message arrives, the peer closes its side, fdPeer reports
+  // a hang-up or fdWake becomes readable. Either descriptor may be -1.
+  int Receive(std::string& data, int fdPeer, int fdWake);
+  // Tells the peer that nothing more will be sent.
+  void MarkClosed();
+
+private:
+  struct RingControl;
+  struct Ring {
+    RingControl* pControl{ nullptr };
+    char* pData{ nullptr };
+    uint64_t ullCapacity{ 0 };
+    // Signalled for the reader once data arrives, and for the writer once
+    // space is freed.
+    int fdNotify{ -1 };
+    int fdSpace{ -1 };
+  };
+
+  int Map(int fdMemory, bool bServer);
+  static void CopyIn(
+    Ring& ring, uint64_t ullPos, const char* pSrc, size_t nSize);
+  static void CopyOut(
+    const Ring& ring, uint64_t ullPos, char* pDst, size_t nSize);
+  int WriteBytes(const char* pData, size_t nSize, int fdPeer, int fdWake);
+  void NotifyReader();
+
+  bool m_bServer{ false };
+  void* m_pMapping{ nullptr };
+  size_t m_nMappingSize{ 0 };
+  int m_fdMemory{ -1 };
+  int m_fdServerNotify{ -1 };
+  int m_fdClientNotify{ -1 };
+  int m_fdServerSpace{ -1 };
+  int m_fdClientSpace{ -1 };
+  Ring m_rx;
+  Ring m_tx;
+  // The positions this side owns, and the last ones seen from the peer.
+  uint64_t m_ullRxHead{ 0 };
+  uint64_t m_ullRxTail{ 0 };
+  uint64_t m_ullTxHead{ 0 };
+  uint64_t m_ullTxTail{ 0 };
+  size_t m_nMaxFrameSize{ DEFAULT_MAX_FRAME_SIZE };
+  // Receive state of a message that arrived only in part.
+  bool m_bHaveLength{ false };
+  uint32_t m_uFrameSize{ 0 };
+  std::string m_strFrame;
+};
+
+// Server side of a shared memory connection.
+class CShmChannel : public IChannel {
+public:
+  CShmChannel(std::unique_ptr<CShmEndpoint> upEndpoint, int fdSocket);
+  ~CShmChannel() override;
+  CShmChannel(const CShmChannel&) = delete;
+  CShmChannel& operator=(const CShmChannel&) = delete;
+
+  int Read(std::string& data) override;
+  int Write(const std::string& data) override;
+  int WriteBatch(const std::vector<std::string>& vecData) override;
+  int Close() override;
+  bool IsActive() override;
+  int SetAttribute(const std::string& key, const std::string& value) override;
+  std::string GetAttribute(const std::string& key) override;
+
+private:
+  std::unique_ptr<CShmEndpoint> m_upEndpoint;
+  // The Unix socket the segment was handed over on; it stays open only to
+  // notice when the client process goes away.
+  int m_fdSocket{ -1 };
+  int m_fdWake{ -1 };
+  std::atomic<bool> m_active{ true };
+  std::mutex m_mtxWrite;
+  std::mutex m_mtxAttributes;
+  std::map<std::string, std::string> m_mapAttributes;
+};
+
+// Serves same-host clients over shared memory. Clients connect to a Unix
+// domain socket only to receive the segment and its eventfds (SCM_RIGHTS);
+// all messages then travel through the rings. See CShmClient. The socket is
+// only accessible to the owner, and without a filter only processes of the
+// same user are served.
+class CShmTransport : public CMCPTransport {
+public:
+  explicit CShmTransport(const std::string& strPath,
+    size_t nRingCapacity = CShmEndpoint::DEFAULT_RING_CAPACITY);
+  ~CShmTransport() override;
+
+  // Replaces the same user check; rejected peers never see the segment.
+  void SetPeerFilter(PeerFilter fnFilter);
+
+  int Start() override;
+  int Stop() override;
+  std::shared_ptr<IChannel> AcceptChannel() override;
+
+private:
+  void AcceptLoop();
+  int HandOver(int fdSocket);
+
+  std::string m_strPath;
+  size_t m_nRingCapacity;
+  PeerFilter m_fnPeerFilter;
+  int m_fdListen{ -1 };
+  int m_fdWake{ -1 };
+  std::atomic<bool> m_running{ false };
+  std::unique_ptr<std::thread> m_upAcceptThread;
+  std::mutex m_mutex;
+  std::condition_variable m_channelCond;
+  std::queue<std::shared_ptr<IChannel>> m_pendingChannels;
+  std::vector<std::weak_ptr<IChannel>> m_vecChannels;
+};
+
+// Client side helper for CShmTransport.
+class CShmClient {
+public:
+  CShmClient() = default;
+  ~CShmClient();
+  CShmClient(const CShmClient&) = delete;
+  CShmClient& operator=(const CShmClient&) = delete;
+
+  int Connect(const std::string& strPath);
+  int Send(const std::string& strMessage);
+  // Blocks until the next message from the server arrives.
+  int Receive(std::string& strMessage);
+  int Close();
+
+private:
+  std::unique_ptr<CShmEndpoint> m_upEndpoint;
+  int m_fdSocket{ -1 };
+};
+
+}  // namespace MCP
+#endif
@@ -0,0 +1,874 @@
+#include "SocketTransport.h"
+
+#if defined(__linux__)
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+
+#include "../Public/Logger.h"
+#include "../Public/PublicDef.h"
+#include "IoHelper.h"
+
+namespace MCP {
+
+CSocketChannel::CSocketChannel(
+  int fd, std::weak_ptr<CIoEngine> wpEngine, size_t nMaxFrameSize)
+  : m_fd(fd), m_wpEngine(std::move(wpEngine)), m_nMaxFrameSize(nMaxFrameSize) {
+}
+
+CSocketChannel::~CSocketChannel() {
+  if (m_fd >= 0) {
+    close(m_fd);
+  }
+}
+
+int CSocketChannel::Read(std::string& data) {
+  std::unique_lock<std::mutex> lock(m_mtxInput);
+  m_bHandling = false;
+  if (!m_bDispatched) {
+    m_cvInput.wait(lock, [this]() {
+      return !m_deqFrames.empty() || m_bInputClosed || !m_active;
+    });
+  } else if (m_active && m_deqFrames.empty() && !m_bInputClosed) {
+    // The worker goes back to the pool until more input arrives.
+    return ERRNO_INTERNAL_INPUT_PENDING;
+  }
+  if (!m_active || m_deqFrames.empty()) {
+    m_bInputEnded = true;
+    return ERRNO_INTERNAL_INPUT_TERMINATE;
+  }
+
+  data = std::move(m_deqFrames.front());
+  m_deqFrames.pop_front();
+  m_nPendingBytes -= data.size();
+  m_bHandling = true;
+  if (m_bPaused && m_nPendingBytes < MAX_PENDING_INPUT / 2) {
+    m_bPaused = false;
+    lock.unlock();
+    Rearm();
+  }
+
+  return ERRNO_OK;
+}
+
+int CSocketChannel::Write(const std::string& data) {
+  if (!m_active) {
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mtxWrite);
+  if (m_bStreaming) {
+    m_vecDeferred.push_back(data);
+    return ERRNO_OK;
+  }
+
+  return WriteFrames(&data, 1);
+}
+
+int CSocketChannel::WriteBatch(const std::vector<std::string>& vecData) {
+  if (!m_active) {
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mtxWrite);
+  if (m_bStreaming) {
+    m_vecDeferred.insert(m_vecDeferred.end(), vecData.begin(), vecData.end());
+    return ERRNO_OK;
+  }
+
+  return WriteFrames(vecData.data(), vecData.size());
+}
+
+int CSocketChannel::BeginStream() {
+  if (!m_active) {
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mtxWrite);
+  if (m_bStreaming) {
+    LOG_ERROR("CSocketChannel::BeginStream: Stream already open");
+    return ERRNO_INTERNAL_ERROR;
+  }
+  m_bStreaming = true;
+
+  return ERRNO_OK;
+}
+
+int CSocketChannel::WriteStream(const std::string& data) {
+  if (!m_active) {
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mtxWrite);
+  if (!m_bStreaming) {
+    LOG_ERROR("CSocketChannel::WriteStream: No open stream");
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  std::vector<struct iovec> vecIov{ { const_cast<char*>(data.data()),
+    data.size() } };
+  return WriteSocket(vecIov);
+}
+
+int CSocketChannel::EndStream() {
+  std::lock_guard<std::mutex> lock(m_mtxWrite);
+  if (!m_bStreaming) {
+    LOG_ERROR("CSocketChannel::EndStream: No open stream");
+    return ERRNO_INTERNAL_ERROR;
+  }
+  m_bStreaming = false;
+
+  char newline = '\n';
+  std::vector<struct iovec> vecIov{ { &newline, 1 } };
+  int iErrCode = WriteSocket(vecIov);
+  if (ERRNO_OK == iErrCode && !m_vecDeferred.empty()) {
+    iErrCode = WriteFrames(m_vecDeferred.data(), m_vecDeferred.size());
+  }
+  m_vecDeferred.clear();
+
+  return iErrCode;
+}
+
+int CSocketChannel::Close() {
+  if (m_active.exchange(false)) {
+    // Wakes the reactor, which then drops the connection.
+    shutdown(m_fd, SHUT_RDWR);
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mtxInput);
+  }
+  m_cvInput.notify_all();
+  return ERRNO_OK;
+}
+
+bool CSocketChannel::IsActive() {
+  return m_active;
+}
+
+bool CSocketChannel::IsPersistent() {
+  return m_bDispatched;
+}
+
+bool CSocketChannel::IsBusy() {
+  if (!m_active) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(m_mtxInput);
+  return m_bHandling || !m_deqFrames.empty();
+}
+
+int CSocketChannel::SetAttribute(
+  const std::string& key, const std::string& value) {
+  std::lock_guard<std::mutex> lock(m_mtxAttributes);
+  m_mapAttributes[key] = value;
+  return ERRNO_OK;
+}
+
+std::string CSocketChannel::GetAttribute(const std::string& key) {
+  std::lock_guard<std::mutex> lock(m_mtxAttributes);
+  auto iter = m_mapAttributes.find(key);
+  if (iter != m_mapAttributes.end()) {
+    return iter->second;
+  }
+  return "";
+}
+
+int CSocketChannel::GetFd() const {
+  return m_fd;
+}
+
+void CSocketChannel::SetPeerCredentials(const PeerCredentials& credentials) {
+  m_peerCredentials = credentials;
+  SetAttribute(ATTRIBUTE_PEER_PID, std::to_string(credentials.pid));
+  SetAttribute(ATTRIBUTE_PEER_UID, std::to_string(credentials.uid));
+  SetAttribute(ATTRIBUTE_PEER_GID, std::to_string(credentials.gid));
+}
+
+const PeerCredentials& CSocketChannel::GetPeerCredentials() const {
+  return m_peerCredentials;
+}
+
+bool CSocketChannel::OnData(const char* pData, size_t nSize) {
+  ParseFrames(pData, nSize);
+
+  std::lock_guard<std::mutex> lock(m_mtxInput);
+  if (m_nPendingBytes >= MAX_PENDING_INPUT) {
+    // Read() resumes the socket once the session has caught up.
+    m_bPaused = true;
+    return false;
+  }
+  return true;
+}
+
+void CSocketChannel::ParseFrames(const char* pData, size_t nSize) {
+  std::vector<std::string> vecFrames;
+  auto fnEmit = [this, &vecFrames](const char* pFrame, size_t nLength) {
+    if (m_bDiscarding) {
+      m_bDiscarding = false;
+      return;
+    }
+    if (nLength > 0 && pFrame[nLength - 1] == '\r') {
+      --nLength;
+    }
+    if (nLength > 0) {
+      vecFrames.emplace_back(pFrame, nLength);
+    }
+  };
+
+  // Complete the frame started by an earlier read first; only the new bytes
+  // need to be searched for its end.
+  if (!m_strPartial.empty()) {
+    const char* pNewline = FindNewline(pData, nSize);
+    size_t nHead = pNewline ? pNewline - pData : nSize;
+    m_strPartial.append(pData, nHead);
+    if (!pNewline) {
+      nSize = 0;
+    } else {
+      fnEmit(m_strPartial.data(), m_strPartial.size());
+      m_strPartial.clear();
+      pData += nHead + 1;
+      nSize -= nHead + 1;
+    }
+  }
+
+  // Frames inside this read are taken straight from the scratch buffer.
+  while (const char* pNewline = FindNewline(pData, nSize)) {
+    size_t nLength = pNewline - pData;
+    fnEmit(pData, nLength);
+    pData += nLength + 1;
+    nSize -= nLength + 1;
+  }
+  if (nSize > 0 && !m_bDiscarding) {
+    m_strPartial.append(pData, nSize);
+  }
+
+  if (m_strPartial.size() > m_nMaxFrameSize) {
+    LOG_ERROR("CSocketChannel: Frame exceeds {} bytes, discarding",
+      m_nMaxFrameSize);
+    m_bDiscarding = true;
+    m_strPartial.clear();
+  }
+  if (m_strPartial.empty() && m_strPartial.capacity() > MAX_IDLE_BUFFER_SIZE) {
+    // Do not keep the memory of a large frame on an idle connection.
+    std::string().swap(m_strPartial);
+  }
+
+  if (vecFrames.empty()) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_mtxInput);
+    for (auto& strFrame : vecFrames) {
+      m_nPendingBytes += strFrame.size();
+      m_deqFrames.push_back(std::move(strFrame));
+    }
+  }
+  m_cvInput.notify_one();
+}
+
+void CSocketChannel::CloseInput() {
+  {
+    std::lock_guard<std::mutex> lock(m_mtxInput);
+    m_bInputClosed = true;
+  }
+  m_cvInput.notify_all();
+}
+
+void CSocketChannel::EnableDispatch() {
+  std::lock_guard<std::mutex> lock(m_mtxInput);
+  m_bDispatched = true;
+}
+
+bool CSocketChannel::BeginDispatch() {
+  std::lock_guard<std::mutex> lock(m_mtxInput);
+  if (!m_bDispatched || m_bDispatching || m_bInputEnded) {
+    return false;
+  }
+  if (m_active && m_deqFrames.empty() && !m_bInputClosed) {
+    return false;
+  }
+  m_bDispatching = true;
+  return true;
+}
+
+bool CSocketChannel::EndDispatch() {
+  std::lock_guard<std::mutex> lock(m_mtxInput);
+  if (m_bInputEnded) {
+    // Stays claimed, nothing is dispatched after the end.
+    return false;
+  }
+  if (m_active && !m_deqFrames.empty()) {
+    return true;
+  }
+  if (!m_active || m_bInputClosed) {
+    // The input ended after the handler's last Read(); it is told once
+    // more.
+    m_bInputEnded = true;
+    return true;
+  }
+  m_bDispatching = false;
+  return false;
+}
+
+void CSocketChannel::Rearm() {
+  if (!m_active) {
+    return;
+  }
+
+  if (auto spEngine = m_wpEngine.lock()) {
+    spEngine->Resume(m_fd);
+  }
+}
+
+int CSocketChannel::WriteFrames(const std::string* pFrames, size_t nCount) {
+  static char s_newline = '\n';
+
+  std::vector<struct iovec> vecIov;
+  vecIov.reserve(nCount * 2);
+  for (size_t i = 0; i < nCount; ++i) {
+    const std::string& data = pFrames[i];
+    if (data.empty()) {
+      continue;
+    }
+    vecIov.push_back({ const_cast<char*>(data.data()), data.size() });
+    if (data.back() != '\n') {
+      vecIov.push_back({ &s_newline, 1 });
+    }
+  }
+  if (vecIov.empty()) {
+    return ERRNO_OK;
+  }
+
+  return WriteSocket(vecIov);
+}
+
+int CSocketChannel::WriteSocket(std::vector<struct iovec>& vecIov) {
+  int iErrCode = WriteVector(m_fd, vecIov, true, WRITE_TIMEOUT_MS);
+  if (ERRNO_OK != iErrCode) {
+    LOG_ERROR("CSocketChannel::Write: Failed to write output, error code: {}",
+      errno);
+    Close();
+  }
+
+  return iErrCode;
+}
+
+CSocketTransport::~CSocketTransport() {
+  Stop();
+}
+
+int CSocketTransport::Start() {
+  if (m_running) {
+    return ERRNO_OK;
+  }
+
+  int iErrCode = ERRNO_OK;
+  if (m_fdAdopted >= 0) {
+    m_fdListen = m_fdAdopted;
+    m_fdAdopted = -1;
+  } else {
+    iErrCode = CreateListener(m_fdListen);
+    if (ERRNO_OK != iErrCode) {
+      return iErrCode;
+    }
+  }
+  m_bReleased = false;
+
+  m_spEngine = CIoEngine::Create();
+  iErrCode = m_spEngine->Open(m_fdListen);
+  if (ERRNO_OK != iErrCode) {
+    Stop();
+    return iErrCode;
+  }
+
+  if (m_fnDispatch) {
+    size_t nThreadCount = m_nThreadCount;
+    if (0 == nThreadCount) {
+      nThreadCount =
+        std::max<size_t>(8, std::thread::hardware_concurrency() * 2);
+    }
+    m_upPool = std::make_unique<httplib::ThreadPool>(nThreadCount);
+  }
+
+  m_running = true;
+  m_upReactorThread =
+    std::make_unique<std::thread>([this]() { m_spEngine->Run(*this); });
+
+  LOG_INFO("CSocketTransport::Start: Socket transport started ({})",
+    m_spEngine->GetName());
+  return ERRNO_OK;
+}
+
+int CSocketTransport::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_running = false;
+  }
+
+  if (m_spEngine) {
+    m_spEngine->Shutdown();
+  }
+  if (m_upReactorThread && m_upReactorThread->joinable()) {
+    m_upReactorThread->join();
+  }
+  m_upReactorThread.reset();
+
+  for (auto& connection : m_hashConnections) {
+    connection.second->Close();
+  }
+  m_hashConnections.clear();
+  m_spEngine.reset();
+  if (m_upPool) {
+    // Dispatches already queued still run, and find their channel closed.
+    m_upPool->shutdown();
+    m_upPool.reset();
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_hashOpenChannels.clear();
+  }
+
+  bool bStarted = m_fdListen >= 0;
+  if (bStarted) {
+    close(m_fdListen);
+    m_fdListen = -1;
+    if (!m_bReleased) {
+      OnStop();
+    }
+    LOG_INFO("CSocketTransport::Stop: Socket transport stopped");
+  }
+  if (m_fdAdopted >= 0) {
+    close(m_fdAdopted);
+    m_fdAdopted = -1;
+  }
+
+  m_channelCond.notify_all();
+  return ERRNO_OK;
+}
+
+std::shared_ptr<IChannel> CSocketTransport::AcceptChannel() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_channelCond.wait(
+    lock, [this]() { return !m_pendingChannels.empty() || !m_running; });
+  if (!m_running || m_pendingChannels.empty()) {
+    return nullptr;
+  }
+
+  auto channel = m_pendingChannels.front();
+  m_pendingChannels.pop();
+  return channel;
+}
+
+void CSocketTransport::SetDispatchHandler(DispatchHandler fnDispatch) {
+  m_fnDispatch = std::move(fnDispatch);
+}
+
+void CSocketTransport::SetThreadCount(size_t nThreadCount) {
+  m_nThreadCount = nThreadCount;
+}
+
+void CSocketTransport::StopAccepting() {
+  if (m_spEngine) {
+    m_spEngine->StopAccepting();
+  }
+}
+
+bool CSocketTransport::WaitIdle(
+  std::chrono::steady_clock::time_point tpDeadline) {
+  // The channels do not signal when they turn idle, so this polls.
+  while (true) {
+    bool bIdle = true;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      for (auto& channel : m_hashOpenChannels) {
+        if (channel.second->IsBusy()) {
+          bIdle = false;
+          break;
+        }
+      }
+    }
+    if (bIdle) {
+      return true;
+    }
+    if (std::chrono::steady_clock::now() >= tpDeadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(DRAIN_POLL_INTERVAL);
+  }
+}
+
+int CSocketTransport::PrepareHandoff(const std::vector<int>& vecFds) {
+  if (vecFds.size() > 1) {
+    LOG_ERROR("CSocketTransport: Took over {} listeners, expected one",
+      vecFds.size());
+    return ERRNO_INVALID_PARAMS;
+  }
+  if (vecFds.empty()) {
+    return ERRNO_OK;
+  }
+
+  int fd = vecFds[0];
+  int iListening = 0;
+  socklen_t nLen = sizeof(iListening);
+  if (getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &iListening, &nLen) < 0 ||
+      !iListening || !IsOwnListener(fd)) {
+    LOG_ERROR("CSocketTransport: Took over fd {}, not this listener", fd);
+    return ERRNO_INVALID_PARAMS;
+  }
+  // The engines expect a non-blocking listener.
+  int iFlags = fcntl(fd, F_GETFL, 0);
+  if (iFlags < 0 || fcntl(fd, F_SETFL, iFlags | O_NONBLOCK) < 0) {
+    LOG_ERROR("CSocketTransport: fcntl failed, error code: {}", errno);
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  if (m_fdAdopted >= 0) {
+    close(m_fdAdopted);
+  }
+  m_fdAdopted = fd;
+  return ERRNO_OK;
+}
+
+std::vector<int> CSocketTransport::GetListeners() {
+  std::vector<int> vecFds;
+  if (m_fdListen >= 0) {
+    vecFds.push_back(m_fdListen);
+  }
+  return vecFds;
+}
+
+void CSocketTransport::ReleaseListeners() {
+  // The socket stays open for the successor, only this engine leaves it.
+  m_bReleased = true;
+  StopAccepting();
+}
+
+int CSocketTransport::OnAccept(int fd, CSocketChannel& channel) {
+  return ERRNO_OK;
+}
+
+void CSocketTransport::OnStop() {}
+
+void CSocketTransport::OnAccepted(int fd) {
+  auto spChannel = std::make_shared<CSocketChannel>(fd, m_spEngine);
+  if (m_fnDispatch) {
+    spChannel->EnableDispatch();
+  }
+  if (ERRNO_OK != OnAccept(fd, *spChannel) ||
+      ERRNO_OK != m_spEngine->AddConnection(fd)) {
+    return;
+  }
+  m_hashConnections[fd] = spChannel;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_fnDispatch) {
+      m_pendingChannels.push(spChannel);
+    }
+    m_hashOpenChannels[fd] = spChannel;
+  }
+  m_channelCond.notify_one();
+  LOG_INFO("CSocketTransport: Connection accepted, fd: {}", fd);
+}
+
+bool CSocketTransport::OnReceived(int fd, const char* pData, size_t nSize) {
+  auto iter = m_hashConnections.find(fd);
+  if (iter == m_hashConnections.end()) {
+    return true;
+  }
+  bool bReadOn = iter->second->OnData(pData, nSize);
+  if (iter->second->BeginDispatch()) {
+    Dispatch(iter->second);
+  }
+  return bReadOn;
+}
+
+void CSocketTransport::OnClosed(int fd) {
+  auto iter = m_hashConnections.find(fd);
+  if (iter == m_hashConnections.end()) {
+    return;
+  }
+  iter->second->CloseInput();
+  if (iter->second->BeginDispatch()) {
+    Dispatch(iter->second);
+  }
+  m_spEngine->RemoveConnection(fd);
+  m_hashConnections.erase(iter);
+  {
+    // Nobody is left to answer.
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_hashOpenChannels.erase(fd);
+  }
+  LOG_INFO("CSocketTransport: Connection closed, fd: {}", fd);
+}
+
+void CSocketTransport::Dispatch(
+  const std::shared_ptr<CSocketChannel>& spChannel) {
+  // The channel stays with this worker until it has nothing left to serve,
+  // so the messages of a connection are handled one after another.
+  m_upPool->enqueue([this, spChannel]() {
+    do {
+      m_fnDispatch(spChannel);
+    } while (spChannel->EndDispatch());
+  });
+}
+
+CUnixSocketTransport::CUnixSocketTransport(const std::string& strPath)
+  : m_strPath(strPath) {}
+
+CUnixSocketTransport::~CUnixSocketTransport() {
+  Stop();
+}
+
+void CUnixSocketTransport::SetPeerFilter(PeerFilter fnFilter) {
+  m_fnPeerFilter = std::move(fnFilter);
+}
+
+int CUnixSocketTransport::CreateListener(int& fdListen) {
+  return CreateUnixListener(m_strPath, fdListen);
+}
+
+int CUnixSocketTransport::OnAccept(int fd, CSocketChannel& channel) {
+  PeerCredentials credentials;
+  int iErrCode = ReadPeerCredentials(fd, credentials);
+  if (ERRNO_OK != iErrCode) {
+    return iErrCode;
+  }
+  if (m_fnPeerFilter && !m_fnPeerFilter(credentials)) {
+    LOG_WARNING("CUnixSocketTransport: Rejected peer pid {} uid {}",
+      credentials.pid, credentials.uid);
+    return ERRNO_INVALID_REQUEST;
+  }
+  channel.SetPeerCredentials(credentials);
+
+  return ERRNO_OK;
+}
+
+bool CUnixSocketTransport::IsOwnListener(int fd) const {
+  struct sockaddr_un addr {};
+  socklen_t nAddrLen = 0;
+  if (ERRNO_OK != MakeUnixAddress(m_strPath, addr, nAddrLen)) {
+    return false;
+  }
+
+  struct sockaddr_un bound {};
+  socklen_t nBoundLen = sizeof(bound);
+  if (getsockname(fd, reinterpret_cast<struct sockaddr*>(&bound),
+        &nBoundLen) < 0) {
+    return false;
+  }
+  return nBoundLen == nAddrLen && 0 == memcmp(&bound, &addr, nAddrLen);
+}
+
+void CUnixSocketTransport::OnStop() {
+  RemoveUnixSocketPath(m_strPath);
+}
+
+CTcpTransport::CTcpTransport(const std::string& strHost, int iPort)
+  : m_strHost(strHost), m_iPort(iPort) {}
+
+CTcpTransport::~CTcpTransport() {
+  Stop();
+}
+
+void CTcpTransport::SetNoDelay(bool bNoDelay) {
+  m_bNoDelay = bNoDelay;
+}
+
+void CTcpTransport::SetKeepAlive(
+  bool bEnable, int iIdleSeconds, int iIntervalSeconds, int iProbeCount) {
+  m_bKeepAlive = bEnable;
+  m_iKeepIdle = iIdleSeconds;
+  m_iKeepInterval = iIntervalSeconds;
+  m_iKeepCount = iProbeCount;
+}
+
+int CTcpTransport::CreateListener(int& fdListen) {
+  struct addrinfo hints {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+  struct addrinfo* pResult = nullptr;
+  std::string strPort = std::to_string(m_iPort);
+  int iRet = getaddrinfo(m_strHost.empty() ? nullptr : m_strHost.c_str(),
+    strPort.c_str(), &hints, &pResult);
+  if (iRet != 0) {
+    LOG_ERROR("CTcpTransport: Failed to resolve '{}': {}", m_strHost,
+      gai_strerror(iRet));
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  int fd = -1;
+  for (auto* pInfo = pResult; pInfo && fd < 0; pInfo = pInfo->ai_next) {
+    fd = socket(pInfo->ai_family,
+      pInfo->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, pInfo->ai_protocol);
+    if (fd < 0) {
+      continue;
+    }
+    int iOn = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &iOn, sizeof(iOn));
+    if (bind(fd, pInfo->ai_addr, pInfo->ai_addrlen) < 0 ||
+        listen(fd, SOMAXCONN) < 0) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(pResult);
+
+  if (fd < 0) {
+    LOG_ERROR("CTcpTransport: Failed to listen on {}:{}, error code: {}",
+      m_strHost, m_iPort, errno);
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  LOG_INFO("CTcpTransport: Listening on {}:{}", m_strHost, m_iPort);
+  fdListen = fd;
+  return ERRNO_OK;
+}
+
+bool CTcpTransport::IsOwnListener(int fd) const {
+  // The host may resolve differently from one run to the next, so only the
+  // port is compared.
+  struct sockaddr_storage bound {};
+  socklen_t nBoundLen = sizeof(bound);
+  if (getsockname(fd, reinterpret_cast<struct sockaddr*>(&bound),
+        &nBoundLen) < 0) {
+    return false;
+  }
+  if (bound.ss_family == AF_INET) {
+    auto* pAddr = reinterpret_cast<struct sockaddr_in*>(&bound);
+    return ntohs(pAddr->sin_port) == m_iPort;
+  }
+  if (bound.ss_family == AF_INET6) {
+    auto* pAddr = reinterpret_cast<struct sockaddr_in6*>(&bound);
+    return ntohs(pAddr->sin6_port) == m_iPort;
+  }
+  return false;
+}
+
+int CTcpTransport::OnAccept(int fd, CSocketChannel& channel) {
+  int iOn = 1;
+  if (m_bNoDelay &&
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &iOn, sizeof(iOn)) < 0) {
+    LOG_WARNING("CTcpTransport: TCP_NODELAY failed, error code: {}", errno);
+  }
+  if (m_bKeepAlive) {
+    // Lets the kernel find peers that vanished without closing, so their
+    // sessions do not stay around forever.
+    if (setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &iOn, sizeof(iOn)) < 0 ||
+        setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &m_iKeepIdle,
+          sizeof(m_iKeepIdle)) < 0 ||
+        setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &m_iKeepInterval,
+          sizeof(m_iKeepInterval)) < 0 ||
+        setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &m_iKeepCount,
+          sizeof(m_iKeepCount)) < 0) {
+      LOG_WARNING("CTcpTransport: Failed to enable keepalive, error code: {}",
+        errno);
+    }
+  }
+
+  struct sockaddr_storage addr {};
+  socklen_t nAddrLen = sizeof(addr);
+  if (getpeername(fd, reinterpret_cast<struct sockaddr*>(&addr), &nAddrLen) ==
+      0) {
+    char szHost[NI_MAXHOST] = { 0 };
+    char szPort[NI_MAXSERV] = { 0 };
+    if (getnameinfo(reinterpret_cast<struct sockaddr*>(&addr), nAddrLen,
+          szHost, sizeof(szHost), szPort, sizeof(szPort),
+          NI_NUMERICHOST | NI_NUMERICSERV) == 0) {
+      channel.SetAttribute(
+        ATTRIBUTE_PEER_ADDRESS, std::string(szHost) + ":" + szPort);
+    }
+  }
+
+  return ERRNO_OK;
+}
+
+int MakeUnixAddress(const std::string& strPath, struct sockaddr_un& addr,
+  socklen_t& nAddrLen) {
+  addr = {};
+  addr.sun_family = AF_UNIX;
+  if (strPath.empty() || strPath.size() >= sizeof(addr.sun_path)) {
+    LOG_ERROR("Invalid Unix socket path '{}'", strPath);
+    return ERRNO_INTERNAL_ERROR;
+  }
+  memcpy(addr.sun_path, strPath.data(), strPath.size());
+  nAddrLen = static_cast<socklen_t>(
+    offsetof(struct sockaddr_un, sun_path) + strPath.size());
+  if (strPath[0] == '@') {
+    addr.sun_path[0] = '\0';
+  } else {
+    nAddrLen += 1;
+  }
+
+  return ERRNO_OK;
+}
+
+int CreateUnixListener(const std::string& strPath, int& fdListen) {
+  struct sockaddr_un addr {};
+  socklen_t nAddrLen = 0;
+  int iErrCode = MakeUnixAddress(strPath, addr, nAddrLen);
+  if (ERRNO_OK != iErrCode) {
+    return iErrCode;
+  }
+  if (strPath[0] != '@') {
+    // Remove a socket left behind by a previous run, but nothing else.
+    struct stat st {};
+    if (stat(strPath.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+      unlink(strPath.c_str());
+    }
+  }
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    LOG_ERROR("CreateUnixListener: socket failed, error code: {}", errno);
+    return ERRNO_INTERNAL_ERROR;
+  }
+  if (bind(fd, reinterpret_cast<struct sockaddr*>(&addr), nAddrLen) < 0 ||
+      listen(fd, SOMAXCONN) < 0) {
+    LOG_ERROR("CreateUnixListener: Failed to listen on '{}', error code: {}",
+      strPath, errno);
+    close(fd);
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  LOG_INFO("CreateUnixListener: Listening on '{}'", strPath);
+  fdListen = fd;
+  return ERRNO_OK;
+}
+
+void RemoveUnixSocketPath(const std::string& strPath) {
+  if (!strPath.empty() && strPath[0] != '@') {
+    unlink(strPath.c_str());
+  }
+}
+
+int ReadPeerCredentials(int fd, PeerCredentials& credentials) {
+  struct ucred cred {};
+  socklen_t nLen = sizeof(cred);
+  if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &nLen) < 0) {
+    LOG_ERROR("ReadPeerCredentials: SO_PEERCRED failed, error code: {}",
+      errno);
+    return ERRNO_INTERNAL_ERROR;
+  }
+
+  credentials.pid = cred.pid;
+  credentials.uid = cred.uid;
+  credentials.gid = cred.gid;
+  return ERRNO_OK;
+}
+
+}  // namespace MCP
+#endif
@@ -0,0 +1,256 @@
+#pragma once
+
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Channel.h"
+#include "IoEngine.h"
+#include "Transport.h"
+
+namespace MCP {
+
+// Identity of the process on the other end of a Unix domain socket, as
+// reported by the kernel (SO_PEERCRED).
+struct PeerCredentials {
+  pid_t pid{ -1 };
+  uid_t uid{ static_cast<uid_t>(-1) };
+  gid_t gid{ static_cast<gid_t>(-1) };
+};
+
+// Decides whether a local peer may connect.
+using PeerFilter = std::function<bool(const PeerCredentials&)>;
+
+// Helpers shared by the transports that listen on a Unix domain socket. A
+// path starting with '@' names a socket in the abstract namespace.
+int MakeUnixAddress(
+  const std::string& strPath, struct sockaddr_un& addr, socklen_t& nAddrLen);
+int CreateUnixListener(const std::string& strPath, int& fdListen);
+void RemoveUnixSocketPath(const std::string& strPath);
+int ReadPeerCredentials(int fd, PeerCredentials& credentials);
+
+// A newline-delimited JSON-RPC connection on a stream socket. The reactor
+// thread of the transport reads the socket and queues complete frames, Read()
+// hands them to the session thread. A dispatched channel is served by one
+// worker of the transport at a time, and Read() returns
+// ERRNO_INTERNAL_INPUT_PENDING instead of waiting once the queue is empty.
+// Writes go out on the calling thread.
+class CSocketChannel : public IChannel {
+public:
+  static constexpr size_t DEFAULT_MAX_FRAME_SIZE = 64 * 1024 * 1024;
+  // The socket is not read while this much input is waiting for Read(), so a
+  // slow session pushes back on its peer instead of buffering without limit.
+  static constexpr size_t MAX_PENDING_INPUT = 4 * 1024 * 1024;
+
+  CSocketChannel(int fd, std::weak_ptr<CIoEngine> wpEngine,
+    size_t nMaxFrameSize = DEFAULT_MAX_FRAME_SIZE);
+  ~CSocketChannel() override;
+  CSocketChannel(const CSocketChannel&) = delete;
+  CSocketChannel& operator=(const CSocketChannel&) = delete;
+
+  int Read(std::string& data) override;
+  int Write(const std::string& data) override;
+  int Close() override;
+  bool IsActive() override;
+  int SetAttribute(const std::string& key, const std::string& value) override;
+  std::string GetAttribute(const std::string& key) override;
+  int WriteBatch(const std::vector<std::string>& vecData) override;
+  int BeginStream() override;
+  int WriteStream(const std::string& data) override;
+  int EndStream() override;
+  bool IsPersistent() override;
+
+  int GetFd() const;
+  // Whether input waits for the session or it still handles a message.
+  bool IsBusy();
+  void SetPeerCredentials(const PeerCredentials& credentials);
+  const PeerCredentials& GetPeerCredentials() const;
+
+  // Called on the engine thread with bytes read from the socket. Returns
+  // false while too much input is waiting for Read().
+  bool OnData(const char* pData, size_t nSize);
+  // Called on the engine thread once the peer is gone.
+  void CloseInput();
+
+  // Called before the connection is read.
+  void EnableDispatch();
+  // Claims the channel for a worker if input waits for one or the input
+  // ended. EndDispatch() releases it after the handler returned, unless
+  // there is more to serve, in which case the worker calls it again.
+  bool BeginDispatch();
+  bool EndDispatch();
+
+private:
+  static constexpr size_t MAX_IDLE_BUFFER_SIZE = 4 * 1024;
+  // A peer that takes no bytes for this long is dropped.
+  static constexpr int WRITE_TIMEOUT_MS = 30 * 1000;
+
+  void ParseFrames(const char* pData, size_t nSize);
+  void Rearm();
+  int WriteFrames(const std::string* pFrames, size_t nCount);
+  // Closes the connection when the write fails or times out.
+  int WriteSocket(std::vector<struct iovec>& vecIov);
+
+  int m_fd{ -1 };
+  std::weak_ptr<CIoEngine> m_wpEngine;
+  std::atomic<bool> m_active{ true };
+  PeerCredentials m_peerCredentials;
+  std::mutex m_mtxAttributes;
+  std::map<std::string, std::string> m_mapAttributes;
+  // Only used on the engine thread. Holds just the incomplete frame at the
+  // end of the last read, so idle connections keep no read buffer.
+  std::string m_strPartial;
+  size_t m_nMaxFrameSize{ DEFAULT_MAX_FRAME_SIZE };
+  bool m_bDiscarding{ false };
+  // Frames waiting for Read().
+  std::mutex m_mtxInput;
+  std::condition_variable m_cvInput;
+  std::deque<std::string> m_deqFrames;
+  size_t m_nPendingBytes{ 0 };
+  bool m_bPaused{ false };
+  bool m_bInputClosed{ false };
+  // Set from one Read() to the next.
+  bool m_bHandling{ false };
+  bool m_bDispatched{ false };
+  // A worker owns the channel.
+  bool m_bDispatching{ false };
+  // The handler has been told that the input ended; it gets no more.
+  bool m_bInputEnded{ false };
+  // Same role as in CStdioChannel.
+  std::mutex m_mtxWrite;
+  bool m_bStreaming{ false };
+  std::vector<std::string> m_vecDeferred;
+};
+
+// Base of the stream socket transports. One thread runs the I/O engine,
+// which accepts connections and reads every socket; each connection becomes
+// a channel that the server runs as a session of its own. With a dispatch
+// handler set, the frames of a connection are served by a shared pool of
+// workers as they arrive, so an idle connection holds no thread, only its
+// socket and session. Without one, AcceptChannel() hands out the channels
+// and each session parks a thread in Read().
+class CSocketTransport : public CMCPTransport, private IIoHandler {
+public:
+  ~CSocketTransport() override;
+
+  int Start() override;
+  int Stop() override;
+  std::shared_ptr<IChannel> AcceptChannel() override;
+  void SetDispatchHandler(DispatchHandler fnDispatch) override;
+  // Workers of the dispatch pool; 0 picks twice the number of cores, at
+  // least 8. Call before Start().
+  void SetThreadCount(size_t nThreadCount);
+  // Connections stay open while draining; they are idle once no message is
+  // waiting or handled.
+  void StopAccepting() override;
+  bool WaitIdle(std::chrono::steady_clock::time_point tpDeadline) override;
+  // Hands over the one listening socket.
+  int PrepareHandoff(const std::vector<int>& vecFds) override;
+  std::vector<int> GetListeners() override;
+  void ReleaseListeners() override;
+
+protected:
+  CSocketTransport() = default;
+
+  // Creates the non-blocking listening socket.
+  virtual int CreateListener(int& fdListen) = 0;
+  // Whether a listening socket taken over is bound to this transport's
+  // address.
+  virtual bool IsOwnListener(int fd) const = 0;
+  // Called for each accepted connection before it is handed out; returning
+  // an error closes the connection.
+  virtual int OnAccept(int fd, CSocketChannel& channel);
+  virtual void OnStop();
+
+private:
+  static constexpr std::chrono::milliseconds DRAIN_POLL_INTERVAL{ 10 };
+
+  void OnAccepted(int fd) override;
+  bool OnReceived(int fd, const char* pData, size_t nSize) override;
+  void OnClosed(int fd) override;
+  void Dispatch(const std::shared_ptr<CSocketChannel>& spChannel);
+
+  int m_fdListen{ -1 };
+  // Taken over from the process this one replaces, served by Start().
+  int m_fdAdopted{ -1 };
+  // Handed to a successor, which owns the socket path now.
+  std::atomic<bool> m_bReleased{ false };
+  std::shared_ptr<CIoEngine> m_spEngine;
+  std::atomic<bool> m_running{ false };
+  std::unique_ptr<std::thread> m_upReactorThread;
+  DispatchHandler m_fnDispatch;
+  size_t m_nThreadCount{ 0 };
+  std::unique_ptr<httplib::ThreadPool> m_upPool;
+  // Only used on the engine thread while it runs.
+  std::unordered_map<int, std::shared_ptr<CSocketChannel>> m_hashConnections;
+  std::mutex m_mutex;
+  std::condition_variable m_channelCond;
+  std::queue<std::shared_ptr<IChannel>> m_pendingChannels;
+  // The open connections again, for WaitIdle() on other threads.
+  std::unordered_map<int, std::shared_ptr<CSocketChannel>> m_hashOpenChannels;
+};
+
+// Serves local clients on a Unix domain socket.
+class CUnixSocketTransport : public CSocketTransport {
+public:
+  explicit CUnixSocketTransport(const std::string& strPath);
+  ~CUnixSocketTransport() override;
+
+  // Connections from peers the filter rejects are closed right away.
+  void SetPeerFilter(PeerFilter fnFilter);
+
+protected:
+  int CreateListener(int& fdListen) override;
+  bool IsOwnListener(int fd) const override;
+  int OnAccept(int fd, CSocketChannel& channel) override;
+  void OnStop() override;
+
+private:
+  std::string m_strPath;
+  PeerFilter m_fnPeerFilter;
+};
+
+// Serves newline-delimited JSON-RPC on plain TCP connections, for clients
+// that need neither HTTP nor a local socket.
+class CTcpTransport : public CSocketTransport {
+public:
+  CTcpTransport(const std::string& strHost, int iPort);
+  ~CTcpTransport() override;
+
+  // Both are on by default. Call before Start().
+  void SetNoDelay(bool bNoDelay);
+  void SetKeepAlive(bool bEnable, int iIdleSeconds = 60,
+    int iIntervalSeconds = 10, int iProbeCount = 6);
+
+protected:
+  int CreateListener(int& fdListen) override;
+  bool IsOwnListener(int fd) const override;
+  int OnAccept(int fd, CSocketChannel& channel) override;
+
+private:
+  std::string m_strHost;
+  int m_iPort;
+  bool m_bNoDelay{ true };
+  bool m_bKeepAlive{ true };
+  int m_iKeepIdle{ 60 };
+  int m_iKeepInterval{ 10 };
+  int m_iKeepCount{ 6 };
+};
+
+}  // namespace MCP
+#endif
@@ -1,9 +1,26 @@
 #include "Transport.h"
 
+#ifndef _WIN32
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#if defined(CPPHTTPLIB_OPENSSL_SUPPORT)
+#include <openssl/rand.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
 #include <chrono>
-#include <future>
+#include <deque>
 #include <thread>
 
+#include "../Public/Compression.h"
 #include "../Public/Logger.h"
 #include "../Public/PublicDef.h"
 
@@ -11,7 +28,78 @@
 
 namespace MCP {
 
-CStdioTransport::CStdioTransport() : m_channelCreated(false) {}
+static constexpr const char* JSON_CONTENT_TYPE = "application/json";
+static constexpr const char* SSE_CONTENT_TYPE = "text/event-stream";
+static constexpr const char SSE_KEEPALIVE[] = ": keepalive\n\n";
+static constexpr std::chrono::seconds SSE_KEEPALIVE_INTERVAL{ 15 };
+static constexpr const char* PARSE_ERROR_RESPONSE =
+  "{\"error\":{\"code\":-32700,\"message\":\"parse error\"},"
+  "\"id\":null,\"jsonrpc\":\"2.0\"}";
+static constexpr const char* SESSION_NOT_FOUND_RESPONSE =
+  "{\"error\":{\"code\":-32001,\"message\":\"session not found\"},"
+  "\"id\":null,\"jsonrpc\":\"2.0\"}";
+static constexpr const char* TOO_LARGE_RESPONSE =
+  "{\"error\":{\"code\":-32600,\"message\":\"request too large\"},"
+  "\"id\":null,\"jsonrpc\":\"2.0\"}";
+
+// A forwarded request waits this long for the owner to answer; tool calls
+// may run for a while before the first byte.
+static constexpr std::chrono::seconds FORWARD_READ_TIMEOUT{ 60 * 60 };
+// Chunks of a forwarded response held for a slow client before the owner is
+// read again.
+static constexpr size_t FORWARD_MAX_PENDING_CHUNKS = 64;
+// Idle keep-alive connections kept to each other worker.
+static constexpr size_t FORWARD_MAX_IDLE_CLIENTS = 8;
+// OpenSSL takes a key name, an HMAC key and an AES key.
+static constexpr size_t TLS_TICKET_KEYS_SIZE = 80;
+
+// A server that can also listen on a socket taken over from another
+// process: httplib only listens on sockets it binds itself, keeping them in
+// the protected svr_sock_.
+template <class TServer>
+class CListenerServer : public TServer {
+public:
+  using TServer::TServer;
+
+  void AdoptListener(socket_t fd) { this->svr_sock_ = fd; }
+};
+
+// A response relayed from the worker owning a session. The request runs on
+// a relay thread, so the head is sent on while the body still arrives.
+struct ForwardedResponse {
+  std::mutex mutex;
+  std::condition_variable cond;
+  bool has_head{ false };
+  int status{ 0 };
+  httplib::Headers headers;
+  std::deque<std::string> chunks;
+  bool done{ false };
+  bool aborted{ false };
+};
+
+static bool EqualsIgnoreCase(
+  std::string_view strLeft, std::string_view strRight) {
+  return strLeft.size() == strRight.size() &&
+         std::equal(strLeft.begin(), strLeft.end(), strRight.begin(),
+           [](unsigned char chLeft, unsigned char chRight) {
+             return std::tolower(chLeft) == std::tolower(chRight);
+           });
+}
+
+// Headers of one connection that are not relayed to the next.
+static bool IsHopByHopHeader(std::string_view strName) {
+  static constexpr std::string_view HOP_BY_HOP_HEADERS[] = { "Connection",
+    "Content-Length", "Host", "Keep-Alive", "Transfer-Encoding" };
+  for (auto strHeader : HOP_BY_HOP_HEADERS) {
+    if (EqualsIgnoreCase(strName, strHeader)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+CStdioTransport::CStdioTransport(StdioFraming eFraming)
+  : m_channelCreated(false), m_eFraming(eFraming) {}
 
 int CStdioTransport::Start() {
   LOG_INFO("CStdioTransport::Start: Stdio transport started");
@@ -27,16 +115,159 @@ std::shared_ptr<IChannel> CStdioTransport::AcceptChannel() {
   if (!m_channelCreated) {
     m_channelCreated = true;
     LOG_INFO("CStdioTransport::AcceptChannel: Creating stdio channel");
-    return std::make_shared<CStdioChannel>();
+    return std::make_shared<CStdioChannel>(m_eFraming);
   }
   return nullptr;
 }
 
-CHttpTransport::CHttpTransport(const std::string& host, int port)
-  : m_strHost(host), m_nPort(port), m_running(false) {}
+// Worker pool of the HTTP server that refuses connections over the limit.
+// httplib closes a connection right after accepting it when enqueue fails.
+class CHttpTaskQueue : public httplib::TaskQueue {
+public:
+  CHttpTaskQueue(size_t nThreadCount, size_t nMaxQueued, size_t nMaxConnections)
+    : m_pool(nThreadCount, nMaxQueued), m_nMaxConnections(nMaxConnections) {}
+
+  bool enqueue(std::function<void()> fn) override {
+    if (m_nMaxConnections > 0 && ++m_nConnections > m_nMaxConnections) {
+      --m_nConnections;
+      LOG_DEBUG("CHttpTransport: Connection limit reached, connection closed");
+      return false;
+    }
+
+    bool bQueued = m_pool.enqueue([this, fn = std::move(fn)]() {
+      fn();
+      if (m_nMaxConnections > 0) {
+        --m_nConnections;
+      }
+    });
+    if (!bQueued) {
+      if (m_nMaxConnections > 0) {
+        --m_nConnections;
+      }
+      LOG_DEBUG("CHttpTransport: Worker queue full, connection closed");
+    }
+    return bQueued;
+  }
+
+  void shutdown() override {
+    m_pool.shutdown();
+  }
+
+private:
+  httplib::ThreadPool m_pool;
+  size_t m_nMaxConnections;
+  std::atomic<size_t> m_nConnections{ 0 };
+};
+
+CHttpTransport::CHttpTransport(
+  const std::string& host, int port, const HttpTransportOptions& options)
+  : m_strHost(host),
+    m_nPort(port),
+    m_options(options),
+    m_running(false),
+    m_spSessions(std::make_shared<CHttpSessionTable>()) {}
 
 CHttpTransport::~CHttpTransport() {
   Stop();
+#ifndef _WIN32
+  // Taken over, but never served on.
+  if (m_fdAdopted >= 0) {
+    close(m_fdAdopted);
+  }
+#endif
+}
+
+#if defined(CPPHTTPLIB_OPENSSL_SUPPORT)
+// Ticket keys are OpenSSL's own unless strTicketKeys is set.
+static int ConfigureTlsContext(SSL_CTX* pContext, const HttpTlsOptions& tls,
+  const std::string& strTicketKeys) {
+  if (!tls.strCipherList.empty() &&
+      SSL_CTX_set_cipher_list(pContext, tls.strCipherList.c_str()) != 1) {
+    LOG_ERROR("CHttpTransport: Invalid cipher list '{}'", tls.strCipherList);
+    return ERRNO_INVALID_PARAMS;
+  }
+  if (!tls.strCipherSuites.empty() &&
+      SSL_CTX_set_ciphersuites(pContext, tls.strCipherSuites.c_str()) != 1) {
+    LOG_ERROR(
+      "CHttpTransport: Invalid cipher suites '{}'", tls.strCipherSuites);
+    return ERRNO_INVALID_PARAMS;
+  }
+
+  static constexpr unsigned char SESSION_ID_CONTEXT[] = "tinymcp";
+  SSL_CTX_set_session_id_context(
+    pContext, SESSION_ID_CONTEXT, sizeof(SESSION_ID_CONTEXT) - 1);
+  SSL_CTX_set_timeout(pContext, static_cast<long>(tls.sessionTimeout.count()));
+  if (tls.bSessionCache) {
+    SSL_CTX_set_session_cache_mode(pContext, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_sess_set_cache_size(
+      pContext, static_cast<long>(tls.nSessionCacheSize));
+  } else {
+    SSL_CTX_set_session_cache_mode(pContext, SSL_SESS_CACHE_OFF);
+  }
+  if (tls.bSessionTickets) {
+    SSL_CTX_clear_options(pContext, SSL_OP_NO_TICKET);
+  } else {
+    SSL_CTX_set_options(pContext, SSL_OP_NO_TICKET);
+    // TLS 1.3 resumes with tickets only, even when they come from the cache.
+    if (!tls.bSessionCache) {
+      SSL_CTX_set_num_tickets(pContext, 0);
+    }
+  }
+  if (!strTicketKeys.empty() &&
+      SSL_CTX_set_tlsext_ticket_keys(pContext,
+        const_cast<char*>(strTicketKeys.data()),
+        static_cast<long>(strTicketKeys.size())) != 1) {
+    LOG_ERROR("CHttpTransport: Failed to set the session ticket keys");
+    return ERRNO_INTERNAL_ERROR;
+  }
+  return ERRNO_OK;
+}
+#endif
+
+template <class TServer>
+void CHttpTransport::UseAdoptedListener(TServer& server) {
+  // httplib closes it once it stops.
+  if (m_fdAdopted >= 0) {
+    server.AdoptListener(m_fdAdopted);
+    m_fdListen = m_fdAdopted;
+    m_fdAdopted = -1;
+  }
+}
+
+int CHttpTransport::CreateServer() {
+  const auto& tls = m_options.tls;
+  if (tls.strCertFile.empty()) {
+    auto spServer = std::make_unique<CListenerServer<httplib::Server>>();
+    UseAdoptedListener(*spServer);
+    m_server = std::move(spServer);
+    return ERRNO_OK;
+  }
+
+#if defined(CPPHTTPLIB_OPENSSL_SUPPORT)
+  auto spServer = std::make_unique<CListenerServer<httplib::SSLServer>>(
+    tls.strCertFile.c_str(), tls.strKeyFile.c_str(), nullptr, nullptr,
+    tls.strKeyPassword.empty() ? nullptr : tls.strKeyPassword.c_str());
+  if (!spServer->is_valid()) {
+    LOG_ERROR("CHttpTransport: Failed to load certificate {} and key {}",
+      tls.strCertFile, tls.strKeyFile);
+    return ERRNO_INVALID_PARAMS;
+  }
+  int iErrCode =
+    ConfigureTlsContext(spServer->ssl_context(), tls, m_strTicketKeys);
+  if (ERRNO_OK != iErrCode) {
+    return iErrCode;
+  }
+
+  LOG_INFO("CHttpTransport: TLS enabled, session cache {}, tickets {}",
+    tls.bSessionCache ? "on" : "off", tls.bSessionTickets ? "on" : "off");
+  UseAdoptedListener(*spServer);
+  m_server = std::move(spServer);
+  return ERRNO_OK;
+#else
+  LOG_ERROR("CHttpTransport: A certificate is set, but httplib was built "
+            "without OpenSSL");
+  return ERRNO_INVALID_PARAMS;
+#endif
 }
 
 int CHttpTransport::Start() {
@@ -44,76 +275,839 @@ int CHttpTransport::Start() {
     "CHttpTransport::Start: Starting HTTP server {}:{}", m_strHost, m_nPort);
 
   try {
-    m_server = std::make_unique<httplib::Server>();
+    m_fdListen = -1;
+    int iErrCode = CreateServer();
+    if (ERRNO_OK != iErrCode) {
+      return iErrCode;
+    }
+    ConfigureServer(*m_server);
+    RegisterHandlers(*m_server);
+#ifndef _WIN32
+    // Replaces httplib's default options, so address reuse is set here too.
+    // Only listening sockets are configured, and the last one is the one
+    // bound.
+    bool bReusePort = m_options.bReusePort || m_nWorkers > 1;
+    m_server->set_socket_options([this, bReusePort](socket_t sock) {
+      int iYes = 1;
+      setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &iYes, sizeof(iYes));
+#ifdef SO_REUSEPORT
+      if (bReusePort) {
+        setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &iYes, sizeof(iYes));
+      }
+#endif
+      m_fdListen = sock;
+    });
+#endif
+
+    if (m_fdListen < 0 && !m_server->bind_to_port(m_strHost, m_nPort)) {
+      LOG_ERROR("CHttpTransport::Start: Failed to bind {}:{}", m_strHost,
+        m_nPort);
+      return ERRNO_INTERNAL_ERROR;
+    }
+#ifndef _WIN32
+    // httplib listens with a fixed backlog; listening again resizes it.
+    if (m_fdListen >= 0 && listen(m_fdListen, m_options.iListenBacklog) < 0) {
+      LOG_WARNING("CHttpTransport::Start: Failed to set the listen backlog, "
+                  "error code: {}",
+        errno);
+    }
+#endif
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_running = true;
+      m_bDraining = false;
+      ++m_nServing;
+    }
+    m_serverThread =
+      std::make_unique<std::thread>([this]() { RunServer(*m_server); });
 
-    m_server->Post("/", [this](
-                          const httplib::Request& req, httplib::Response& res) {
-      LOG_INFO(
-        "CHttpTransport::Start: POST request received, body {}", req.body);
+    for (int i = 0; i < 50; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      if (m_server && m_server->is_running()) {
+        LOG_INFO("CHttpTransport::Start: HTTP server started successfully");
+        return m_nWorkers > 1 ? StartWorkerServer() : ERRNO_OK;
+      }
+    }
 
-      auto context = std::make_shared<ConnectionContext>();
-      context->request_body = req.body;
-      context->has_request = true;
+    LOG_ERROR("CHttpTransport::Start: HTTP server startup timeout");
+    m_running = false;
+    return ERRNO_INTERNAL_ERROR;
+  } catch (const std::exception& e) {
+    LOG_ERROR("CHttpTransport::Start: Exception: {}", e.what());
+    m_running = false;
+    return ERRNO_INTERNAL_ERROR;
+  }
+}
 
-      for (const auto& header : req.headers) {
-        context->request_header[header.first] = header.second;
+void CHttpTransport::RegisterHandlers(httplib::Server& server) {
+  server.Post("/", [this](const httplib::Request& req, httplib::Response& res,
+                    const httplib::ContentReader& contentReader) {
+    // The body is read straight into the context. httplib answers a
+    // Content-Length over nPayloadMaxLength with 413 before reading it;
+    // chunked bodies are stopped here once they grow past the limit.
+    auto context = std::make_shared<ConnectionContext>();
+    std::string& strBody = context->request_body;
+    size_t nContentLength = req.get_header_value_u64("Content-Length");
+    if (nContentLength <= m_options.nPayloadMaxLength) {
+      strBody.reserve(nContentLength);
+    }
+    bool bTooLarge = false;
+    bool bRead = contentReader([&](const char* pData, size_t nSize) {
+      if (nSize > m_options.nPayloadMaxLength - strBody.size()) {
+        bTooLarge = true;
+        return false;
       }
+      strBody.append(pData, nSize);
+      return true;
+    });
+    if (bTooLarge || (!bRead && res.status == 413)) {
+      LOG_WARNING("CHttpTransport::Start: Request body from {} is over {} "
+                  "bytes, rejected",
+        req.remote_addr, m_options.nPayloadMaxLength);
+      res.set_content(TOO_LARGE_RESPONSE, JSON_CONTENT_TYPE);
+      res.status = 413;
+      return;
+    }
+    if (!bRead) {
+      LOG_WARNING("CHttpTransport::Start: Failed to read request body");
+      res.status = 400;
+      return;
+    }
+
+    LOG_INFO("CHttpTransport::Start: POST request received, {} bytes",
+      strBody.size());
+    LOG_TRACE("CHttpTransport::Start: Request body: {}", strBody);
+
+    context->session_id = req.get_header_value(HEADER_SESSION_ID);
+    size_t nOwner = 0;
+    if (IsForeignSession(context->session_id, nOwner)) {
+      ForwardRequest(nOwner, req, strBody, res);
+      return;
+    }
+
+    MessageHead head;
+    if (!PeekMessageHead(strBody, head)) {
+      res.set_content(PARSE_ERROR_RESPONSE, JSON_CONTENT_TYPE);
+      res.status = 400;
+      return;
+    }
 
-      auto channel = std::make_shared<CHttpChannel>(context);
-      {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        m_pendingChannels.push(channel);
-        m_channelCond.notify_one();
+    if (!context->session_id.empty() &&
+        !m_spSessions->HasSession(context->session_id)) {
+      // Expired or ended; the client has to initialize a new session.
+      res.set_content(SESSION_NOT_FOUND_RESPONSE, JSON_CONTENT_TYPE);
+      res.status = 404;
+      return;
+    }
+
+    context->has_request = true;
+    if (head.has_method && !head.id.empty()) {
+      context->request_id = std::string(head.id);
+    }
+    context->accepts_sse = req.get_header_value("Accept").find(
+                             SSE_CONTENT_TYPE) != std::string::npos;
+    context->sessions = m_spSessions;
+
+    // Requests of a known session are registered, so the session can
+    // answer them on any of its channels.
+    bool bTracked =
+      !context->request_id.empty() && !context->session_id.empty();
+    if (bTracked) {
+      std::string_view params;
+      std::string_view meta;
+      std::string_view token;
+      if (PeekMember(strBody, "params", params) &&
+          PeekMember(params, "_meta", meta) &&
+          PeekMember(meta, "progressToken", token)) {
+        context->progress_token = std::string(token);
       }
+      m_spSessions->BeginRequest(context);
+    }
+
+    ContentEncoding eEncoding = ContentEncoding_Identity;
+    if (m_options.bCompression) {
+      eEncoding = NegotiateEncoding(req.get_header_value("Accept-Encoding"));
+    }
+
+    auto channel = std::make_shared<CHttpChannel>(context);
+    if (m_fnDispatch) {
+      // The message is handled on this worker; an asynchronous tool call
+      // answers later from the session's task thread.
+      m_fnDispatch(channel);
+    } else {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_pendingChannels.push(channel);
+      m_channelCond.notify_one();
+    }
 
-      {
-        std::unique_lock<std::mutex> lock(context->mutex);
-        context->response_cond.wait(lock,
-          [context, this]() { return context->has_response || !m_running; });
+    // Stop() wakes the tracked requests; the others see it within a second.
+    std::unique_lock<std::mutex> lock(context->mutex);
+    while (!context->response_cond.wait_for(
+      lock, std::chrono::seconds(1), [context, this]() {
+        return !m_running || context->stream_aborted ||
+               !context->response_messages.empty() ||
+               context->response_mode == ResponseMode_Chunked ||
+               (context->request_id.empty() && context->request_processed);
+      })) {
+    }
+
+    for (const auto& header : context->response_header) {
+      res.set_header(header.first, header.second);
+      LOG_TRACE("CHttpTransport::Start: Setting header: {} = {}",
+        header.first, header.second);
+    }
 
-        if (!m_running) {
-          res.set_content("{\"error\":\"Server stopped\"}", "application/json");
-          res.status = 503;
+    std::string strJsonBody;
+    EmbeddedText embedded;
+    if (!m_running ||
+        (context->stream_aborted && context->response_messages.empty())) {
+      res.set_content("{\"error\":\"Server stopped\"}", JSON_CONTENT_TYPE);
+      res.status = 503;
+    } else if (context->request_id.empty()) {
+      // Notifications and responses from the client are only acknowledged.
+      context->response_closed = true;
+      res.status = 202;
+    } else if (context->response_mode == ResponseMode_Chunked) {
+      LOG_INFO("CHttpTransport::Start: Streaming chunked response");
+
+      // The size is not known up front, so a negotiated encoding is always
+      // used. Every chunk is flushed and decodable on arrival.
+      std::shared_ptr<CCompressStream> spCompress;
+      if (eEncoding != ContentEncoding_Identity) {
+        spCompress = std::make_shared<CCompressStream>();
+        if (ERRNO_OK ==
+            spCompress->Begin(eEncoding, m_options.iCompressionLevel)) {
+          res.set_header("Content-Encoding", GetEncodingName(eEncoding));
+          res.set_header("Vary", "Accept-Encoding");
         } else {
-          LOG_INFO(
-            "CHttpTransport::Start: Response body: {}", context->response_body);
+          spCompress = nullptr;
+        }
+      }
+
+      res.set_chunked_content_provider(JSON_CONTENT_TYPE,
+        [context, spCompress](size_t offset, httplib::DataSink& sink) {
+          std::string strCompressed;
+          std::unique_lock<std::mutex> lock(context->mutex);
+          while (context->response_chunks.empty() &&
+                 !context->stream_done && !context->stream_aborted) {
+            if (!sink.is_writable()) {
+              context->stream_aborted = true;
+              context->response_cond.notify_all();
+              return false;
+            }
+            context->response_cond.wait_for(lock, std::chrono::seconds(1));
+          }
+
+          while (!context->response_chunks.empty()) {
+            auto chunk = std::move(context->response_chunks.front());
+            context->response_chunks.pop_front();
+            context->response_cond.notify_all();
 
-          for (const auto& header : context->response_header) {
-            res.set_header(header.first, header.second);
-            LOG_TRACE("CHttpTransport::Start: Setting header: {} = {}",
-              header.first, header.second);
+            lock.unlock();
+            bool bWritten = true;
+            if (!spCompress) {
+              bWritten = sink.write(chunk.data(), chunk.size());
+            } else if (ERRNO_OK != spCompress->Write(chunk, strCompressed)) {
+              bWritten = false;
+            } else if (!strCompressed.empty()) {
+              bWritten =
+                sink.write(strCompressed.data(), strCompressed.size());
+            }
+            lock.lock();
+            if (!bWritten) {
+              context->stream_aborted = true;
+              context->response_cond.notify_all();
+              return false;
+            }
           }
 
-          if (context->response_header.find("Content-Type") ==
-              context->response_header.end()) {
-            res.set_content(context->response_body, "application/json");
-          } else {
-            res.set_content(context->response_body, "");
+          if (context->stream_aborted) {
+            return false;
           }
-          res.status = 200;
+          if (context->stream_done) {
+            context->response_closed = true;
+            if (spCompress) {
+              if (ERRNO_OK != spCompress->End(strCompressed) ||
+                  !sink.write(strCompressed.data(), strCompressed.size())) {
+                return false;
+              }
+            }
+            sink.done();
+          }
+          return true;
+        },
+        [spSessions = m_spSessions, context](bool bSuccess) {
+          spSessions->EndRequest(context);
+        });
+      res.status = 200;
+      bTracked = false;
+    } else if (context->has_response &&
+               context->response_messages.size() == 1) {
+      strJsonBody = std::move(context->response_messages.front());
+      context->response_messages.clear();
+      embedded = std::move(context->response_text);
+      context->response_mode = ResponseMode_Json;
+      context->response_closed = true;
+      LOG_TRACE("CHttpTransport::Start: Response body: {}", strJsonBody);
+      res.status = 200;
+    } else {
+      // Messages came ahead of the response: each is sent as an event as
+      // soon as it is written, and the stream ends with the response.
+      LOG_INFO("CHttpTransport::Start: Streaming events");
+      context->response_mode = ResponseMode_Sse;
+      res.set_header("Cache-Control", "no-cache");
+
+      res.set_chunked_content_provider(SSE_CONTENT_TYPE,
+        [context](size_t offset, httplib::DataSink& sink) {
+          std::unique_lock<std::mutex> lock(context->mutex);
+          while (context->response_messages.empty() &&
+                 !context->stream_aborted) {
+            if (!sink.is_writable()) {
+              context->response_closed = true;
+              return false;
+            }
+            context->response_cond.wait_for(lock, std::chrono::seconds(1));
+          }
+
+          while (!context->response_messages.empty()) {
+            auto strEvent = CHttpSessionTable::FormatEvent(
+              context->response_messages.front());
+            context->response_messages.pop_front();
+            bool bLast =
+              context->has_response && context->response_messages.empty();
+
+            lock.unlock();
+            bool bWritten = sink.write(strEvent.data(), strEvent.size());
+            lock.lock();
+            if (!bWritten) {
+              context->response_closed = true;
+              return false;
+            }
+            if (bLast) {
+              context->response_closed = true;
+              sink.done();
+              return true;
+            }
+          }
+
+          if (context->stream_aborted) {
+            context->response_closed = true;
+            return false;
+          }
+          return true;
+        },
+        [spSessions = m_spSessions, context](bool bSuccess) {
+          spSessions->EndRequest(context);
+        });
+      res.status = 200;
+      bTracked = false;
+    }
+
+    // Streamed responses are released once written.
+    lock.unlock();
+    if (bTracked) {
+      m_spSessions->EndRequest(context);
+    }
+
+    if (!strJsonBody.empty()) {
+      // Compressed outside the context lock; large tools catalogs reuse
+      // their cached deflate data.
+      if (eEncoding != ContentEncoding_Identity &&
+          strJsonBody.size() >= m_options.nCompressMinSize) {
+        std::string strCompressed;
+        if (ERRNO_OK == CompressMessage(strJsonBody, eEncoding,
+                          m_options.iCompressionLevel, strCompressed,
+                          embedded)) {
+          strJsonBody = std::move(strCompressed);
+          res.set_header("Content-Encoding", GetEncodingName(eEncoding));
         }
+        res.set_header("Vary", "Accept-Encoding");
+      }
+      if (res.has_header("Content-Type")) {
+        res.set_content(std::move(strJsonBody), "");
+      } else {
+        res.set_content(std::move(strJsonBody), JSON_CONTENT_TYPE);
       }
+    }
+  });
+
+  // A client ending its session.
+  server.Delete("/", [this](const httplib::Request& req,
+                      httplib::Response& res) {
+    auto strSessionId = req.get_header_value(HEADER_SESSION_ID);
+    if (strSessionId.empty()) {
+      res.status = 400;
+      return;
+    }
+    size_t nOwner = 0;
+    if (IsForeignSession(strSessionId, nOwner)) {
+      ForwardRequest(nOwner, req, req.body, res);
+      return;
+    }
+    if (!m_spSessions->HasSession(strSessionId)) {
+      res.status = 404;
+      return;
+    }
+
+    LOG_INFO("CHttpTransport::Start: Session {} ended by the client",
+      strSessionId);
+    if (m_fnSessionEnd) {
+      m_fnSessionEnd(strSessionId);
+    }
+    m_spSessions->RemoveSession(strSessionId);
+    res.status = 204;
+  });
+
+  // The stream a session opens for messages sent outside of a POST.
+  server.Get("/", [this](const httplib::Request& req, httplib::Response& res) {
+    if (req.get_header_value("Accept").find(SSE_CONTENT_TYPE) ==
+        std::string::npos) {
+      res.status = 406;
+      return;
+    }
+
+    auto strSessionId = req.get_header_value(HEADER_SESSION_ID);
+    if (strSessionId.empty()) {
+      res.status = 400;
+      return;
+    }
+    size_t nOwner = 0;
+    if (IsForeignSession(strSessionId, nOwner)) {
+      ForwardRequest(nOwner, req, req.body, res);
+      return;
+    }
+
+    if (0 == m_nMaxStreams) {
+      res.status = 405;
+      return;
+    }
+    // Streams never end on their own, so none is opened while draining.
+    if (m_bDraining) {
+      res.status = 503;
+      return;
+    }
+    // Each stream holds this worker until the client goes away.
+    if (m_nStreams.fetch_add(1) >= m_nMaxStreams) {
+      --m_nStreams;
+      LOG_WARNING("CHttpTransport::Start: {} event streams open, refusing "
+                  "the one of session {}",
+        m_nMaxStreams, strSessionId);
+      res.set_header("Retry-After", "1");
+      res.status = 503;
+      return;
+    }
+
+    auto spStream = m_spSessions->OpenStream(strSessionId);
+    if (!spStream) {
+      --m_nStreams;
+      LOG_WARNING(
+        "CHttpTransport::Start: Event stream for unknown session '{}'",
+        strSessionId);
+      res.status = 404;
+      return;
+    }
+
+    LOG_INFO(
+      "CHttpTransport::Start: Event stream opened for session {}",
+      strSessionId);
+    res.set_header("Cache-Control", "no-cache");
+    res.set_chunked_content_provider(SSE_CONTENT_TYPE,
+      [spStream](size_t offset, httplib::DataSink& sink) {
+        std::unique_lock<std::mutex> lock(spStream->mutex);
+        auto idleUntil =
+          std::chrono::steady_clock::now() + SSE_KEEPALIVE_INTERVAL;
+        while (spStream->events.empty() && !spStream->closed) {
+          if (!sink.is_writable()) {
+            return false;
+          }
+          if (std::chrono::steady_clock::now() >= idleUntil) {
+            // A comment line keeps proxies from closing the idle stream.
+            lock.unlock();
+            return sink.write(SSE_KEEPALIVE, sizeof(SSE_KEEPALIVE) - 1);
+          }
+          spStream->cond.wait_for(lock, std::chrono::seconds(1));
+        }
+
+        while (!spStream->events.empty()) {
+          auto strEvent = std::move(spStream->events.front());
+          spStream->events.pop_front();
+
+          lock.unlock();
+          bool bWritten = sink.write(strEvent.data(), strEvent.size());
+          lock.lock();
+          if (!bWritten) {
+            return false;
+          }
+        }
+
+        if (spStream->closed) {
+          sink.done();
+        }
+        return true;
+      },
+      [this, strSessionId, spStream](bool bSuccess) {
+        m_spSessions->CloseStream(strSessionId, spStream);
+        --m_nStreams;
+      });
+    res.status = 200;
+  });
+}
+
+void CHttpTransport::ConfigureServer(httplib::Server& server) {
+  size_t nThreadCount = m_options.nThreadCount;
+  if (0 == nThreadCount) {
+    nThreadCount =
+      std::max<size_t>(8, std::thread::hardware_concurrency() * 2) +
+      m_options.nMaxStreams;
+  }
+  m_nMaxStreams = std::min(m_options.nMaxStreams, nThreadCount - 1);
+  m_nThreadCount = nThreadCount;
+  size_t nMaxQueued = m_options.nMaxQueuedConnections;
+  size_t nMaxConnections = m_options.nMaxConnections;
+  server.new_task_queue = [nThreadCount, nMaxQueued, nMaxConnections]() {
+    return new CHttpTaskQueue(nThreadCount, nMaxQueued, nMaxConnections);
+  };
+
+  server.set_keep_alive_max_count(m_options.nKeepAliveMaxCount);
+  server.set_keep_alive_timeout(m_options.keepAliveTimeout.count());
+  auto readTimeout = m_options.readTimeout.count();
+  server.set_read_timeout(readTimeout / 1000, (readTimeout % 1000) * 1000);
+  auto writeTimeout = m_options.writeTimeout.count();
+  server.set_write_timeout(
+    writeTimeout / 1000, (writeTimeout % 1000) * 1000);
+  server.set_payload_max_length(m_options.nPayloadMaxLength);
+  server.set_tcp_nodelay(m_options.bTcpNoDelay);
+
+  LOG_INFO("CHttpTransport: {} workers, {} queued connections and {} event "
+           "streams at most",
+    nThreadCount, nMaxQueued, m_nMaxStreams);
+}
+
+void CHttpTransport::SetDispatchHandler(DispatchHandler fnDispatch) {
+  m_fnDispatch = std::move(fnDispatch);
+}
+
+void CHttpTransport::SetSessionEndHandler(SessionEndHandler fnSessionEnd) {
+  m_fnSessionEnd = std::move(fnSessionEnd);
+}
+
+void CHttpTransport::EndSession(const std::string& strSessionId) {
+  m_spSessions->RemoveSession(strSessionId);
+}
+
+bool CHttpTransport::HasSessionStream(const std::string& strSessionId) {
+  return m_spSessions->HasStream(strSessionId);
+}
+
+int CHttpTransport::PrepareWorkers(size_t nWorkers) {
+#ifndef _WIN32
+  if (nWorkers > MAX_SESSION_WORKERS) {
+    LOG_ERROR("CHttpTransport: At most {} workers are supported",
+      MAX_SESSION_WORKERS);
+    return ERRNO_INVALID_PARAMS;
+  }
+  m_nWorkers = nWorkers;
+  m_lMasterPid = static_cast<long>(getpid());
+
+#if defined(CPPHTTPLIB_OPENSSL_SUPPORT)
+  // Each process would make its own keys, and tickets would only resume on
+  // the worker that issued them.
+  if (!m_options.tls.strCertFile.empty() && m_options.tls.bSessionTickets) {
+    m_strTicketKeys.resize(TLS_TICKET_KEYS_SIZE);
+    if (RAND_bytes(reinterpret_cast<unsigned char*>(&m_strTicketKeys[0]),
+          static_cast<int>(m_strTicketKeys.size())) != 1) {
+      LOG_ERROR("CHttpTransport: Failed to make the session ticket keys");
+      return ERRNO_INTERNAL_ERROR;
+    }
+  }
+#endif
+
+  // Compressed once here, the catalog pages are shared by the workers.
+  if (m_options.bCompression) {
+    CPrecompressedTexts::GetInstance().Prepare(m_options.iCompressionLevel);
+  }
+  return ERRNO_OK;
+#else
+  LOG_ERROR("CHttpTransport: Worker processes are not supported");
+  return ERRNO_INVALID_PARAMS;
+#endif
+}
+
+void CHttpTransport::SetWorker(size_t nWorker) {
+  m_nWorker = nWorker;
+}
+
+int CHttpTransport::StartWorkerServer() {
+#ifndef _WIN32
+  auto strPath = GetWorkerSocketPath(m_nWorker);
+  // Left behind by the worker this one replaces.
+  unlink(strPath.c_str());
+
+  {
+    std::lock_guard<std::mutex> lock(m_mtxForward);
+    m_bForwardStopped = false;
+    m_vecIdleClients.resize(m_nWorkers);
+  }
+
+  m_workerServer = std::make_unique<httplib::Server>();
+  ConfigureServer(*m_workerServer);
+  // Each relay serves a request held by a worker of the main server.
+  m_forwardPool =
+    std::make_unique<httplib::ThreadPool>(m_nThreadCount, m_nThreadCount);
+  RegisterHandlers(*m_workerServer);
+  m_workerServer->set_address_family(AF_UNIX);
+  if (!m_workerServer->bind_to_port(strPath, 80)) {
+    LOG_ERROR("CHttpTransport: Failed to bind the worker socket {}", strPath);
+    return ERRNO_INTERNAL_ERROR;
+  }
+  chmod(strPath.c_str(), S_IRUSR | S_IWUSR);
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_nServing;
+  }
+  m_workerServerThread = std::make_unique<std::thread>(
+    [this]() { RunServer(*m_workerServer); });
+  LOG_INFO("CHttpTransport: Worker {} of {} takes forwarded requests on {}",
+    m_nWorker, m_nWorkers, strPath);
+  return ERRNO_OK;
+#else
+  return ERRNO_INVALID_PARAMS;
+#endif
+}
+
+bool CHttpTransport::IsForeignSession(
+  const std::string& strSessionId, size_t& nOwner) const {
+  if (m_nWorkers <= 1 || strSessionId.empty()) {
+    return false;
+  }
+
+  // Ids naming no worker are unknown everywhere; they are answered here.
+  int iWorker = GetSessionWorker(strSessionId);
+  if (iWorker < 0 || static_cast<size_t>(iWorker) >= m_nWorkers ||
+      static_cast<size_t>(iWorker) == m_nWorker) {
+    return false;
+  }
+  nOwner = static_cast<size_t>(iWorker);
+  return true;
+}
+
+std::string CHttpTransport::GetWorkerSocketPath(size_t nWorker) const {
+  return m_options.strWorkerSocketDir + "/tinymcp-" +
+         std::to_string(m_lMasterPid) + "-" + std::to_string(nWorker) +
+         ".sock";
+}
+
+void CHttpTransport::ForwardRequest(size_t nOwner, const httplib::Request& req,
+  const std::string& strBody, httplib::Response& res) {
+  LOG_DEBUG("CHttpTransport: {} request forwarded to worker {}", req.method,
+    nOwner);
+
+  auto spForward = std::make_shared<ForwardedResponse>();
+  httplib::Request forward;
+  forward.method = req.method;
+  forward.path = req.path;
+  for (const auto& header : req.headers) {
+    if (!IsHopByHopHeader(header.first)) {
+      forward.headers.emplace(header.first, header.second);
+    }
+  }
+  forward.body = strBody;
+  forward.response_handler = [spForward](const httplib::Response& response) {
+    std::lock_guard<std::mutex> lock(spForward->mutex);
+    spForward->status = response.status;
+    spForward->headers = response.headers;
+    spForward->has_head = true;
+    spForward->cond.notify_all();
+    return true;
+  };
+  forward.content_receiver = [spForward](const char* pData, size_t nSize,
+                               uint64_t ullOffset, uint64_t ullTotal) {
+    std::unique_lock<std::mutex> lock(spForward->mutex);
+    spForward->cond.wait(lock, [spForward]() {
+      return spForward->aborted ||
+             spForward->chunks.size() < FORWARD_MAX_PENDING_CHUNKS;
     });
+    if (spForward->aborted) {
+      return false;
+    }
+    spForward->chunks.emplace_back(pData, nSize);
+    spForward->cond.notify_all();
+    return true;
+  };
 
-    m_running = true;
-    m_serverThread = std::make_unique<std::thread>(
-      [this]() { m_server->listen(m_strHost, m_nPort); });
+  auto fnRelay = [this, nOwner, spForward, forward = std::move(forward)]() {
+    auto spClient = TakeForwardClient(nOwner);
+    bool bSent = false;
+    if (spClient) {
+      auto result = spClient->send(forward);
+      bSent = static_cast<bool>(result);
+      if (!bSent) {
+        LOG_WARNING("CHttpTransport: Forwarding to worker {} failed: {}",
+          nOwner, httplib::to_string(result.error()));
+      }
+      ReturnForwardClient(nOwner, std::move(spClient), bSent);
+    }
 
-    for (int i = 0; i < 50; ++i) {
-      std::this_thread::sleep_for(std::chrono::milliseconds(10));
-      if (m_server && m_server->is_running()) {
-        LOG_INFO("CHttpTransport::Start: HTTP server started successfully");
-        return ERRNO_OK;
+    std::lock_guard<std::mutex> lock(spForward->mutex);
+    spForward->done = true;
+    spForward->cond.notify_all();
+  };
+  bool bQueued = false;
+  {
+    std::lock_guard<std::mutex> lock(m_mtxForward);
+    bQueued = !m_bForwardStopped && m_forwardPool &&
+              m_forwardPool->enqueue(std::move(fnRelay));
+  }
+  if (!bQueued) {
+    res.set_header("Retry-After", "1");
+    res.status = 503;
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(spForward->mutex);
+  spForward->cond.wait(
+    lock, [spForward]() { return spForward->has_head || spForward->done; });
+  if (!spForward->has_head) {
+    // The owner is gone, and its sessions with it.
+    if (req.method == "POST") {
+      res.set_content(SESSION_NOT_FOUND_RESPONSE, JSON_CONTENT_TYPE);
+    }
+    res.status = 404;
+    return;
+  }
+
+  std::string strContentType;
+  bool bStreamed = true;
+  for (const auto& header : spForward->headers) {
+    if (EqualsIgnoreCase(header.first, "Content-Length")) {
+      bStreamed = false;
+    } else if (EqualsIgnoreCase(header.first, "Content-Type")) {
+      strContentType = header.second;
+    } else if (!IsHopByHopHeader(header.first)) {
+      res.set_header(header.first, header.second);
+    }
+  }
+  res.status = spForward->status;
+
+  if (!bStreamed) {
+    std::string strContent;
+    while (!spForward->done || !spForward->chunks.empty()) {
+      if (spForward->chunks.empty()) {
+        spForward->cond.wait(lock);
+        continue;
       }
+      strContent.append(spForward->chunks.front());
+      spForward->chunks.pop_front();
+      spForward->cond.notify_all();
+    }
+    if (!strContent.empty()) {
+      res.set_content(std::move(strContent), strContentType);
     }
+    return;
+  }
 
-    LOG_ERROR("CHttpTransport::Start: HTTP server startup timeout");
-    m_running = false;
-    return ERRNO_INTERNAL_ERROR;
-  } catch (const std::exception& e) {
-    LOG_ERROR("CHttpTransport::Start: Exception: {}", e.what());
-    m_running = false;
-    return ERRNO_INTERNAL_ERROR;
+  res.set_chunked_content_provider(strContentType,
+    [spForward](size_t offset, httplib::DataSink& sink) {
+      std::unique_lock<std::mutex> lock(spForward->mutex);
+      while (spForward->chunks.empty() && !spForward->done) {
+        if (!sink.is_writable()) {
+          spForward->aborted = true;
+          spForward->cond.notify_all();
+          return false;
+        }
+        spForward->cond.wait_for(lock, std::chrono::seconds(1));
+      }
+
+      while (!spForward->chunks.empty()) {
+        auto strChunk = std::move(spForward->chunks.front());
+        spForward->chunks.pop_front();
+        spForward->cond.notify_all();
+
+        lock.unlock();
+        bool bWritten = sink.write(strChunk.data(), strChunk.size());
+        lock.lock();
+        if (!bWritten) {
+          spForward->aborted = true;
+          spForward->cond.notify_all();
+          return false;
+        }
+      }
+
+      if (spForward->done) {
+        sink.done();
+      }
+      return true;
+    },
+    [spForward](bool bSuccess) {
+      // Stops reading the owner when the client went away.
+      std::lock_guard<std::mutex> lock(spForward->mutex);
+      spForward->aborted = true;
+      spForward->cond.notify_all();
+    });
+}
+
+std::unique_ptr<httplib::Client> CHttpTransport::TakeForwardClient(
+  size_t nOwner) {
+  std::unique_ptr<httplib::Client> spClient;
+  {
+    std::lock_guard<std::mutex> lock(m_mtxForward);
+    if (m_bForwardStopped || nOwner >= m_vecIdleClients.size()) {
+      return nullptr;
+    }
+    auto& vecIdle = m_vecIdleClients[nOwner];
+    if (!vecIdle.empty()) {
+      spClient = std::move(vecIdle.back());
+      vecIdle.pop_back();
+      m_vecBusyClients.push_back(spClient.get());
+      return spClient;
+    }
+  }
+
+  spClient = std::make_unique<httplib::Client>(GetWorkerSocketPath(nOwner));
+  spClient->set_address_family(AF_UNIX);
+  spClient->set_keep_alive(true);
+  spClient->set_read_timeout(FORWARD_READ_TIMEOUT.count(), 0);
+  // The body is relayed as the owner encoded it.
+  spClient->set_decompress(false);
+
+  std::lock_guard<std::mutex> lock(m_mtxForward);
+  if (m_bForwardStopped) {
+    return nullptr;
+  }
+  m_vecBusyClients.push_back(spClient.get());
+  return spClient;
+}
+
+void CHttpTransport::ReturnForwardClient(size_t nOwner,
+  std::unique_ptr<httplib::Client> spClient, bool bReusable) {
+  std::lock_guard<std::mutex> lock(m_mtxForward);
+  m_vecBusyClients.erase(std::remove(m_vecBusyClients.begin(),
+                           m_vecBusyClients.end(), spClient.get()),
+    m_vecBusyClients.end());
+  // A failed connection is closed; the next request connects anew.
+  if (bReusable && !m_bForwardStopped && nOwner < m_vecIdleClients.size() &&
+      m_vecIdleClients[nOwner].size() < FORWARD_MAX_IDLE_CLIENTS) {
+    m_vecIdleClients[nOwner].push_back(std::move(spClient));
+  }
+}
+
+void CHttpTransport::StopForwarding() {
+  std::vector<std::vector<std::unique_ptr<httplib::Client>>> vecIdle;
+  {
+    std::lock_guard<std::mutex> lock(m_mtxForward);
+    m_bForwardStopped = true;
+    // Unblocks relays waiting for an owner that has not answered yet.
+    for (auto* pClient : m_vecBusyClients) {
+      pClient->stop();
+    }
+    vecIdle.swap(m_vecIdleClients);
+  }
+
+  // Requests are no longer queued, so the pool is not replaced meanwhile.
+  if (m_forwardPool) {
+    m_forwardPool->shutdown();
   }
 }
 
@@ -128,6 +1122,9 @@ int CHttpTransport::Stop() {
   }
 
   LOG_INFO("CHttpTransport::Stop: Stopping HTTP server");
+  m_spSessions->CloseAll();
+  // Forwarding handlers wait for their relays.
+  StopForwarding();
 
   if (m_server) {
     try {
@@ -139,26 +1136,30 @@ int CHttpTransport::Stop() {
     }
   }
 
+  // Handlers still waiting were woken above; the read and write timeouts
+  // bound the rest.
   if (m_serverThread && m_serverThread->joinable()) {
     try {
-      auto future = std::async(std::launch::async, [this]() {
-        if (m_serverThread && m_serverThread->joinable()) {
-          m_serverThread->join();
-        }
-      });
-
-      if (future.wait_for(std::chrono::seconds(5)) ==
-          std::future_status::timeout) {
-        LOG_ERROR("CHttpTransport::Stop: Server thread join timeout");
-      } else {
-        LOG_INFO("CHttpTransport::Stop: Server thread joined successfully");
-      }
+      m_serverThread->join();
+      LOG_INFO("CHttpTransport::Stop: Server thread joined successfully");
     } catch (const std::exception& e) {
       LOG_ERROR(
         "CHttpTransport::Stop: Exception during thread join: {}", e.what());
     }
   }
 
+  if (m_workerServer) {
+    m_workerServer->stop();
+    if (m_workerServerThread && m_workerServerThread->joinable()) {
+      m_workerServerThread->join();
+    }
+#ifndef _WIN32
+    unlink(GetWorkerSocketPath(m_nWorker).c_str());
+#endif
+    m_workerServer.reset();
+    m_workerServerThread.reset();
+  }
+
   {
     std::lock_guard<std::mutex> lock(m_mutex);
     while (!m_pendingChannels.empty()) {
@@ -176,6 +1177,7 @@ int CHttpTransport::Stop() {
   try {
     m_server.reset();
     m_serverThread.reset();
+    m_forwardPool.reset();
   } catch (const std::exception& e) {
     LOG_ERROR(
       "CHttpTransport::Stop: Exception during resource cleanup: {}", e.what());
@@ -185,6 +1187,130 @@ int CHttpTransport::Stop() {
   return ERRNO_OK;
 }
 
+void CHttpTransport::StopAccepting() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_running || m_bDraining) {
+      return;
+    }
+    m_bDraining = true;
+  }
+
+  // Closing the listening sockets lets httplib finish the requests it
+  // reads, then close their connections.
+  LOG_INFO("CHttpTransport::StopAccepting: Draining the HTTP server");
+  m_spSessions->CloseStreams();
+  if (m_server) {
+    m_server->stop();
+  }
+  if (m_workerServer) {
+    m_workerServer->stop();
+  }
+}
+
+bool CHttpTransport::WaitIdle(
+  std::chrono::steady_clock::time_point tpDeadline) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  return m_idleCond.wait_until(
+    lock, tpDeadline, [this]() { return 0 == m_nServing; });
+}
+
+int CHttpTransport::PrepareHandoff(const std::vector<int>& vecFds) {
+#ifndef _WIN32
+  if (m_nWorkers > 1) {
+    LOG_ERROR("CHttpTransport: Handoff is not supported with workers");
+    return ERRNO_INVALID_PARAMS;
+  }
+  if (vecFds.size() > 1) {
+    LOG_ERROR("CHttpTransport: Took over {} listeners, expected one",
+      vecFds.size());
+    return ERRNO_INVALID_PARAMS;
+  }
+  if (vecFds.empty()) {
+    return ERRNO_OK;
+  }
+
+  // The host may resolve differently from one run to the next, so only the
+  // port is compared.
+  int fd = vecFds[0];
+  int iListening = 0;
+  socklen_t nLen = sizeof(iListening);
+  struct sockaddr_storage bound {};
+  socklen_t nBoundLen = sizeof(bound);
+  int iBoundPort = -1;
+  if (getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &iListening, &nLen) == 0 &&
+      iListening &&
+      getsockname(fd, reinterpret_cast<struct sockaddr*>(&bound),
+        &nBoundLen) == 0) {
+    if (bound.ss_family == AF_INET) {
+      iBoundPort =
+        ntohs(reinterpret_cast<struct sockaddr_in*>(&bound)->sin_port);
+    } else if (bound.ss_family == AF_INET6) {
+      iBoundPort =
+        ntohs(reinterpret_cast<struct sockaddr_in6*>(&bound)->sin6_port);
+    }
+  }
+  if (iBoundPort != m_nPort) {
+    LOG_ERROR("CHttpTransport: Took over fd {}, not this listener", fd);
+    return ERRNO_INVALID_PARAMS;
+  }
+
+  if (m_fdAdopted >= 0) {
+    close(m_fdAdopted);
+  }
+  m_fdAdopted = fd;
+  return ERRNO_OK;
+#else
+  return ERRNO_INVALID_PARAMS;
+#endif
+}
+
+std::vector<int> CHttpTransport::GetListeners() {
+  std::vector<int> vecFds;
+  int fd = m_fdListen;
+  if (fd >= 0) {
+    vecFds.push_back(fd);
+  }
+  return vecFds;
+}
+
+void CHttpTransport::ReleaseListeners() {
+#if defined(__linux__)
+  // httplib shuts its listener down when it stops, which would stop the
+  // successor's too: the number is pointed at a listener of no address of
+  // this process first. Connections still queued are the successor's.
+  int fd = m_fdListen.exchange(-1);
+  if (fd >= 0) {
+    int fdIdle =
+      socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    struct sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    // Bound to an address the kernel picks in the abstract namespace.
+    if (fdIdle < 0 ||
+        bind(fdIdle, reinterpret_cast<struct sockaddr*>(&addr),
+          sizeof(sa_family_t)) < 0 ||
+        listen(fdIdle, 1) < 0 || dup2(fdIdle, fd) < 0) {
+      LOG_ERROR("CHttpTransport: Failed to release the listener, error "
+                "code: {}",
+        errno);
+    }
+    if (fdIdle >= 0) {
+      close(fdIdle);
+    }
+  }
+#endif
+  StopAccepting();
+}
+
+void CHttpTransport::RunServer(httplib::Server& server) {
+  // Returns once the workers of the server have served their connections.
+  server.listen_after_bind();
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  --m_nServing;
+  m_idleCond.notify_all();
+}
+
 std::shared_ptr<IChannel> CHttpTransport::AcceptChannel() {
   std::unique_lock<std::mutex> lock(m_mutex);
 
@@ -1,11 +1,15 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <queue>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "Channel.h"
 #include "httplib.h"
@@ -16,14 +20,66 @@ class CMCPTransport {
 public:
   virtual ~CMCPTransport() = default;
 
+  // Receives a channel that carries one inbound message, on the thread the
+  // transport read it on. A persistent channel is handed over again each
+  // time more input arrives, and a last time after its input ended.
+  using DispatchHandler =
+    std::function<void(const std::shared_ptr<IChannel>& spChannel)>;
+
   virtual int Start() = 0;
   virtual int Stop() = 0;
   virtual std::shared_ptr<IChannel> AcceptChannel() = 0;
+  // Transports that serve each message on a worker of their own hand the
+  // channel to the handler there instead of queueing it for AcceptChannel().
+  // Set before Start().
+  virtual void SetDispatchHandler(DispatchHandler fnDispatch) {}
+
+  // Receives the id of a session the client ended. Set before Start().
+  using SessionEndHandler =
+    std::function<void(const std::string& strSessionId)>;
+  virtual void SetSessionEndHandler(SessionEndHandler fnSessionEnd) {}
+  // The server dropped the session; the transport releases what it keeps
+  // for it.
+  virtual void EndSession(const std::string& strSessionId) {}
+  // True while the client listens on a stream of the session, which keeps
+  // an otherwise idle session from expiring.
+  virtual bool HasSessionStream(const std::string& strSessionId) {
+    return false;
+  }
+
+  // Pre-fork mode, see CMCPServer::SetWorkerProcesses(). PrepareWorkers()
+  // runs once in the master before the workers are forked, SetWorker() in
+  // each worker before Start(). Transports whose clients cannot be spread
+  // over several processes refuse it.
+  virtual int PrepareWorkers(size_t nWorkers) {
+    return ERRNO_INVALID_PARAMS;
+  }
+  virtual void SetWorker(size_t nWorker) {}
+
+  // Graceful stop, see CMCPServer::SetDrainTimeout(). StopAccepting() refuses
+  // new clients while requests in progress go on; WaitIdle() returns true
+  // once none is left, or false at the deadline. Stop() ends the rest.
+  virtual void StopAccepting() {}
+  virtual bool WaitIdle(std::chrono::steady_clock::time_point tpDeadline) {
+    return true;
+  }
+
+  // Zero-downtime restart, see CMCPServer::SetHandoffPath(). PrepareHandoff()
+  // runs before Start() with the listening sockets taken over from the
+  // process being replaced, none for the first one, and keeps them on
+  // success. GetListeners() are the sockets handed to a successor, and
+  // ReleaseListeners() stops accepting once it serves, leaving the sockets
+  // to it. Transports that cannot hand off refuse it.
+  virtual int PrepareHandoff(const std::vector<int>& vecFds) {
+    return ERRNO_INVALID_PARAMS;
+  }
+  virtual std::vector<int> GetListeners() { return {}; }
+  virtual void ReleaseListeners() {}
 };
 
 class CStdioTransport : public CMCPTransport {
 public:
-  CStdioTransport();
+  explicit CStdioTransport(StdioFraming eFraming = StdioFraming_Auto);
   ~CStdioTransport() override = default;
 
   int Start() override;
@@ -32,30 +88,164 @@ public:
 
 private:
   bool m_channelCreated;
+  StdioFraming m_eFraming;
 };
 
 struct ConnectionContext;
 
 class CMCPSession;
 
+// HTTPS, used when a certificate is set. Needs cpp-httplib with OpenSSL
+// (CPPHTTPLIB_OPENSSL_SUPPORT, see TINYMCP_WITH_OPENSSL).
+struct HttpTlsOptions {
+  // PEM files.
+  std::string strCertFile;
+  std::string strKeyFile;
+  std::string strKeyPassword;
+  // OpenSSL cipher strings for TLS 1.2 and TLS 1.3. Empty keeps the
+  // library defaults.
+  std::string strCipherList;
+  std::string strCipherSuites;
+  // Reconnecting clients resume their session instead of a full handshake,
+  // from the server's session cache or from a ticket they keep.
+  bool bSessionCache{ true };
+  size_t nSessionCacheSize{ 20 * 1024 };
+  bool bSessionTickets{ true };
+  std::chrono::seconds sessionTimeout{ 2 * 60 * 60 };
+};
+
+// Tuning of the HTTP server. httplib serves a connection on one worker for
+// as long as it is kept alive, so the worker and queue sizes bound how many
+// clients are served at once; connections beyond the limits are closed as
+// soon as they are accepted. An open GET event stream keeps its worker
+// until the client goes away.
+struct HttpTransportOptions {
+  // Zero uses twice the hardware concurrency, at least 8, plus one worker
+  // per stream allowed by nMaxStreams.
+  size_t nThreadCount{ 0 };
+  // GET event streams open at once; more are answered with 503. At least
+  // one worker is always left for requests. Zero offers no streams (405).
+  size_t nMaxStreams{ 64 };
+  // Accepted connections waiting for a free worker. Zero means no limit.
+  size_t nMaxQueuedConnections{ 256 };
+  // Connections being served or waiting. Zero means no limit besides the
+  // workers and the queue.
+  size_t nMaxConnections{ 0 };
+  size_t nKeepAliveMaxCount{ 100 };
+  std::chrono::seconds keepAliveTimeout{ 5 };
+  std::chrono::milliseconds readTimeout{ 5000 };
+  std::chrono::milliseconds writeTimeout{ 5000 };
+  // Larger request bodies are answered with 413 before they are buffered.
+  size_t nPayloadMaxLength{ 16 * 1024 * 1024 };
+  int iListenBacklog{ 1024 };
+  bool bTcpNoDelay{ true };
+  // gzip or deflate for JSON responses when the client accepts it and zlib
+  // is built in. Smaller bodies are sent as they are.
+  bool bCompression{ true };
+  size_t nCompressMinSize{ 1024 };
+  int iCompressionLevel{ 6 };
+  HttpTlsOptions tls;
+  // Lets other processes listen on the same port; the kernel spreads the
+  // connections over them. Always set in pre-fork mode.
+  bool bReusePort{ false };
+  // Directory of the Unix sockets pre-forked workers forward requests of
+  // each other's sessions over.
+  std::string strWorkerSocketDir{ "/tmp" };
+};
+
 class CHttpTransport : public CMCPTransport {
 public:
-  CHttpTransport(const std::string& host = "0.0.0.0", int port = 8080);
+  CHttpTransport(const std::string& host = "0.0.0.0", int port = 8080,
+    const HttpTransportOptions& options = HttpTransportOptions());
   ~CHttpTransport() override;
 
   int Start() override;
   int Stop() override;
   std::shared_ptr<IChannel> AcceptChannel() override;
+  void SetDispatchHandler(DispatchHandler fnDispatch) override;
+  void SetSessionEndHandler(SessionEndHandler fnSessionEnd) override;
+  void EndSession(const std::string& strSessionId) override;
+  bool HasSessionStream(const std::string& strSessionId) override;
+  int PrepareWorkers(size_t nWorkers) override;
+  void SetWorker(size_t nWorker) override;
+  void StopAccepting() override;
+  bool WaitIdle(std::chrono::steady_clock::time_point tpDeadline) override;
+  int PrepareHandoff(const std::vector<int>& vecFds) override;
+  std::vector<int> GetListeners() override;
+  void ReleaseListeners() override;
 
 private:
+  // Creates an HTTPS server when a certificate is set.
+  int CreateServer();
+  // Has the new server listen on the socket taken over, if any.
+  template <class TServer>
+  void UseAdoptedListener(TServer& server);
+  // Applies m_options to a new server.
+  void ConfigureServer(httplib::Server& server);
+  void RegisterHandlers(httplib::Server& server);
+  // Serves the requests other workers forward to this one, and starts the
+  // relays of those this one forwards.
+  int StartWorkerServer();
+  // Runs a server until it stopped and served its last connection.
+  void RunServer(httplib::Server& server);
+
+  // Whether a session belongs to another worker, which is then returned.
+  bool IsForeignSession(const std::string& strSessionId, size_t& nOwner) const;
+  std::string GetWorkerSocketPath(size_t nWorker) const;
+  // Relays a request to the worker owning its session and its response back
+  // to the client, streamed when the owner streams it.
+  void ForwardRequest(size_t nOwner, const httplib::Request& req,
+    const std::string& strBody, httplib::Response& res);
+  // A keep-alive connection to the owner, idle or new. Returns nullptr once
+  // stopped.
+  std::unique_ptr<httplib::Client> TakeForwardClient(size_t nOwner);
+  void ReturnForwardClient(size_t nOwner,
+    std::unique_ptr<httplib::Client> spClient, bool bReusable);
+  // Ends the relays in flight and waits for them.
+  void StopForwarding();
+
   std::string m_strHost;
   int m_nPort;
+  HttpTransportOptions m_options;
   std::unique_ptr<httplib::Server> m_server;
   std::unique_ptr<std::thread> m_serverThread;
-  bool m_running;
+  // Pre-fork mode: this worker, their count and the master's pid naming the
+  // worker sockets.
+  size_t m_nWorker{ 0 };
+  size_t m_nWorkers{ 1 };
+  long m_lMasterPid{ 0 };
+  // Handoff mode: the listening socket taken over from the process being
+  // replaced, until the server listens on it.
+  int m_fdAdopted{ -1 };
+  std::unique_ptr<httplib::Server> m_workerServer;
+  std::unique_ptr<std::thread> m_workerServerThread;
+  // Relays of forwarded requests, one worker of the server each at most.
+  size_t m_nThreadCount{ 0 };
+  std::unique_ptr<httplib::ThreadPool> m_forwardPool;
+  // Idle connections by owner, and those relaying a request.
+  std::mutex m_mtxForward;
+  bool m_bForwardStopped{ false };
+  std::vector<std::vector<std::unique_ptr<httplib::Client>>> m_vecIdleClients;
+  std::vector<httplib::Client*> m_vecBusyClients;
+  // TLS ticket keys made by the master, so tickets of one worker resume on
+  // another.
+  std::string m_strTicketKeys;
+  // The listening socket, seen when httplib applies the socket options.
+  std::atomic<int> m_fdListen{ -1 };
+  std::atomic<bool> m_running;
+  std::atomic<bool> m_bDraining{ false };
+  // nMaxStreams as limited by the worker count, and the streams open.
+  size_t m_nMaxStreams{ 0 };
+  std::atomic<size_t> m_nStreams{ 0 };
   std::mutex m_mutex;
   std::condition_variable m_channelCond;
+  // Servers still serving, signalled when one is done.
+  size_t m_nServing{ 0 };
+  std::condition_variable m_idleCond;
   std::queue<std::shared_ptr<IChannel>> m_pendingChannels;
+  std::shared_ptr<CHttpSessionTable> m_spSessions;
+  DispatchHandler m_fnDispatch;
+  SessionEndHandler m_fnSessionEnd;
 };
 
 }  // namespace MCP
@@ -0,0 +1,215 @@
+// Stop() with tool calls in flight: the running call may finish until the
+// drain timeout, then it is cancelled and the queued one is answered with an
+// error, and Stop() returns shortly after the deadline.
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "Entity/Server.h"
+#include "TestUtil.h"
+#include "Transport/SocketTransport.h"
+
+namespace {
+
+constexpr std::chrono::milliseconds DRAIN_TIMEOUT{ 300 };
+
+std::string g_strSocketPath;
+std::atomic<bool> g_bToolStarted{ false };
+std::atomic<bool> g_bToolCancelled{ false };
+
+// Runs until cancelled, or for ten seconds.
+class CSlowTask : public MCP::ProcessCallToolRequest {
+public:
+  CSlowTask(const std::shared_ptr<MCP::Request>& spRequest)
+    : ProcessCallToolRequest(spRequest) {}
+
+  std::shared_ptr<CMCPTask> Clone() const override {
+    auto spClone = std::make_shared<CSlowTask>(nullptr);
+    if (spClone) {
+      *spClone = *this;
+    }
+    return spClone;
+  }
+
+  int Execute() override {
+    g_bToolStarted = true;
+    auto tpEnd = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!g_bToolCancelled && std::chrono::steady_clock::now() < tpEnd) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    auto spResult = BuildResult();
+    if (!spResult)
+      return MCP::ERRNO_INTERNAL_ERROR;
+    MCP::TextContent textContent;
+    textContent.strType = MCP::CONST_TEXT;
+    textContent.strText = g_bToolCancelled ? "cancelled" : "done";
+    spResult->vecTextContent.push_back(textContent);
+    spResult->bIsError = false;
+    return NotifyResult(spResult);
+  }
+
+  int Cancel() override {
+    g_bToolCancelled = true;
+    return MCP::ERRNO_OK;
+  }
+};
+
+class CDrainServer : public MCP::CMCPServer<CDrainServer> {
+public:
+  int Initialize() override {
+    MCP::Implementation serverInfo;
+    serverInfo.strName = "drain-test";
+    serverInfo.strVersion = "1";
+    SetServerInfo(serverInfo);
+
+    MCP::Tools tools;
+    RegisterServerToolsCapabilities(tools);
+    MCP::Tool tool;
+    tool.strName = "slow";
+    tool.strDescription = "Runs until cancelled.";
+    tool.jInputSchema = Json::Value(Json::objectValue);
+    tool.jInputSchema["type"] = "object";
+    RegisterServerTools({ tool }, false);
+    RegisterToolsTasks("slow", std::make_shared<CSlowTask>(nullptr));
+
+    SetTransport(
+      std::make_shared<MCP::CUnixSocketTransport>(g_strSocketPath));
+    SetDrainTimeout(DRAIN_TIMEOUT);
+    return MCP::ERRNO_OK;
+  }
+
+private:
+  friend class MCP::CMCPServer<CDrainServer>;
+  CDrainServer() = default;
+  static CDrainServer s_Instance;
+};
+CDrainServer CDrainServer::s_Instance;
+
+int Connect() {
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return -1;
+
+  struct sockaddr_un addr {};
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, g_strSocketPath.c_str(), sizeof(addr.sun_path) - 1);
+  struct timeval timeout {
+    5, 0
+  };
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr),
+        sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+bool Send(int fd, const std::string& strMessage) {
+  std::string strLine = strMessage + "\n";
+  return send(fd, strLine.data(), strLine.size(), MSG_NOSIGNAL) ==
+         static_cast<ssize_t>(strLine.size());
+}
+
+// Reads until the peer closes the connection or the receive times out.
+std::string ReadAll(int fd) {
+  std::string strData;
+  char buffer[4096];
+  while (true) {
+    ssize_t nRead = recv(fd, buffer, sizeof(buffer), 0);
+    if (nRead <= 0)
+      break;
+    strData.append(buffer, static_cast<size_t>(nRead));
+  }
+  return strData;
+}
+
+// The line answering the request with the id, empty if there is none.
+std::string FindResponse(const std::string& strData, int iId) {
+  std::string strId = "\"id\":" + std::to_string(iId) + ",";
+  size_t nBegin = 0;
+  while (nBegin < strData.size()) {
+    size_t nEnd = strData.find('\n', nBegin);
+    if (nEnd == std::string::npos)
+      nEnd = strData.size();
+    std::string strLine = strData.substr(nBegin, nEnd - nBegin);
+    if (strLine.find(strId) != std::string::npos)
+      return strLine;
+    nBegin = nEnd + 1;
+  }
+  return std::string();
+}
+
+}  // namespace
+
+int main() {
+  g_strSocketPath =
+    "/tmp/tinymcp-drain-test-" + std::to_string(getpid()) + ".sock";
+
+  auto& server = CDrainServer::GetInstance();
+  CHECK(MCP::ERRNO_OK == server.Initialize());
+  std::thread serving([&server]() { server.Start(); });
+
+  int fd = -1;
+  for (int i = 0; i < 500 && fd < 0; ++i) {
+    fd = Connect();
+    if (fd < 0)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  CHECK(fd >= 0);
+
+  CHECK(Send(fd,
+    "{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"initialize\",\"params\":{"
+    "\"protocolVersion\":\"2024-11-05\",\"capabilities\":{},"
+    "\"clientInfo\":{\"name\":\"test\",\"version\":\"1\"}}}"));
+  CHECK(Send(fd, "{\"jsonrpc\":\"2.0\",\"method\":\"notifications/"
+                 "initialized\"}"));
+  // The second call waits behind the first.
+  CHECK(Send(fd, "{\"jsonrpc\":\"2.0\",\"id\":2,\"method\":\"tools/call\","
+                 "\"params\":{\"name\":\"slow\",\"arguments\":{}}}"));
+  CHECK(Send(fd, "{\"jsonrpc\":\"2.0\",\"id\":3,\"method\":\"tools/call\","
+                 "\"params\":{\"name\":\"slow\",\"arguments\":{}}}"));
+  for (int i = 0; i < 500 && !g_bToolStarted; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  CHECK(g_bToolStarted.load());
+
+  auto tpStop = std::chrono::steady_clock::now();
+  server.Stop();
+  auto stopTime = std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - tpStop);
+  serving.join();
+
+  // Waited for the deadline, and not much longer.
+  CHECK(stopTime >= DRAIN_TIMEOUT);
+  CHECK(stopTime < DRAIN_TIMEOUT + std::chrono::seconds(3));
+  CHECK(g_bToolCancelled.load());
+
+  std::string strData = fd >= 0 ? ReadAll(fd) : std::string();
+  if (fd >= 0)
+    close(fd);
+  CHECK(FindResponse(strData, 2).find("cancelled") != std::string::npos);
+  std::string strDropped = FindResponse(strData, 3);
+  CHECK(strDropped.find("\"error\"") != std::string::npos);
+  CHECK(strDropped.find(MCP::ERROR_MESSAGE_SERVER_STOPPING) !=
+        std::string::npos);
+  unlink(g_strSocketPath.c_str());
+
+  if (TestUtil::g_iFailures > 0) {
+    fprintf(stderr, "%d checks failed, Stop() took %lld ms\n",
+      TestUtil::g_iFailures, static_cast<long long>(stopTime.count()));
+    return 1;
+  }
+  printf("DrainTimeoutTest passed, Stop() took %lld ms\n",
+    static_cast<long long>(stopTime.count()));
+  return 0;
+}
@@ -0,0 +1,272 @@
+// Zero-downtime restart of a Unix domain socket server and of an HTTP
+// server: each new process takes the listener over while a client keeps
+// connecting, and none of the connections may fail.
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "Entity/Server.h"
+#include "TestUtil.h"
+#include "Transport/SocketTransport.h"
+#include "Transport/Transport.h"
+
+namespace {
+
+std::string g_strSocketPath;
+std::string g_strHandoffPath;
+// Serves HTTP on this port instead of the socket path when set.
+int g_iHttpPort = 0;
+
+class CHandoffServer : public MCP::CMCPServer<CHandoffServer> {
+public:
+  int Initialize() override {
+    MCP::Implementation serverInfo;
+    serverInfo.strName = "handoff-test";
+    serverInfo.strVersion = "1";
+    SetServerInfo(serverInfo);
+    if (g_iHttpPort > 0) {
+      SetTransport(
+        std::make_shared<MCP::CHttpTransport>("127.0.0.1", g_iHttpPort));
+    } else {
+      SetTransport(
+        std::make_shared<MCP::CUnixSocketTransport>(g_strSocketPath));
+    }
+    SetHandoffPath(g_strHandoffPath);
+    return MCP::ERRNO_OK;
+  }
+
+private:
+  friend class MCP::CMCPServer<CHandoffServer>;
+  CHandoffServer() = default;
+  static CHandoffServer s_Instance;
+};
+CHandoffServer CHandoffServer::s_Instance;
+
+// Runs a server in a child process until it has been taken over.
+pid_t StartServer() {
+  // Buffered output would otherwise be written by the child too.
+  fflush(nullptr);
+  pid_t pid = fork();
+  if (0 == pid) {
+    auto& server = CHandoffServer::GetInstance();
+    int iErrCode = server.Initialize();
+    if (MCP::ERRNO_OK == iErrCode)
+      iErrCode = server.Start();
+    if (MCP::ERRNO_OK == iErrCode)
+      server.Stop();
+    _exit(MCP::ERRNO_OK == iErrCode ? 0 : 1);
+  }
+  return pid;
+}
+
+// Returns true if the process exited with status 0 before the timeout.
+bool WaitExit(pid_t pid, std::chrono::seconds timeout) {
+  if (pid <= 0)
+    return false;
+
+  auto tpDeadline = std::chrono::steady_clock::now() + timeout;
+  while (std::chrono::steady_clock::now() < tpDeadline) {
+    int iStatus = 0;
+    pid_t result = waitpid(pid, &iStatus, WNOHANG);
+    if (result == pid)
+      return WIFEXITED(iStatus) && 0 == WEXITSTATUS(iStatus);
+    if (result < 0)
+      return false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  kill(pid, SIGKILL);
+  waitpid(pid, nullptr, 0);
+  return false;
+}
+
+// A port nothing listens on right now.
+int FindFreePort() {
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return 0;
+
+  struct sockaddr_in addr {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t nLength = sizeof(addr);
+  int iPort = 0;
+  if (bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) ==
+        0 &&
+      getsockname(fd, reinterpret_cast<struct sockaddr*>(&addr), &nLength) ==
+        0) {
+    iPort = ntohs(addr.sin_port);
+  }
+  close(fd);
+  return iPort;
+}
+
+int Connect() {
+  int fd = -1;
+  int iConnected = -1;
+  struct timeval timeout {
+    5, 0
+  };
+  if (g_iHttpPort > 0) {
+    fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(g_iHttpPort));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd >= 0) {
+      setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+      iConnected = connect(
+        fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+    }
+  } else {
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    strncpy(
+      addr.sun_path, g_strSocketPath.c_str(), sizeof(addr.sun_path) - 1);
+    if (fd >= 0) {
+      setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+      iConnected = connect(
+        fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+    }
+  }
+  if (fd >= 0 && iConnected != 0) {
+    close(fd);
+    fd = -1;
+  }
+  return fd;
+}
+
+// Connects as a new client and returns true once initialize is answered.
+bool InitializeClient() {
+  int fd = Connect();
+  if (fd < 0)
+    return false;
+
+  std::string strRequest =
+    "{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"initialize\",\"params\":{"
+    "\"protocolVersion\":\"2024-11-05\",\"capabilities\":{},"
+    "\"clientInfo\":{\"name\":\"test\",\"version\":\"1\"}}}";
+  if (g_iHttpPort > 0) {
+    strRequest = "POST / HTTP/1.1\r\nHost: 127.0.0.1\r\n"
+                 "Connection: close\r\n"
+                 "Accept: application/json\r\n"
+                 "Content-Type: application/json\r\n"
+                 "Content-Length: " +
+                 std::to_string(strRequest.size()) + "\r\n\r\n" +
+                 strRequest;
+  } else {
+    strRequest += "\n";
+  }
+
+  // HTTP answers until it closes the connection, the socket server with a
+  // line.
+  std::string strResponse;
+  if (send(fd, strRequest.data(), strRequest.size(), MSG_NOSIGNAL) ==
+      static_cast<ssize_t>(strRequest.size())) {
+    char buffer[4096];
+    while (g_iHttpPort > 0 || strResponse.find('\n') == std::string::npos) {
+      ssize_t nRead = recv(fd, buffer, sizeof(buffer), 0);
+      if (nRead <= 0)
+        break;
+      strResponse.append(buffer, static_cast<size_t>(nRead));
+    }
+  }
+  close(fd);
+  return strResponse.find("\"result\"") != std::string::npos;
+}
+
+bool WaitServing(std::chrono::seconds timeout) {
+  auto tpDeadline = std::chrono::steady_clock::now() + timeout;
+  while (std::chrono::steady_clock::now() < tpDeadline) {
+    if (InitializeClient())
+      return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+
+// Restarts the server twice under load and counts the failed checks.
+void RunHandoff(const char* pszName) {
+  int iFailures = TestUtil::g_iFailures;
+  pid_t pidFirst = StartServer();
+  CHECK(pidFirst > 0);
+  CHECK(WaitServing(std::chrono::seconds(5)));
+
+  std::atomic<bool> bStop{ false };
+  std::atomic<int> nServed{ 0 };
+  std::atomic<int> nFailed{ 0 };
+  std::thread client([&]() {
+    while (!bStop.load()) {
+      if (InitializeClient())
+        ++nServed;
+      else
+        ++nFailed;
+    }
+  });
+
+  // Each successor takes over, then the process it replaced drains and
+  // exits.
+  pid_t pidLast = pidFirst;
+  for (int i = 0; i < 2; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    pid_t pidNext = StartServer();
+    CHECK(pidNext > 0);
+    CHECK(WaitExit(pidLast, std::chrono::seconds(15)));
+    pidLast = pidNext;
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  bStop = true;
+  client.join();
+
+  CHECK(nServed.load() > 0);
+  CHECK(0 == nFailed.load());
+  CHECK(InitializeClient());
+
+  kill(pidLast, SIGKILL);
+  waitpid(pidLast, nullptr, 0);
+  unlink(g_strSocketPath.c_str());
+  unlink(g_strHandoffPath.c_str());
+
+  if (TestUtil::g_iFailures > iFailures) {
+    fprintf(stderr, "%s: %d checks failed, %d of %d connections failed\n",
+      pszName, TestUtil::g_iFailures - iFailures, nFailed.load(),
+      nServed.load() + nFailed.load());
+  } else {
+    printf("%s: %d connections served\n", pszName, nServed.load());
+  }
+}
+
+}  // namespace
+
+int main() {
+  std::string strPrefix =
+    "/tmp/tinymcp-handoff-test-" + std::to_string(getpid());
+  g_strSocketPath = strPrefix + ".sock";
+  g_strHandoffPath = strPrefix + "-handoff.sock";
+  RunHandoff("Unix domain socket");
+
+  g_iHttpPort = FindFreePort();
+  CHECK(g_iHttpPort > 0);
+  if (g_iHttpPort > 0)
+    RunHandoff("HTTP");
+
+  if (TestUtil::g_iFailures > 0) {
+    fprintf(stderr, "ListenerHandoffTest: %d checks failed\n",
+      TestUtil::g_iFailures);
+    return 1;
+  }
+  printf("ListenerHandoffTest passed\n");
+  return 0;
+}
@@ -0,0 +1,289 @@
+// Pre-fork mode: two workers share the port, and each request on a new
+// connection is served by whichever worker accepts it. Requests of a session
+// owned by the other worker are forwarded there, so every call of a session
+// runs in the same process, and none of them may fail.
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Entity/Server.h"
+#include "TestUtil.h"
+#include "Transport/Transport.h"
+
+namespace {
+
+constexpr size_t WORKERS = 2;
+constexpr size_t SESSIONS_PER_WORKER = 4;
+constexpr int CALLS_PER_SESSION = 10;
+
+int g_iPort = 0;
+
+// Answers with the pid of the process running it.
+class CPidTask : public MCP::ProcessCallToolRequest {
+public:
+  CPidTask(const std::shared_ptr<MCP::Request>& spRequest)
+    : ProcessCallToolRequest(spRequest) {}
+
+  std::shared_ptr<CMCPTask> Clone() const override {
+    auto spClone = std::make_shared<CPidTask>(nullptr);
+    if (spClone) {
+      *spClone = *this;
+    }
+    return spClone;
+  }
+
+  int Execute() override {
+    auto spResult = BuildResult();
+    if (!spResult)
+      return MCP::ERRNO_INTERNAL_ERROR;
+    MCP::TextContent textContent;
+    textContent.strType = MCP::CONST_TEXT;
+    textContent.strText = "pid " + std::to_string(getpid()) + ";";
+    spResult->vecTextContent.push_back(textContent);
+    spResult->bIsError = false;
+    return NotifyResult(spResult);
+  }
+
+  int Cancel() override {
+    return MCP::ERRNO_OK;
+  }
+};
+
+class CForwardServer : public MCP::CMCPServer<CForwardServer> {
+public:
+  int Initialize() override {
+    MCP::Implementation serverInfo;
+    serverInfo.strName = "forward-test";
+    serverInfo.strVersion = "1";
+    SetServerInfo(serverInfo);
+
+    MCP::Tools tools;
+    RegisterServerToolsCapabilities(tools);
+    MCP::Tool tool;
+    tool.strName = "pid";
+    tool.strDescription = "Returns the pid of the worker.";
+    tool.jInputSchema = Json::Value(Json::objectValue);
+    tool.jInputSchema["type"] = "object";
+    RegisterServerTools({ tool }, false);
+    RegisterToolsTasks("pid", std::make_shared<CPidTask>(nullptr));
+
+    SetTransport(std::make_shared<MCP::CHttpTransport>("127.0.0.1", g_iPort));
+    SetWorkerProcesses(WORKERS);
+    return MCP::ERRNO_OK;
+  }
+
+private:
+  friend class MCP::CMCPServer<CForwardServer>;
+  CForwardServer() = default;
+  static CForwardServer s_Instance;
+};
+CForwardServer CForwardServer::s_Instance;
+
+// A port nothing listens on right now.
+int FindFreePort() {
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return 0;
+
+  struct sockaddr_in addr {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t nLength = sizeof(addr);
+  int iPort = 0;
+  if (bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) ==
+        0 &&
+      getsockname(fd, reinterpret_cast<struct sockaddr*>(&addr), &nLength) ==
+        0) {
+    iPort = ntohs(addr.sin_port);
+  }
+  close(fd);
+  return iPort;
+}
+
+struct HttpResponse {
+  int iStatus{ 0 };
+  std::string strSessionId;
+  std::string strBody;
+};
+
+// Posts the message on a connection of its own.
+HttpResponse Post(const std::string& strMessage,
+  const std::string& strSessionId) {
+  HttpResponse response;
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return response;
+
+  struct sockaddr_in addr {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(g_iPort));
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  struct timeval timeout {
+    5, 0
+  };
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr),
+        sizeof(addr)) != 0) {
+    close(fd);
+    return response;
+  }
+
+  std::string strRequest = "POST / HTTP/1.1\r\nHost: 127.0.0.1\r\n"
+                           "Connection: close\r\n"
+                           "Accept: application/json\r\n"
+                           "Content-Type: application/json\r\n";
+  if (!strSessionId.empty())
+    strRequest += "Mcp-Session-Id: " + strSessionId + "\r\n";
+  strRequest += "Content-Length: " + std::to_string(strMessage.size()) +
+                "\r\n\r\n" + strMessage;
+
+  std::string strData;
+  if (send(fd, strRequest.data(), strRequest.size(), MSG_NOSIGNAL) ==
+      static_cast<ssize_t>(strRequest.size())) {
+    char buffer[4096];
+    while (true) {
+      ssize_t nRead = recv(fd, buffer, sizeof(buffer), 0);
+      if (nRead <= 0)
+        break;
+      strData.append(buffer, static_cast<size_t>(nRead));
+    }
+  }
+  close(fd);
+
+  size_t nHeadEnd = strData.find("\r\n\r\n");
+  if (strData.compare(0, 9, "HTTP/1.1 ") != 0 ||
+      nHeadEnd == std::string::npos)
+    return response;
+  response.iStatus = atoi(strData.c_str() + 9);
+  response.strBody = strData.substr(nHeadEnd + 4);
+
+  // Header names are case-insensitive.
+  std::string strHead = strData.substr(0, nHeadEnd);
+  for (auto& ch : strHead)
+    ch = static_cast<char>(tolower(static_cast<unsigned char>(ch)));
+  static constexpr char SESSION_HEADER[] = "\r\nmcp-session-id:";
+  size_t nHeader = strHead.find(SESSION_HEADER);
+  if (nHeader != std::string::npos) {
+    size_t nBegin = strHead.find_first_not_of(
+      ' ', nHeader + sizeof(SESSION_HEADER) - 1);
+    size_t nEnd = strHead.find("\r\n", nBegin);
+    response.strSessionId = strData.substr(nBegin,
+      nEnd == std::string::npos ? std::string::npos : nEnd - nBegin);
+  }
+  return response;
+}
+
+std::string Initialize() {
+  auto response = Post(
+    "{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"initialize\",\"params\":{"
+    "\"protocolVersion\":\"2025-03-26\",\"capabilities\":{},"
+    "\"clientInfo\":{\"name\":\"test\",\"version\":\"1\"}}}",
+    std::string());
+  if (200 != response.iStatus)
+    return std::string();
+  Post("{\"jsonrpc\":\"2.0\",\"method\":\"notifications/initialized\"}",
+    response.strSessionId);
+  return response.strSessionId;
+}
+
+// The pid the call was answered from, empty if it failed.
+std::string CallPid(const std::string& strSessionId, int iId) {
+  auto response = Post("{\"jsonrpc\":\"2.0\",\"id\":" + std::to_string(iId) +
+                         ",\"method\":\"tools/call\","
+                         "\"params\":{\"name\":\"pid\",\"arguments\":{}}}",
+    strSessionId);
+  size_t nBegin = response.strBody.find("pid ");
+  size_t nEnd = response.strBody.find(';', nBegin);
+  if (200 != response.iStatus || nBegin == std::string::npos ||
+      nEnd == std::string::npos)
+    return std::string();
+  return response.strBody.substr(nBegin + 4, nEnd - nBegin - 4);
+}
+
+}  // namespace
+
+int main() {
+  g_iPort = FindFreePort();
+  CHECK(g_iPort > 0);
+
+  pid_t pidMaster = fork();
+  if (0 == pidMaster) {
+    auto& server = CForwardServer::GetInstance();
+    int iErrCode = server.Initialize();
+    if (MCP::ERRNO_OK == iErrCode)
+      iErrCode = server.Start();
+    _exit(MCP::ERRNO_OK == iErrCode ? 0 : 1);
+  }
+  CHECK(pidMaster > 0);
+
+  // As many sessions of each worker, told apart by the pid answering them.
+  std::map<std::string, std::vector<std::string>> mapSessions;
+  auto tpDeadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  size_t nSessions = 0;
+  while (nSessions < WORKERS * SESSIONS_PER_WORKER &&
+         std::chrono::steady_clock::now() < tpDeadline) {
+    std::string strSessionId = Initialize();
+    std::string strPid =
+      strSessionId.empty() ? std::string() : CallPid(strSessionId, 2);
+    if (strPid.empty()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      continue;
+    }
+    auto& vecSessions = mapSessions[strPid];
+    if (vecSessions.size() < SESSIONS_PER_WORKER) {
+      vecSessions.push_back(strSessionId);
+      ++nSessions;
+    }
+  }
+  CHECK(WORKERS == mapSessions.size());
+  CHECK(WORKERS * SESSIONS_PER_WORKER == nSessions);
+
+  // Whichever worker accepts a call, the owner of its session answers it.
+  int nCalls = 0;
+  int nFailed = 0;
+  for (const auto& owner : mapSessions) {
+    for (const auto& strSessionId : owner.second) {
+      for (int i = 0; i < CALLS_PER_SESSION; ++i) {
+        ++nCalls;
+        std::string strPid = CallPid(strSessionId, i + 3);
+        if (strPid.empty())
+          ++nFailed;
+        else
+          CHECK(owner.first == strPid);
+      }
+    }
+  }
+  CHECK(0 == nFailed);
+
+  if (pidMaster > 0) {
+    // The workers follow the master.
+    kill(pidMaster, SIGTERM);
+    waitpid(pidMaster, nullptr, 0);
+  }
+  for (size_t i = 0; i < WORKERS; ++i) {
+    unlink(("/tmp/tinymcp-" + std::to_string(pidMaster) + "-" +
+            std::to_string(i) + ".sock")
+             .c_str());
+  }
+
+  if (TestUtil::g_iFailures > 0) {
+    fprintf(stderr, "%d checks failed, %d of %d calls failed\n",
+      TestUtil::g_iFailures, nFailed, nCalls);
+    return 1;
+  }
+  printf("PreForkForwardTest passed, %d calls over %zu workers\n", nCalls,
+    WORKERS);
+  return 0;
+}
@@ -0,0 +1,75 @@
+// Content-Length framing of the stdio channel, read from a pipe on stdin.
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+#include "Public/PublicDef.h"
+#include "TestUtil.h"
+#include "Transport/Channel.h"
+
+namespace {
+
+// Replaces stdin with a pipe holding the input, followed by end of input.
+bool SetInput(const std::string& strInput) {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    return false;
+  }
+  // The input fits into the pipe buffer, so the write does not block.
+  bool bWritten = write(fds[1], strInput.data(), strInput.size()) ==
+    static_cast<ssize_t>(strInput.size());
+  close(fds[1]);
+  bool bDup = dup2(fds[0], STDIN_FILENO) == STDIN_FILENO;
+  close(fds[0]);
+  return bWritten && bDup;
+}
+
+void TestFrames() {
+  CHECK(SetInput("Content-Length: 2\r\n\r\n{}"
+    "content-length: 13\r\nContent-Type: application/json\r\n\r\n"
+    "{\"id\":1}\n    "));
+
+  MCP::CStdioChannel channel;
+  std::string_view frame;
+  CHECK(MCP::ERRNO_OK == channel.ReadFrame(frame));
+  CHECK(frame == "{}");
+  CHECK(MCP::ERRNO_OK == channel.ReadFrame(frame));
+  CHECK(frame == "{\"id\":1}\n    ");
+  CHECK(MCP::ERRNO_INTERNAL_INPUT_TERMINATE == channel.ReadFrame(frame));
+}
+
+void TestHeaderTooLarge(const std::string& strHeader) {
+  // The frame after the oversized header must not be read.
+  CHECK(SetInput("Content-Length: 2\r\n\r\n{}" + strHeader +
+    "Content-Length: 2\r\n\r\n[]"));
+
+  MCP::CStdioChannel channel;
+  std::string_view frame;
+  CHECK(MCP::ERRNO_OK == channel.ReadFrame(frame));
+  CHECK(frame == "{}");
+  CHECK(MCP::ERRNO_INTERNAL_INPUT_ERROR == channel.ReadFrame(frame));
+  CHECK(!channel.IsActive());
+  CHECK(MCP::ERRNO_OK != channel.ReadFrame(frame));
+}
+
+}  // namespace
+
+int main() {
+  TestFrames();
+  // One header line over the limit, and a block of many short lines.
+  TestHeaderTooLarge("X-Padding: " + std::string(10000, 'a') + "\r\n\r\n");
+  std::string strHeaders;
+  for (int i = 0; i < 1000; ++i) {
+    strHeaders += "X-Padding: aaaa\r\n";
+  }
+  TestHeaderTooLarge(strHeaders + "\r\n");
+
+  if (TestUtil::g_iFailures > 0) {
+    fprintf(stderr, "%d checks failed\n", TestUtil::g_iFailures);
+    return 1;
+  }
+  printf("StdioChannelTest passed\n");
+  return 0;
+}
@@ -0,0 +1,20 @@
+// Checks shared by the tests: a failed CHECK is reported and counted, and
+// the test goes on.
+#pragma once
+
+#include <cstdio>
+
+namespace TestUtil {
+
+inline int g_iFailures = 0;
+
+}  // namespace TestUtil
+
+#define CHECK(expr)                                                   \
+  do {                                                                \
+    if (!(expr)) {                                                    \
+      fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, \
+        #expr);                                                       \
+      ++TestUtil::g_iFailures;                                        \
+    }                                                                 \
+  } while (0)
@@ -0,0 +1,241 @@
+// TLS handshakes per second of the HTTPS transport: a client connects again
+// and again for a while, each time sending one request, with resumption off
+// on the server, from the session cache and from session tickets. Fails if
+// sessions were not resumed as configured.
+//
+//   TlsHandshakeBenchmark [seconds per run, default 2]
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "Public/Logger.h"
+#include "TestUtil.h"
+#include "Transport/Transport.h"
+
+namespace {
+
+int g_iPort = 0;
+
+struct RunResult {
+  long lHandshakes{ 0 };
+  long lResumed{ 0 };
+  long lFailed{ 0 };
+  double dSeconds{ 0 };
+};
+
+// A port nothing listens on right now.
+int FindFreePort() {
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return 0;
+
+  struct sockaddr_in addr {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t nLength = sizeof(addr);
+  int iPort = 0;
+  if (bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) ==
+        0 &&
+      getsockname(fd, reinterpret_cast<struct sockaddr*>(&addr), &nLength) ==
+        0) {
+    iPort = ntohs(addr.sin_port);
+  }
+  close(fd);
+  return iPort;
+}
+
+// Writes a self-signed P-256 certificate and its key.
+bool WriteCertificate(const std::string& strCertFile,
+  const std::string& strKeyFile) {
+  EVP_PKEY* pKey = EVP_EC_gen("P-256");
+  X509* pCert = X509_new();
+  bool bWritten = false;
+  if (pKey && pCert) {
+    ASN1_INTEGER_set(X509_get_serialNumber(pCert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(pCert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(pCert), 24 * 60 * 60);
+    X509_set_pubkey(pCert, pKey);
+    X509_NAME* pName = X509_get_subject_name(pCert);
+    X509_NAME_add_entry_by_txt(pName, "CN", MBSTRING_ASC,
+      reinterpret_cast<const unsigned char*>("127.0.0.1"), -1, -1, 0);
+    X509_set_issuer_name(pCert, pName);
+
+    FILE* pCertFile = fopen(strCertFile.c_str(), "w");
+    FILE* pKeyFile = fopen(strKeyFile.c_str(), "w");
+    bWritten = X509_sign(pCert, pKey, EVP_sha256()) > 0 && pCertFile &&
+               pKeyFile && PEM_write_X509(pCertFile, pCert) == 1 &&
+               PEM_write_PrivateKey(
+                 pKeyFile, pKey, nullptr, nullptr, 0, nullptr, nullptr) == 1;
+    if (pCertFile)
+      fclose(pCertFile);
+    if (pKeyFile)
+      fclose(pKeyFile);
+  }
+  X509_free(pCert);
+  EVP_PKEY_free(pKey);
+  return bWritten;
+}
+
+int Connect() {
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return -1;
+
+  struct sockaddr_in addr {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(g_iPort));
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  struct timeval timeout {
+    5, 0
+  };
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  int iYes = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &iYes, sizeof(iYes));
+  if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr),
+        sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// Connects until the time is up, offering the last session each time.
+RunResult RunClient(std::chrono::seconds duration) {
+  RunResult result;
+  SSL_CTX* pContext = SSL_CTX_new(TLS_client_method());
+  if (!pContext)
+    return result;
+
+  static constexpr char REQUEST[] = "GET / HTTP/1.1\r\nHost: 127.0.0.1\r\n"
+                                    "Accept: text/event-stream\r\n"
+                                    "Connection: close\r\n\r\n";
+  SSL_SESSION* pSession = nullptr;
+  auto tpBegin = std::chrono::steady_clock::now();
+  auto tpEnd = tpBegin + duration;
+  while (std::chrono::steady_clock::now() < tpEnd) {
+    int fd = Connect();
+    SSL* pSsl = fd >= 0 ? SSL_new(pContext) : nullptr;
+    if (!pSsl) {
+      ++result.lFailed;
+      if (fd >= 0)
+        close(fd);
+      continue;
+    }
+
+    SSL_set_fd(pSsl, fd);
+    if (pSession)
+      SSL_set_session(pSsl, pSession);
+    if (SSL_connect(pSsl) == 1) {
+      ++result.lHandshakes;
+      if (SSL_session_reused(pSsl))
+        ++result.lResumed;
+      // TLS 1.3 tickets arrive after the handshake, so the answer is read
+      // before the session is kept.
+      SSL_write(pSsl, REQUEST, sizeof(REQUEST) - 1);
+      char buffer[4096];
+      while (SSL_read(pSsl, buffer, sizeof(buffer)) > 0) {
+      }
+      // A session of a connection not shut down is not resumed.
+      SSL_shutdown(pSsl);
+      SSL_SESSION* pNewSession = SSL_get1_session(pSsl);
+      if (pNewSession) {
+        SSL_SESSION_free(pSession);
+        pSession = pNewSession;
+      }
+    } else {
+      ++result.lFailed;
+    }
+    SSL_free(pSsl);
+    close(fd);
+  }
+  result.dSeconds = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - tpBegin)
+                      .count();
+
+  SSL_SESSION_free(pSession);
+  SSL_CTX_free(pContext);
+  return result;
+}
+
+RunResult Run(const char* pszName, const MCP::HttpTlsOptions& tls,
+  std::chrono::seconds duration) {
+  MCP::HttpTransportOptions options;
+  options.tls = tls;
+  MCP::CHttpTransport transport("127.0.0.1", g_iPort, options);
+  RunResult result;
+  if (MCP::ERRNO_OK != transport.Start()) {
+    fprintf(stderr, "%s: the server did not start\n", pszName);
+    result.lFailed = 1;
+    return result;
+  }
+  result = RunClient(duration);
+  transport.Stop();
+
+  printf("%-16s %8.0f handshakes/s, %ld of %ld resumed, %ld failed\n",
+    pszName,
+    result.dSeconds > 0 ? result.lHandshakes / result.dSeconds : 0.0,
+    result.lResumed, result.lHandshakes, result.lFailed);
+  return result;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::chrono::seconds duration{ 2 };
+  if (argc > 1 && atoi(argv[1]) > 0)
+    duration = std::chrono::seconds(atoi(argv[1]));
+  MCP::Logger::Instance().SetLevel(MCP::LogLevel::Warning);
+
+  std::string strPrefix =
+    "/tmp/tinymcp-tls-benchmark-" + std::to_string(getpid());
+  MCP::HttpTlsOptions tls;
+  tls.strCertFile = strPrefix + "-cert.pem";
+  tls.strKeyFile = strPrefix + "-key.pem";
+  CHECK(WriteCertificate(tls.strCertFile, tls.strKeyFile));
+  g_iPort = FindFreePort();
+  CHECK(g_iPort > 0);
+
+  // Every handshake is a full one.
+  MCP::HttpTlsOptions off = tls;
+  off.bSessionCache = false;
+  off.bSessionTickets = false;
+  RunResult resultOff = Run("resumption off", off, duration);
+  CHECK(resultOff.lHandshakes > 0);
+  CHECK(0 == resultOff.lResumed);
+  CHECK(0 == resultOff.lFailed);
+
+  MCP::HttpTlsOptions cache = tls;
+  cache.bSessionTickets = false;
+  RunResult resultCache = Run("session cache", cache, duration);
+  MCP::HttpTlsOptions tickets = tls;
+  tickets.bSessionCache = false;
+  RunResult resultTickets = Run("session tickets", tickets, duration);
+  // All but the first connection resume.
+  for (const auto& result : { resultCache, resultTickets }) {
+    CHECK(result.lHandshakes > 1);
+    CHECK(result.lResumed + 1 == result.lHandshakes);
+    CHECK(0 == result.lFailed);
+  }
+
+  unlink(tls.strCertFile.c_str());
+  unlink(tls.strKeyFile.c_str());
+  if (TestUtil::g_iFailures > 0) {
+    fprintf(stderr, "TlsHandshakeBenchmark: %d checks failed\n",
+      TestUtil::g_iFailures);
+    return 1;
+  }
+  return 0;
+}